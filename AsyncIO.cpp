@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#include "AsyncIO.h"
+#include "FileSystemException.h"
+#include "HostCopy.h"
+#include "ThreadPool.h"
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define ASYNCIO_URING 1
+#endif
+
+constexpr size_t AsyncIO::copy_block;
+constexpr size_t AsyncIO::copy_depth;
+constexpr unsigned AsyncIO::ring_entries;
+constexpr size_t AsyncIO::submit_group;
+IOEngine AsyncIO::requested = IOEngine::Uring;
+size_t AsyncIO::threshold = 1 << 20;
+
+struct AsyncIO::Request {
+    enum Kind : std::uint8_t { Read, Write };
+    Kind kind = Read;
+    Copy* copy = nullptr;               //< The copy, and the slot of the block.
+    size_t slot = 0;
+};
+
+struct AsyncIO::Copy {
+    // A block of the copy, read into its part of the buffer, then written.
+    struct Slot {
+        Request request;
+        size_t offset = 0;      //< Start of the block inside both files.
+        size_t length = 0;      //< Bytes of the block, 0 while the slot is idle.
+        size_t got = 0;         //< Bytes of the block read so far.
+        size_t put = 0;         //< Bytes of the block written so far.
+    };
+
+    int source;
+    int destination;
+    size_t size;
+    size_t next = 0;                    //< Start of the first block not given to a slot.
+    size_t copied = 0;                  //< Bytes written.
+    unsigned active = 0;                //< Slots with a request in flight.
+    bool done = false;
+    std::string error;                  //< Why the copy failed, empty if it did not.
+    std::chrono::steady_clock::time_point start;
+    std::unique_ptr<char[]> buffers;    //< copy_block bytes for every slot.
+    Slot slots[copy_depth];
+
+    Copy(const int source, const int destination, const size_t size)
+        : source(source), destination(destination), size(size), start(std::chrono::steady_clock::now()) {}
+};
+
+#ifdef ASYNCIO_URING
+/**
+ * Ring is one io_uring: the submission ring, its entries and the completion ring, mapped from the kernel.
+ * Only the thread holding the AsyncIO mutex fills and submits, only the completion thread reaps.
+ * **/
+struct AsyncIO::Ring {
+    int descriptor = -1;
+    void* submissionMap = MAP_FAILED;
+    size_t submissionMapSize = 0;
+    void* completionMap = MAP_FAILED;
+    size_t completionMapSize = 0;
+    io_uring_sqe* entries = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t entriesSize = 0;
+    unsigned* submissionHead = nullptr;
+    unsigned* submissionTail = nullptr;
+    unsigned* submissionArray = nullptr;
+    unsigned submissionMask = 0;
+    unsigned capacity = 0;
+    unsigned tail = 0;                  //< Tail including the entries filled and not published yet.
+    unsigned* completionHead = nullptr;
+    unsigned* completionTail = nullptr;
+    unsigned completionMask = 0;
+    io_uring_cqe* completions = nullptr;
+
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring() {
+        if (entries != MAP_FAILED) munmap(entries, entriesSize);
+        if (completionMap != MAP_FAILED && completionMap != submissionMap) munmap(completionMap, completionMapSize);
+        if (submissionMap != MAP_FAILED) munmap(submissionMap, submissionMapSize);
+        if (descriptor >= 0) ::close(descriptor);
+    }
+
+    // Creates the ring and maps it, returns false if the kernel refuses io_uring or lacks an operation we need.
+    bool open(const unsigned size) {
+        io_uring_params params{};
+        descriptor = static_cast<int>(syscall(__NR_io_uring_setup, size, &params));
+        if (descriptor < 0) return false;
+
+        submissionMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        completionMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            submissionMapSize = completionMapSize = std::max(submissionMapSize, completionMapSize);
+        }
+        submissionMap = mmap(nullptr, submissionMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             descriptor, IORING_OFF_SQ_RING);
+        if (submissionMap == MAP_FAILED) return false;
+        completionMap = single ? submissionMap
+                               : mmap(nullptr, completionMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      descriptor, IORING_OFF_CQ_RING);
+        if (completionMap == MAP_FAILED) return false;
+        entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+        entries = static_cast<io_uring_sqe*>(mmap(nullptr, entriesSize, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_SQES));
+        if (entries == MAP_FAILED) return false;
+
+        char* submission = static_cast<char*>(submissionMap);
+        submissionHead = reinterpret_cast<unsigned*>(submission + params.sq_off.head);
+        submissionTail = reinterpret_cast<unsigned*>(submission + params.sq_off.tail);
+        submissionArray = reinterpret_cast<unsigned*>(submission + params.sq_off.array);
+        submissionMask = *reinterpret_cast<unsigned*>(submission + params.sq_off.ring_mask);
+        capacity = params.sq_entries;
+        tail = *submissionTail;
+        char* completion = static_cast<char*>(completionMap);
+        completionHead = reinterpret_cast<unsigned*>(completion + params.cq_off.head);
+        completionTail = reinterpret_cast<unsigned*>(completion + params.cq_off.tail);
+        completionMask = *reinterpret_cast<unsigned*>(completion + params.cq_off.ring_mask);
+        completions = reinterpret_cast<io_uring_cqe*>(completion + params.cq_off.cqes);
+        return supports({IORING_OP_READ, IORING_OP_WRITE});
+    }
+
+    // Function that asks the kernel which operations it knows (5.6 and later answer).
+    bool supports(const std::initializer_list<unsigned> operations) const {
+        constexpr unsigned probed = 256;
+        std::unique_ptr<char[]> memory(new char[sizeof(io_uring_probe) + probed * sizeof(io_uring_probe_op)]());
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(memory.get());
+        if (syscall(__NR_io_uring_register, descriptor, IORING_REGISTER_PROBE, probe, probed) < 0) return false;
+        for (const unsigned operation : operations) {
+            if (operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    // Returns a cleared entry at the tail, nullptr if the ring is full.
+    io_uring_sqe* next() {
+        if (tail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE) >= capacity) return nullptr;
+        const unsigned index = tail & submissionMask;
+        submissionArray[index] = index;
+        ++tail;
+        io_uring_sqe* entry = &entries[index];
+        std::memset(entry, 0, sizeof(*entry));
+        return entry;
+    }
+
+    // Publishes the filled entries and hands 'count' of them to the kernel, returns how many it took, -errno on failure.
+    int submit(const unsigned count) {
+        __atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+        int submitted;
+        do {
+            submitted = static_cast<int>(syscall(__NR_io_uring_enter, descriptor, count, 0, 0, nullptr, 0));
+        } while (submitted < 0 && errno == EINTR);
+        return submitted < 0 ? -errno : submitted;
+    }
+
+    // Takes back the entries the kernel did not take, calling 'dropped' with each of them.
+    template <typename Consumer>
+    void rewind(Consumer&& dropped) {
+        const unsigned head = __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE);
+        for (unsigned position = head; position != tail; ++position) {
+            dropped(entries[position & submissionMask].user_data);
+        }
+        tail = head;
+        __atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+    }
+
+    // Blocks until at least one request completed.
+    void waitCompletion() const {
+        syscall(__NR_io_uring_enter, descriptor, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    }
+
+    // Calls 'consumer' with the data and result of every completed request, and frees their slots.
+    template <typename Consumer>
+    void reap(Consumer&& consumer) {
+        unsigned head = *completionHead;
+        const unsigned end = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+        for (; head != end; ++head) {
+            const io_uring_cqe& completion = completions[head & completionMask];
+            consumer(completion.user_data, completion.res);
+        }
+        __atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+    }
+};
+#else
+struct AsyncIO::Ring {};
+#endif
+
+// Constructor, opens the ring if io_uring is selected and the kernel offers it, otherwise copies use the ThreadPool.
+// The pool runs the unlinks with either engine, it is created first, so it is destroyed after the engine.
+AsyncIO::AsyncIO()
+    : engine(IOEngine::Threads), inFlight(0), queued(0), tasks(0), stopping(false), lastTicket(0),
+      copiesDone(0), copiedBytes(0), copySeconds(0), unlinks(0), submissions(0) {
+    ThreadPool::instance();
+#ifdef ASYNCIO_URING
+    if (requested == IOEngine::Uring) {
+        std::unique_ptr<Ring> opened(new Ring);
+        if (opened->open(ring_entries)) {
+            ring = std::move(opened);
+            engine = IOEngine::Uring;
+            reaper = std::thread(&AsyncIO::runReaper, this);
+        }
+    }
+#endif
+}
+
+// Destructor, waits for every request, then stops the completion thread.
+AsyncIO::~AsyncIO() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        progress.wait(lock, [this] { return inFlight == 0 && queued == 0 && tasks == 0; });
+        stopping = true;
+    }
+    wake.notify_all();
+    if (reaper.joinable()) {
+        reaper.join();
+    }
+}
+
+// Function that returns the single engine of the process.
+AsyncIO& AsyncIO::instance() {
+    static AsyncIO asyncIO;
+    return asyncIO;
+}
+
+// Function that selects the engine, used by '--io-engine' before anything runs in the background.
+void AsyncIO::setEngine(const IOEngine selected) {
+    requested = selected;
+}
+
+// Function that sets the smallest copy run in the background, used by '--background-copy'.
+void AsyncIO::setThreshold(const size_t bytes) {
+    threshold = bytes;
+}
+
+// Function that returns the name of the engine in use, as printed by 'stats'.
+const char* AsyncIO::getEngineName() const {
+    if (engine == IOEngine::Uring) return "io_uring";
+    return requested == IOEngine::Uring ? "thread pool (no io_uring)" : "thread pool";
+}
+
+// Function that waits (lock held) until 'count' more requests fit into the ring.
+// Only threads outside the completion thread wait, it replaces every request it reaps by at most one.
+void AsyncIO::reserve(std::unique_lock<std::mutex>& lock, const unsigned count) {
+    progress.wait(lock, [this, count] { return inFlight + queued + count <= ring_entries; });
+}
+
+// Function that writes a request into the next entry of the ring (lock held, room reserved).
+void AsyncIO::enqueue(Request& request) {
+#ifdef ASYNCIO_URING
+    io_uring_sqe* entry = ring->next();
+    if (!entry) {
+        submitQueued();
+        entry = ring->next();
+    }
+    entry->user_data = reinterpret_cast<std::uint64_t>(&request);
+    Copy& copy = *request.copy;
+    const Copy::Slot& slot = copy.slots[request.slot];
+    char* buffer = copy.buffers.get() + request.slot * copy_block;
+    if (request.kind == Request::Read) {
+        entry->opcode = IORING_OP_READ;
+        entry->fd = copy.source;
+        entry->addr = reinterpret_cast<std::uint64_t>(buffer + slot.got);
+        entry->len = static_cast<std::uint32_t>(slot.length - slot.got);
+        entry->off = slot.offset + slot.got;
+    } else {
+        entry->opcode = IORING_OP_WRITE;
+        entry->fd = copy.destination;
+        entry->addr = reinterpret_cast<std::uint64_t>(buffer + slot.put);
+        entry->len = static_cast<std::uint32_t>(slot.got - slot.put);
+        entry->off = slot.offset + slot.put;
+    }
+    ++queued;
+#else
+    (void) request;
+#endif
+}
+
+// Function that hands every queued request to the kernel in one system call (lock held).
+// Requests the kernel refuses complete at once with the error.
+void AsyncIO::submitQueued() {
+#ifdef ASYNCIO_URING
+    while (queued > 0) {
+        const int submitted = ring->submit(queued);
+        if (submitted <= 0) {
+            const int error = submitted < 0 && submitted != -EAGAIN ? submitted : -EIO;
+            std::vector<Request*> refused;
+            ring->rewind([&refused](const std::uint64_t data) {
+                refused.push_back(reinterpret_cast<Request*>(data));
+            });
+            queued = 0;
+            for (Request* request : refused) {
+                stepCopy(*request->copy, request->slot, error);
+            }
+            continue;
+        }
+        ++submissions;
+        queued -= static_cast<unsigned>(submitted);
+        inFlight += static_cast<unsigned>(submitted);
+    }
+    wake.notify_one();
+#endif
+}
+
+// Function that continues a block of a copy once its read or write completed (lock held):
+// what was read is written, a block read only in part is read further, a finished block takes the next one.
+// After a failure nothing more is submitted, the copy ends once its last request is back.
+void AsyncIO::stepCopy(Copy& copy, const size_t slot, const int result) {
+    Copy::Slot& block = copy.slots[slot];
+    --copy.active;
+    if (result == -EINTR || result == -EAGAIN) {
+        ++copy.active;
+        enqueue(block.request);
+        return;
+    }
+    if (copy.error.empty()) {
+        if (block.request.kind == Request::Read) {
+            if (result <= 0) copy.error = "Failed to read the file.";
+            else block.got += static_cast<size_t>(result);
+        } else {
+            if (result <= 0) copy.error = "Failed to write the file.";
+            else {
+                block.put += static_cast<size_t>(result);
+                copy.copied += static_cast<size_t>(result);
+            }
+        }
+    }
+    if (copy.error.empty()) {
+        if (block.put == block.length && copy.next < copy.size) {
+            block.offset = copy.next;
+            block.length = std::min(copy_block, copy.size - copy.next);
+            block.got = block.put = 0;
+            copy.next += block.length;
+        }
+        if (block.put < block.length) {
+            block.request.kind = block.put < block.got ? Request::Write : Request::Read;
+            ++copy.active;
+            enqueue(block.request);
+        }
+    }
+    if (copy.active == 0) {
+        finishCopy(copy);
+    }
+}
+
+// Function that ends a copy (lock held): both descriptors are closed, the counters take its bytes and time.
+void AsyncIO::finishCopy(Copy& copy) {
+    if (copy.error.empty() && ::close(copy.destination) != 0) {
+        copy.error = "Failed to write the file.";
+    } else if (!copy.error.empty()) {
+        ::close(copy.destination);
+    }
+    ::close(copy.source);
+    copy.buffers.reset();
+    copy.done = true;
+    ++copiesDone;
+    copiedBytes += copy.copied;
+    copySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - copy.start).count();
+    progress.notify_all();
+}
+
+// Function that starts a background copy. With io_uring every slot reads its first block at once,
+// the completion thread does the rest. With the thread pool one task copies the whole file through HostCopy.
+AsyncIO::Ticket AsyncIO::copy(const int source, const int destination, const size_t size) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const Ticket ticket = ++lastTicket;
+    Copy& copy = *copies.emplace(ticket, std::unique_ptr<Copy>(new Copy(source, destination, size))).first->second;
+    if (!ring) {
+        ++tasks;
+        lock.unlock();
+        ThreadPool::instance().submit([this, &copy] {
+            std::string error;
+            size_t copied = 0;
+            try {
+                copied = HostCopy::instance().copyDescriptors(copy.source, copy.destination, copy.size);
+                if (copied != copy.size) error = "Failed to read the file.";
+            } catch (std::exception& e) {
+                error = e.what();
+            }
+            const std::lock_guard<std::mutex> guard(mutex);
+            copy.copied = copied;
+            copy.error = error;
+            --tasks;
+            finishCopy(copy);
+        });
+        return ticket;
+    }
+
+    if (size == 0) {
+        finishCopy(copy);
+        return ticket;
+    }
+    const size_t slots = std::min(copy_depth, (size + copy_block - 1) / copy_block);
+    copy.buffers.reset(new char[slots * copy_block]);
+    reserve(lock, static_cast<unsigned>(slots));
+    for (size_t slot = 0; slot < slots; slot++) {
+        Copy::Slot& block = copy.slots[slot];
+        block.request.kind = Request::Read;
+        block.request.copy = &copy;
+        block.request.slot = slot;
+        block.offset = copy.next;
+        block.length = std::min(copy_block, size - copy.next);
+        copy.next += block.length;
+        ++copy.active;
+        enqueue(block.request);
+    }
+    submitQueued();
+    return ticket;
+}
+
+// Function that returns how far a copy is, a copy that is not known anymore is done.
+AsyncIO::Progress AsyncIO::poll(const Ticket ticket) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto found = copies.find(ticket);
+    if (found == copies.end()) return Progress{0, 0, true};
+    return Progress{found->second->copied, found->second->size, found->second->done};
+}
+
+// Function that waits for the end of a copy, then forgets it.
+bool AsyncIO::wait(const Ticket ticket, std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto found = copies.find(ticket);
+    if (found == copies.end()) return true;
+    Copy& copy = *found->second;
+    progress.wait(lock, [&copy] { return copy.done; });
+    error = copy.error;
+    copies.erase(found);
+    return error.empty();
+}
+
+// Main loop of the completion thread: sleeps while nothing is in flight, otherwise waits inside the kernel
+// for completions (without the lock, so requests keep being submitted), and handles them.
+void AsyncIO::runReaper() {
+#ifdef ASYNCIO_URING
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || inFlight > 0; });
+        if (inFlight == 0) break;
+        lock.unlock();
+        ring->waitCompletion();
+        lock.lock();
+        ring->reap([this](const std::uint64_t data, const int result) {
+            --inFlight;
+            const Request& request = *reinterpret_cast<Request*>(data);
+            stepCopy(*request.copy, request.slot, result);
+        });
+        submitQueued();
+        progress.notify_all();
+    }
+#endif
+}
+
+UnlinkBatch::UnlinkBatch(): engine(AsyncIO::instance()), pending(0), failure(0) {}
+
+// Destructor, the kernel (or a task) may still use the paths, so it waits for them.
+UnlinkBatch::~UnlinkBatch() {
+    if (!group.empty()) {
+        submitGroup();
+    }
+    drain();
+}
+
+// Function that queues the unlink of a physical file, every submit_group paths become a ThreadPool task.
+void UnlinkBatch::unlink(const std::string& path, const bool required) {
+    group.emplace_back(path, required);
+    if (group.size() >= AsyncIO::submit_group) {
+        submitGroup();
+    }
+}
+
+// Function that unlinks the grouped paths on one ThreadPool task.
+void UnlinkBatch::submitGroup() {
+    std::shared_ptr<std::vector<std::pair<std::string, bool>>> paths(
+        new std::vector<std::pair<std::string, bool>>(std::move(group)));
+    group.clear();
+    {
+        const std::lock_guard<std::mutex> lock(engine.mutex);
+        pending += paths->size();
+        ++engine.tasks;
+    }
+    ThreadPool::instance().submit([this, paths] {
+        int error = 0;
+        for (const auto& path : *paths) {
+            if (::unlink(path.first.c_str()) != 0 && path.second && error == 0) {
+                error = errno;
+            }
+        }
+        const std::lock_guard<std::mutex> lock(engine.mutex);
+        if (failure == 0) failure = error;
+        pending -= paths->size();
+        engine.unlinks += paths->size();
+        ++engine.submissions;
+        --engine.tasks;
+        engine.progress.notify_all();
+    });
+}
+
+// Function that waits until every unlink of the batch ended.
+void UnlinkBatch::drain() {
+    std::unique_lock<std::mutex> lock(engine.mutex);
+    engine.progress.wait(lock, [this] { return pending == 0; });
+}
+
+// Function that waits for the whole batch, and reports the first failed required unlink the way perror() does.
+// The other files are still removed, unlike a serial walk stopping at the first failure.
+void UnlinkBatch::finish() {
+    if (!group.empty()) {
+        submitGroup();
+    }
+    drain();
+    if (failure == 0) return;
+    std::fprintf(stderr, "Remove failed: %s\n", std::strerror(failure));
+    failure = 0;
+    throw FileSystemException("Failed to remove the file.");
+}
@@ -0,0 +1,140 @@
+#ifndef FIRSTPROJECT_ASYNCIO_H
+#define FIRSTPROJECT_ASYNCIO_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Engine running the background work of AsyncIO, selected by '--io-engine'.
+enum class IOEngine : std::uint8_t {
+    Uring,      //< io_uring, falls back to Threads where the kernel does not offer it (default).
+    Threads     //< Blocking system calls on the ThreadPool.
+};
+
+class UnlinkBatch;  // Forward declaration, defined below.
+
+/**
+ * AsyncIO runs the slow work on physical files in the background, so the terminal does not wait for it:
+ * the copies of large files started by 'copy' (see JobTable), and the unlinks of 'exit' and 'rmdir' (see UnlinkBatch).
+ * The io_uring engine talks to the kernel with the raw io_uring_setup/io_uring_enter system calls (no library):
+ * requests are written into the submission ring and handed over in batches, one completion thread reaps them
+ * and submits the next step. A copy keeps copy_depth blocks in flight, each block is read, then what was read
+ * is written. If the kernel has no io_uring (too old, disabled, or filtered), or with '--io-engine threads',
+ * a copy is one ThreadPool task instead (HostCopy picks the kernel copy method).
+ * Unlinks always run on the ThreadPool, submit_group paths a task: the kernel never runs an io_uring unlink inline,
+ * it hands every one to a worker of its own, which is slower than unlinking a group on one thread.
+ * A copy is known by its ticket until it is waited for, and closes both descriptors once it ended.
+ * Every member function is thread-safe.
+ * **/
+class AsyncIO {
+public:
+    using Ticket = std::uint64_t;
+
+    static constexpr size_t copy_block = 1 << 20;      // Bytes of every block of a copy.
+    static constexpr size_t copy_depth = 4;            // Blocks of one copy in flight at once.
+    static constexpr unsigned ring_entries = 256;      // Requests in flight at most.
+    static constexpr size_t submit_group = 64;         // Unlinks of one ThreadPool task.
+
+    // State of a background copy, for 'jobs'.
+    struct Progress {
+        size_t copied;      //< Bytes written so far.
+        size_t size;        //< Bytes to copy.
+        bool done;          //< True once the copy ended (or failed).
+    };
+
+private:
+    friend class UnlinkBatch;
+    struct Ring;        // The mapped io_uring, defined in AsyncIO.cpp.
+    struct Request;     // One read or write in flight.
+    struct Copy;        // One background copy.
+
+    IOEngine engine;                                            //< Engine in use, Threads if io_uring is missing.
+    std::unique_ptr<Ring> ring;                                 //< nullptr with the thread pool.
+    std::mutex mutex;                                           //< Guards everything below, and the submission ring.
+    std::condition_variable wake;                               //< Wakes up the completion thread.
+    std::condition_variable progress;                           //< Signaled whenever requests complete.
+    std::thread reaper;                                         //< Completion thread of the ring.
+    unsigned inFlight;                                          //< Requests submitted and not completed.
+    unsigned queued;                                            //< Requests in the submission ring, not submitted yet.
+    size_t tasks;                                               //< ThreadPool tasks (copies, unlinks) not finished yet.
+    bool stopping;                                              //< Stops the completion thread.
+    std::unordered_map<Ticket, std::unique_ptr<Copy>> copies;   //< Copies not waited for yet.
+    Ticket lastTicket;
+    size_t copiesDone;                                          //< Counters printed by 'stats'.
+    std::uint64_t copiedBytes;
+    double copySeconds;
+    size_t unlinks;
+    size_t submissions;
+
+    static IOEngine requested;                  //< Engine selected by '--io-engine'.
+    static size_t threshold;                    //< Smallest copy run in the background.
+
+    AsyncIO();
+    ~AsyncIO();
+    void reserve(std::unique_lock<std::mutex>& lock, unsigned count);  // Waits until the ring has room.
+    void enqueue(Request& request);                                     // Writes a request into the ring.
+    void submitQueued();                                                // Hands the queued requests to the kernel.
+    void stepCopy(Copy& copy, size_t slot, int result);                 // Reads or writes the next part of a block.
+    void finishCopy(Copy& copy);                                        // Closes a copy that has nothing in flight.
+    void runReaper();                                                   // Main loop of the completion thread.
+
+public:
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    static AsyncIO& instance();                         // Returns the process-wide engine, created on first use.
+    static void setEngine(IOEngine selected);           // Selects the engine, before the first use.
+    static void setThreshold(size_t bytes);             // Copies of at least this many bytes run in the background.
+    static size_t getThreshold() { return threshold; }
+
+    IOEngine getEngine() const { return engine; }
+    const char* getEngineName() const;
+
+    // Starts copying 'size' bytes from source into destination (both at offset 0), owns both descriptors from now on.
+    Ticket copy(int source, int destination, size_t size);
+    Progress poll(Ticket ticket);
+    // Blocks until a copy ended and forgets it, returns false (and its error) if it failed.
+    bool wait(Ticket ticket, std::string& error);
+
+    size_t getCopies() const { return copiesDone; }
+    std::uint64_t getCopiedBytes() const { return copiedBytes; }
+    double getCopyBytesPerSecond() const { return copySeconds > 0 ? static_cast<double>(copiedBytes) / copySeconds : 0; }
+    size_t getUnlinks() const { return unlinks; }
+    size_t getSubmissions() const { return submissions; }
+};
+
+/**
+ * UnlinkBatch removes many physical files through AsyncIO, while its owner keeps walking the tree:
+ * the paths given to unlink() are removed in the background, submit_group at a time.
+ * finish() waits for every unlink of the batch, and if a required unlink failed, reports the first failure
+ * like perror() and throws. The destructor waits too, without reporting.
+ * **/
+class UnlinkBatch {
+    AsyncIO& engine;
+    std::vector<std::pair<std::string, bool>> group;    //< Paths (and if required) of the next ThreadPool task.
+    size_t pending;                                     //< Unlinks not finished, guarded by the engine.
+    int failure;                                        //< errno of the first failed required unlink, guarded by the engine.
+
+    void submitGroup();                                 // Hands the grouped paths to a ThreadPool task.
+    void drain();                                       // Waits for every unlink.
+
+public:
+    UnlinkBatch();
+    UnlinkBatch(const UnlinkBatch&) = delete;
+    UnlinkBatch& operator=(const UnlinkBatch&) = delete;
+    ~UnlinkBatch();
+
+    // Removes a physical file, a failure of a required one is an error, otherwise the file may be missing.
+    void unlink(const std::string& path, bool required);
+    // Waits for every unlink. Throws FileSystemException if a required unlink failed.
+    void finish();
+};
+
+#endif //FIRSTPROJECT_ASYNCIO_H
@@ -1,26 +1,20 @@
 #include "CharProxy.h"
 #include "File.h"
 
-// Opens the file in input mode, seeks to the target index, reads a single character,
-// and then closes the stream, and returns that char read.
+// Reads the character at the target index through the storage of the file,
+// (served from the PageCache or from the mapping, depending on the backend).
 CharProxy::operator char() const {
-    file->value->stream->clear();
-    file->value->stream->open(file->value->filename, std::ios::in);
-    file->value->stream->seekg(index);
-    char ch = 0;
-    file->value->stream->get(ch);
-    file->value->stream->close();
-    return ch;
+    const FileStorage::Guard guard;
+    return file->value->storage->read(index);
 }
 
-// Opens the file in both input and output mode to allow writing without truncating.
-// Writes the character at the specified index, flushes changes, and closes the stream.
+// Writes the character at the specified index through the storage of the file.
+// A cached page is written back to the physical file later (eviction, cat/copy/wc, sync or exit).
+// The counts kept for wc are updated first, from the character replaced and its neighbours.
+// A small content growing past the inline limit is moved into its backend first.
 CharProxy& CharProxy::operator=(const char c){
-    file->value->stream->clear();
-    file->value->stream->open(file->value->filename, std::ios::in | std::ios::out);
-    file->value->stream->seekp(index);
-    file->value->stream->put(c);
-    file->value->stream->flush();
-    file->value->stream->close();
+    const FileStorage::Guard guard;
+    file->value->noteWrite(index, &c, 1);
+    file->value->reserve(index + 1).write(index, c);
     return *this;
-}
\ No newline at end of file
+}
@@ -1,5 +1,253 @@
 #include "CommandGenerator.h"
+#include "JobTable.h"
+#include "Journal.h"
 #include "sstream"
+#include <algorithm>
+#include <array>
+#include <fcntl.h>
+#include <mutex>
+#include <unistd.h>
+
+// Every command of the terminal, with the amount of arguments it accepts (see CommandSpec).
+static constexpr std::uint8_t unchecked = 255;   // Maximum amount for commands checking their own arguments.
+static constexpr CommandSpec command_specs[] = {
+    {"mkdir",  mkdirCommand,  1, 1, "'mkdir' requires only 1 argument.", true, CommandAccess::Parent, true},
+    {"chdir",  chdirCommand,  1, 1, "'chdir' requires only 1 argument.", true, CommandAccess::Exclusive, false},
+    {"rmdir",  rmdirCommand,  1, 1, "'rmdir' requires only 1 argument.", true, CommandAccess::Exclusive, true},
+    {"ls",     lsCommand,     0, unchecked, nullptr, true, CommandAccess::Directory, false},
+    {"lproot", lprootCommand, 0, 0, "'lproot' requires 0 arguments.", true, CommandAccess::Exclusive, false},
+    {"pwd",    pwdCommand,    0, 0, "'pwd' takes no arguments.", true, CommandAccess::Directory, false},
+    {"read",   readCommand,   2, 3, "'read' requires 2 or 3 arguments.", false, CommandAccess::Parent, true},
+    {"write",  writeCommand,  3, 3, "'write' requires 3 arguments.", false, CommandAccess::Parent, true},
+    {"touch",  touchCommand,  1, unchecked, "'touch' requires 1 argument.", false, CommandAccess::Parent, true},
+    {"copy",   copyCommand,   2, 2, "'copy' requires 2 arguments.", false, CommandAccess::Parents, true},
+    {"remove", removeCommand, 1, 1, "'remove' requires 1 argument.", false, CommandAccess::Parent, true},
+    {"move",   moveCommand,   2, 2, "'move' requires 2 arguments.", false, CommandAccess::Parents, true},
+    {"cat",    catCommand,    1, 1, "'cat' requires 1 argument.", false, CommandAccess::Parent, false},
+    {"wc",     wcCommand,     0, unchecked, nullptr, false, CommandAccess::Parent, false},
+    {"ln",     lnCommand,     2, 2, "'ln' requires 2 arguments.", false, CommandAccess::Exclusive, true},
+    {"sync",   syncCommand,   0, 0, "'sync' takes no arguments.", false, CommandAccess::Exclusive, false},
+    {"stats",  statsCommand,  0, 0, "'stats' takes no arguments.", false, CommandAccess::Exclusive, false},
+    {"save",   saveCommand,   1, 1, "'save' requires 1 argument.", false, CommandAccess::Exclusive, false},
+    {"load",   loadCommand,   1, 1, "'load' requires 1 argument.", false, CommandAccess::Exclusive, true},
+    {"jobs",   jobsCommand,   0, 0, "'jobs' takes no arguments.", false, CommandAccess::None, false},
+    {"wait",   waitCommand,   0, 1, "'wait' requires 0 or 1 argument.", false, CommandAccess::None, false},
+};
+static constexpr size_t command_count = sizeof(command_specs) / sizeof(command_specs[0]);
+static constexpr size_t command_slots = 64;         // Power of two, a few times the amount of commands.
+static constexpr std::uint8_t empty_slot = 0xFF;
+
+// FNV-1a hash of a command name, mixed with a seed.
+static constexpr std::uint32_t commandHash(const std::string_view name, const std::uint32_t seed) {
+    std::uint32_t hash = 2166136261u ^ seed;
+    for (const char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Function that checks if a seed puts every command into its own slot.
+static constexpr bool isPerfectSeed(const std::uint32_t seed) {
+    std::array<bool, command_slots> used{};
+    for (const CommandSpec& spec : command_specs) {
+        const size_t slot = commandHash(spec.name, seed) & (command_slots - 1);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+// Function that searches the first seed without collisions, evaluated by the compiler.
+static constexpr std::uint32_t findPerfectSeed() {
+    std::uint32_t seed = 0;
+    while (!isPerfectSeed(seed)) ++seed;
+    return seed;
+}
+
+static constexpr std::uint32_t command_seed = findPerfectSeed();
+
+// Function that builds the slot -> command index table, evaluated by the compiler.
+static constexpr std::array<std::uint8_t, command_slots> buildCommandSlots() {
+    std::array<std::uint8_t, command_slots> slots{};
+    for (auto& slot : slots) slot = empty_slot;
+    for (size_t i = 0; i < command_count; i++) {
+        slots[commandHash(command_specs[i].name, command_seed) & (command_slots - 1)] = static_cast<std::uint8_t>(i);
+    }
+    return slots;
+}
+
+static constexpr std::array<std::uint8_t, command_slots> command_slots_table = buildCommandSlots();
+
+static_assert(command_count < empty_slot, "Too many commands for the slot table.");
+static_assert(isPerfectSeed(command_seed), "Command hash has collisions.");
+
+// One hash and at most one string compare per lookup.
+const CommandSpec* findCommand(const std::string_view name) {
+    const std::uint8_t index = command_slots_table[commandHash(name, command_seed) & (command_slots - 1)];
+    if (index == empty_slot || command_specs[index].name != name) return nullptr;
+    return &command_specs[index];
+}
+
+// Function that makes a command wait for the background copies it could disturb (see JobTable).
+// Listing a directory uses no content, a command running alone (or 'wc -r') waits for every copy,
+// other commands wait for the copies using the directories (or the physical files) their paths name.
+// A path that does not resolve fails before touching any file, it waits for nothing.
+static void waitForJobs(CommandContext& context, const CommandSpec& spec, const CommandArguments& parameters) {
+    JobTable& jobs = *context.jobs;
+    if (spec.access == CommandAccess::None || spec.access == CommandAccess::Directory) return;
+    if (spec.access == CommandAccess::Exclusive || (spec.handler == wcCommand && !parameters.empty() && parameters[0] == "-r")) {
+        jobs.waitAll(context.output);
+        return;
+    }
+    const size_t paths = std::min<size_t>(spec.access == CommandAccess::Parents ? 2 : 1, parameters.size());
+    std::string_view leaf;
+    for (size_t i = 0; i < paths && !jobs.empty(); i++) {
+        if (isSingleComponent(parameters[i])) {
+            jobs.waitFor(firstPathComponent(parameters[i]), context.output);
+            continue;
+        }
+        const Directory* parent = nullptr;
+        try {
+            parent = context.paths.resolveParent(context.root, parameters[i], leaf);
+        } catch (std::exception&) {
+        }
+        if (parent) {
+            jobs.waitFor(parent, context.output);
+        }
+    }
+}
+
+// Unknown commands are printed, the amount of arguments and the trailing slash of directory commands
+// are checked here, before the function of the command is called.
+bool dispatchCommand(CommandContext& context, const std::string_view line, std::string_view& command, CommandArguments& parameters) {
+    tokenizeCommand(line, command, parameters);
+    const CommandSpec* spec = findCommand(command);
+    if (!spec) {
+        context.output << "Unknown command: " << command << '\n';
+        return false;
+    }
+    if (spec->directoryCommand && !parameters.empty() && line.back() != '/') {
+        throw CommandException("Invalid path: last character has to be a slash.");
+    }
+    if (parameters.size() < spec->minArguments || parameters.size() > spec->maxArguments) {
+        throw CommandException(spec->arityError);
+    }
+    if (context.jobs && !context.jobs->empty()) {
+        waitForJobs(context, *spec, parameters);
+    }
+    Journal& journal = Journal::instance();
+    const bool journaled = spec->journaled && journal.isActive() && !(spec->handler == readCommand && parameters.size() == 3);
+
+    // A tree shared by sessions: commands using more than one Directory (or the session list) run alone,
+    // and so do journaled commands, so the journal holds them in the order they change the tree.
+    // The record is waited for after the mutex is released, so concurrent sessions share a commit.
+    // A failed command waits too, it may have changed part of the tree (like 'touch' of several files).
+    const bool wholeTree = spec->access == CommandAccess::Exclusive || spec->access == CommandAccess::Parents ||
+                           (spec->handler == wcCommand && !parameters.empty() && parameters[0] == "-r") || journaled;
+    std::uint64_t record = 0;
+    try {
+        if (!context.shared) {
+            if (journaled) record = journal.append(line);
+            spec->handler(context, parameters);
+        } else if (wholeTree) {
+            const std::unique_lock<std::shared_mutex> lock(context.shared->mutex);
+            if (journaled) record = journal.append(line);
+            spec->handler(context, parameters);
+        } else {
+            const std::shared_lock<std::shared_mutex> lock(context.shared->mutex);
+            spec->handler(context, parameters);
+        }
+    } catch (...) {
+        if (record) journal.waitDurable(record);
+        throw;
+    }
+    if (record) journal.waitDurable(record);
+    return true;
+}
+
+// Function that removes the physical file a replayed record is about to create (touch, and the target of copy,
+// move and ln), if the replayed tree does not hold that file yet. A file of that name was left by the run that
+// crashed, created by this same record, and may hold changes that never reached the journal.
+// Host files no record creates are left alone, even when named like the tree (a 'V!x' copied into it).
+static void removeLeftover(CommandContext& context, const std::string_view line) {
+    std::string_view command;
+    CommandArguments parameters;
+    tokenizeCommand(line, command, parameters);
+    const CommandSpec* spec = findCommand(command);
+    if (!spec) return;
+    size_t target;
+    if (spec->handler == touchCommand) target = 0;
+    else if (spec->handler == copyCommand || spec->handler == moveCommand || spec->handler == lnCommand) target = 1;
+    else return;
+    if (parameters.size() <= target || isSingleComponent(parameters[target])) return;
+    try {
+        std::string_view leaf;
+        const Directory* parent = context.paths.resolveParent(context.root, parameters[target], leaf);
+        if (!parent || parent->isFileExists(leaf) != -1) return;
+        std::string physical;
+        parent->getFullPath(physical, '!');
+        physical += '!';
+        physical += leaf;
+        ::unlink(physical.c_str());
+    } catch (std::exception&) {             // The record fails the same way when it is replayed.
+    }
+}
+
+// The commands run in a context of their own, printing into /dev/null, a command that failed
+// before the crash fails the same way again. Replayed commands are not appended a second time,
+// the journal only starts appending once it was replayed.
+size_t replayJournal(Directory& root, PathCache& paths, const std::string& journal) {
+    const int discard = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    size_t replayed = 0;
+    {
+        OutputBuffer output(discard, discard);
+        Directory* workingDirectory = &root;
+        CommandContext context{root, paths, workingDirectory, output};
+        std::string_view command;
+        CommandArguments parameters;
+        Journal::instance().open(journal, [&](const std::string_view line) {
+            ++replayed;
+            removeLeftover(context, line);
+            try {
+                dispatchCommand(context, line, command, parameters);
+            } catch (std::exception&) {
+            }
+        });
+    }
+    if (discard >= 0) {
+        ::close(discard);
+    }
+    return replayed;
+}
+
+// The pending output is flushed first, so the error shows up right after it.
+void printCommandError(OutputBuffer& output, const char* message) {
+    output.error(message);
+}
+
+// Function that checks if a character separates tokens, the same characters operator>> skips.
+static bool isSeparator(const char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// The function splits 'mkdir V/a/' into the command 'mkdir' and the argument 'V/a/'.
+// An empty line gives an empty command.
+void tokenizeCommand(const std::string_view line, std::string_view& command, CommandArguments& arguments) {
+    arguments.clear();
+    command = std::string_view();
+    size_t position = 0;
+    const size_t length = line.length();
+    while (true) {
+        while (position < length && isSeparator(line[position])) ++position;
+        if (position == length) return;
+        const size_t begin = position;
+        while (position < length && !isSeparator(line[position])) ++position;
+        const std::string_view token = line.substr(begin, position - begin);
+        if (command.empty()) command = token;
+        else arguments.push_back(token);
+    }
+}
 
 // The function receives a path, and separates him via the delimiter.
 // For example, 'V/gg/tt/ss/h', splits it into 'V','gg','tt','ss','h', return the vector.
@@ -14,4 +262,25 @@ std::vector<std::string> separatePath(const std::string& path, const char delimi
         if (!item.empty()) result.push_back(item);
     }
     return result;
-}
\ No newline at end of file
+}
+
+// The function returns the first component of a path, for example 'V/gg/tt' returns 'V'.
+// Returns an empty string for an empty path.
+std::string_view firstPathComponent(const std::string_view path) {
+    if (path.find("//") != std::string_view::npos) {
+        throw CommandException("Invalid path: contains consecutive slashes.");
+    }
+    const size_t begin = path.find_first_not_of('/');
+    if (begin == std::string_view::npos) return std::string_view();
+    const size_t end = path.find('/', begin);
+    return path.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+}
+
+// The function checks if a path has exactly one component, for example 'test.txt' or 'test.txt/'.
+bool isSingleComponent(const std::string_view path) {
+    const size_t begin = path.find_first_not_of('/');
+    if (begin == std::string_view::npos) return false;
+    const size_t end = path.find_last_not_of('/');
+    const size_t slash = path.find('/', begin);
+    return slash == std::string_view::npos || slash > end;
+}
@@ -2,24 +2,128 @@
 #define FIRSTPROJECT_COMMANDGENERATOR_H
 
 #include "Directory.h"
-#include <functional>
+#include "PathCache.h"
+#include "OutputBuffer.h"
+#include <cstdint>
+#include <shared_mutex>
 #include <string>
-#include <map>
+#include <string_view>
+#include <vector>
+
+class JobTable;     // Forward declaration to eliminate circular including.
+
+// Arguments of one command, viewing into the line buffer of the Terminal (valid until the next line is read).
+using CommandArguments = std::vector<std::string_view>;
+
+// A tree served to several sessions at once by a daemon (see Daemon.h).
+// Every command holds the mutex: shared if it uses one Directory (which it locks itself, see Directory::Lock),
+// exclusive if it uses several, or changes the working directories (chdir, rmdir, ln, copy, move, lproot, ...).
+struct SharedTree {
+    std::shared_mutex mutex;
+    std::vector<Directory**> workingDirectories;    //< Working directory of every session, rmdir moves them.
+};
+
+// Everything of the Terminal a command may use: the root directory and the path cache for searching,
+// the working directory (chdir and rmdir change it), the output buffer,
+// the state shared with other sessions (nullptr outside of a daemon),
+// and the copies running in the background (nullptr where copies run in place: daemons and parallel scripts).
+struct CommandContext {
+    Directory& root;
+    PathCache& paths;
+    Directory*& workingDirectory;
+    OutputBuffer& output;
+    SharedTree* shared = nullptr;
+    JobTable* jobs = nullptr;
+};
 
 // Alias for the actual Function, to reduce line space.
-using CommandFunction = std::function<void(const std::vector<std::string>&)>;
+using CommandHandler = void (*)(CommandContext&, const CommandArguments&);
+
+// How a command uses the tree, so a parallel script knows which commands may run together.
+enum class CommandAccess : std::uint8_t {
+    Exclusive,      //< Runs alone (changes the working directory, links contents, or reads everything).
+    Directory,      //< Uses the directory its first argument points to, or the working directory without arguments.
+    Parent,         //< Uses the directory holding the last component of its first argument.
+    Parents,        //< Uses the directories holding the last components of its first two arguments.
+    None            //< Uses nothing of the tree (jobs, wait), runs alone in a parallel script.
+};
+
+/**
+ * CommandSpec describes one command of the terminal: its name, the function executing it,
+ * and the amount of arguments it accepts, checked before the function is called.
+ * Commands with their own argument checks (ls, touch, wc) accept any amount.
+ * Directory commands require a line ending with a slash when they are given arguments.
+ * The access tells a parallel script which directories the command uses, and which background copies it waits for.
+ * Commands changing the tree are journaled (see Journal).
+ * **/
+struct CommandSpec {
+    std::string_view name;
+    CommandHandler handler;
+    std::uint8_t minArguments;
+    std::uint8_t maxArguments;
+    const char* arityError;     //< Message of the CommandException thrown for a wrong amount of arguments.
+    bool directoryCommand;
+    CommandAccess access;
+    bool journaled;             //< Appended to the journal before it runs.
+};
+
+// Function that returns the spec of a command through a compile-time perfect hash, nullptr for an unknown command.
+const CommandSpec* findCommand(std::string_view name);
 
-// Create a map of Directory commands and the functions that correspond to each command.
-// Receives the root directory for searching, also the working directory for chdir.
+// Function that executes one command line, with the output and working directory of the context.
+// Returns false for an unknown command (after printing it), throws the exception of a failed command.
+// With a shared tree, the command runs under its mutex (see SharedTree).
+// A journaled command is appended to the journal right before it runs, and answered once its record is durable.
+// With background copies, the command first waits for the copies it could disturb (see JobTable).
+bool dispatchCommand(CommandContext& context, std::string_view line, std::string_view& command, CommandArguments& parameters);
+
+// Function that rebuilds a tree from a journal: every journaled command is run again without printing anything,
+// and a physical file left by the crashed run is removed right before the command that created it runs again. Returns the amount of replayed commands.
+// From then on, the commands changing the tree are appended to the journal.
+size_t replayJournal(Directory& root, PathCache& paths, const std::string& journal);
+
+// Function that prints the error of a failed command (to stderr, or to the socket of a session),
+// after the output printed before it.
+void printCommandError(OutputBuffer& output, const char* message);
+
+// Function that splits a line into the command and its arguments, on whitespace, without copying any of them.
+// 'arguments' is cleared and refilled, so the Terminal reuses its capacity for every line.
+void tokenizeCommand(std::string_view line, std::string_view& command, CommandArguments& arguments);
+
+// Directory commands (DirectoryCommands.cpp).
 // (mkdir, rmdir, chdir, etc.)
-std::map<std::string, CommandFunction> buildDirectoryCommandsMap(Directory& root, Directory* workingDirectory);
+void mkdirCommand(CommandContext& context, const CommandArguments& parameters);
+void chdirCommand(CommandContext& context, const CommandArguments& parameters);
+void rmdirCommand(CommandContext& context, const CommandArguments& parameters);
+void lsCommand(CommandContext& context, const CommandArguments& parameters);
+void lprootCommand(CommandContext& context, const CommandArguments& parameters);
+void pwdCommand(CommandContext& context, const CommandArguments& parameters);
+void saveCommand(CommandContext& context, const CommandArguments& parameters);
+void loadCommand(CommandContext& context, const CommandArguments& parameters);
 
-// Create a map of File commands and the functions that correspond to each command.
-// Receives the root directory for searching,
+// File commands (FilesCommands.cpp).
 // (cat, touch, write, etc.)
-std::map<std::string, CommandFunction> buildFileCommandsMap(Directory& root);
+void readCommand(CommandContext& context, const CommandArguments& parameters);
+void writeCommand(CommandContext& context, const CommandArguments& parameters);
+void touchCommand(CommandContext& context, const CommandArguments& parameters);
+void copyCommand(CommandContext& context, const CommandArguments& parameters);
+void removeCommand(CommandContext& context, const CommandArguments& parameters);
+void moveCommand(CommandContext& context, const CommandArguments& parameters);
+void catCommand(CommandContext& context, const CommandArguments& parameters);
+void wcCommand(CommandContext& context, const CommandArguments& parameters);
+void lnCommand(CommandContext& context, const CommandArguments& parameters);
+void syncCommand(CommandContext& context, const CommandArguments& parameters);
+void statsCommand(CommandContext& context, const CommandArguments& parameters);
+void jobsCommand(CommandContext& context, const CommandArguments& parameters);
+void waitCommand(CommandContext& context, const CommandArguments& parameters);
 
 // Function that separates a path by a delimiter returns the separated path as a vector.
 std::vector<std::string> separatePath(const std::string& path, char delimiter = '/');
 
-#endif //FIRSTPROJECT_COMMANDGENERATOR_H
\ No newline at end of file
+// Function that returns the first component of a path, without splitting the rest of it.
+std::string_view firstPathComponent(std::string_view path);
+
+// Function that checks if a path is made of a single component (a physical file name).
+bool isSingleComponent(std::string_view path);
+
+#endif //FIRSTPROJECT_COMMANDGENERATOR_H
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Daemon.h"
+#include "ScriptReader.h"
+#include "Snapshot.h"
+#include "Journal.h"
+#include "FileSystemException.h"
+
+int Daemon::wakeup[2] = {-1, -1};
+
+// Signal handler of SIGINT and SIGTERM, only wakes up run() (writing into a pipe is async-signal-safe).
+void Daemon::onSignal(int) {
+    const char byte = 0;
+    const ssize_t written = ::write(wakeup[1], &byte, 1);
+    (void) written;
+}
+
+// Function that fills the address of a Unix domain socket, throws FileSystemException if the path does not fit.
+static sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.length() >= sizeof(address.sun_path)) {
+        throw FileSystemException("Invalid socket path.");
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.length() + 1);
+    return address;
+}
+
+// Function that connects a new socket to an address, returns the socket, or -1 if nobody listens there.
+static int connectTo(const sockaddr_un& address) {
+    const int descriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (descriptor < 0) return -1;
+    if (::connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(descriptor);
+        return -1;
+    }
+    return descriptor;
+}
+
+// Constructor, binds and listens on the socket path.
+// A socket file left by a daemon that is gone refuses connections, it is replaced. A live one is not.
+Daemon::Daemon(const std::string& rootName, std::string path, const StorageBackend backend)
+    : backendUse(backend), root(rootName, nullptr), socketPath(std::move(path)), listener(-1) {
+    const sockaddr_un address = socketAddress(socketPath);
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        throw FileSystemException("Failed to create the daemon socket.");
+    }
+    const auto bindAddress = [this, &address] {
+        return ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    };
+    bool bound = bindAddress();
+    if (!bound && errno == EADDRINUSE) {
+        const int live = connectTo(address);
+        if (live >= 0) {
+            ::close(live);
+        } else if (::unlink(socketPath.c_str()) == 0) {
+            bound = bindAddress();
+        }
+    }
+    if (!bound || ::listen(listener, SOMAXCONN) != 0) {
+        ::close(listener);
+        listener = -1;
+        throw FileSystemException("Failed to listen on the daemon socket (in use, or not writable).");
+    }
+}
+
+// Destructor, closes and removes the listening socket.
+Daemon::~Daemon() {
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+    }
+}
+
+// Loads a snapshot image into the root, no session is connected yet. The load is journaled like the 'load' command.
+void Daemon::load(const std::string& snapshot) {
+    Journal& journal = Journal::instance();
+    const std::uint64_t record = journal.isActive() ? journal.append("load " + snapshot) : 0;
+    Snapshot::load(root, snapshot);
+    if (record) journal.waitDurable(record);
+}
+
+// Rebuilds the tree from a journal, no session is connected yet.
+size_t Daemon::recover(const std::string& journal) {
+    return replayJournal(root, paths, journal);
+}
+
+// Function that accepts sessions, each one runs on its own thread, until SIGINT or SIGTERM.
+// Then every session is disconnected (its thread sees the end of its input), the threads are joined,
+// and the physical files are removed and written back like on 'exit' of the terminal.
+void Daemon::run() {
+    if (::pipe2(wakeup, O_CLOEXEC | O_NONBLOCK) != 0) {
+        throw FileSystemException("Failed to create the daemon pipe.");
+    }
+    struct sigaction action{};
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;           // Reads and writes of the sessions are not interrupted.
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);          // A client leaving while it is answered must not stop the daemon.
+    FileStorage::setConcurrent(true);
+    Directory::setConcurrent(true);
+
+    pollfd polled[2] = {{listener, POLLIN, 0}, {wakeup[0], POLLIN, 0}};
+    while (true) {
+        if (::poll(polled, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (polled[1].revents != 0) break;
+        if ((polled[0].revents & POLLIN) == 0) continue;
+        const int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        reap(false);
+        sessions.emplace_back(client, root, paths, shared);
+        Session& session = sessions.back();
+        try {
+            session.thread = std::thread(&Daemon::serve, this, std::ref(session));
+        } catch (std::exception&) {
+            ::close(client);
+            sessions.pop_back();
+        }
+    }
+
+    for (Session& session : sessions) {
+        ::shutdown(session.descriptor, SHUT_RDWR);
+    }
+    reap(true);
+    Directory::setConcurrent(false);
+    FileStorage::setConcurrent(false);
+    root.clearFiles(root);
+    FileStorage::syncAll();
+    Journal::instance().reset();
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    ::close(wakeup[0]);
+    ::close(wakeup[1]);
+    wakeup[0] = wakeup[1] = -1;
+}
+
+// Function that runs the commands of one session, the lines are views into the reader of its socket.
+// The output is flushed whenever the next line has not arrived yet, so a client sending one command
+// at a time gets every answer right away, and a client sending many gets them in large writes.
+void Daemon::serve(Session& session) {
+    {
+        const std::unique_lock<std::shared_mutex> lock(shared.mutex);
+        shared.workingDirectories.push_back(&session.workingDirectory);
+    }
+    std::string_view command;
+    CommandArguments parameters;
+    try {
+        ScriptReader reader(session.descriptor);
+        std::string_view line;
+        while (reader.nextLine(line) && line != "exit") {
+            try {
+                dispatchCommand(session.context, line, command, parameters);
+            } catch (std::exception& e) {
+                printCommandError(session.output, e.what());
+            }
+            if (!reader.hasLine()) {
+                session.output.flush();
+            }
+        }
+    } catch (std::exception&) {}            // The session cannot continue (out of memory), the daemon does.
+    session.output.flush();
+    {
+        const std::unique_lock<std::shared_mutex> lock(shared.mutex);
+        auto& directories = shared.workingDirectories;
+        directories.erase(std::find(directories.begin(), directories.end(), &session.workingDirectory));
+    }
+    ::shutdown(session.descriptor, SHUT_RDWR);     // The client sees the end now, the descriptor is closed by reap.
+    session.finished = true;
+}
+
+// Function that joins the threads of the sessions that ended (or of every session), and closes their sockets.
+void Daemon::reap(const bool all) {
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        if (!all && !it->finished) {
+            ++it;
+            continue;
+        }
+        it->thread.join();
+        ::close(it->descriptor);
+        it = sessions.erase(it);
+    }
+}
+
+// Function that relays stdin to a daemon and its answers to stdout, until the daemon closes the session.
+// The socket is written without blocking, so a long answer is read while the rest of the input is pending.
+// At the end of stdin the sending side of the socket is shut down, the daemon sees it like 'exit'.
+int Daemon::connect(const std::string& socketPath) {
+    const int server = connectTo(socketAddress(socketPath));
+    if (server < 0) {
+        throw FileSystemException("Failed to connect to the daemon.");
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    ::fcntl(server, F_SETFL, ::fcntl(server, F_GETFL) | O_NONBLOCK);
+
+    char input[64 * 1024];
+    char answer[64 * 1024];
+    size_t pendingBegin = 0, pendingEnd = 0;    // Input read from stdin, not sent yet.
+    bool inputOpen = true;
+    while (true) {
+        pollfd polled[2] = {{inputOpen && pendingBegin == pendingEnd ? STDIN_FILENO : -1, POLLIN, 0},
+                            {server, static_cast<short>(POLLIN | (pendingBegin < pendingEnd ? POLLOUT : 0)), 0}};
+        if (::poll(polled, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (polled[0].revents != 0) {
+            const ssize_t count = ::read(STDIN_FILENO, input, sizeof(input));
+            if (count > 0) {
+                pendingBegin = 0;
+                pendingEnd = static_cast<size_t>(count);
+            } else if (count == 0 || errno != EINTR) {
+                inputOpen = false;
+                ::shutdown(server, SHUT_WR);
+            }
+        }
+        if ((polled[1].revents & POLLOUT) != 0) {
+            const ssize_t count = ::write(server, input + pendingBegin, pendingEnd - pendingBegin);
+            if (count > 0) {
+                pendingBegin += static_cast<size_t>(count);
+            } else if (errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+        }
+        if ((polled[1].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+            const ssize_t count = ::read(server, answer, sizeof(answer));
+            if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) break;
+            for (ssize_t written = 0; written < count;) {
+                const ssize_t step = ::write(STDOUT_FILENO, answer + written, static_cast<size_t>(count - written));
+                if (step <= 0) break;
+                written += step;
+            }
+        }
+    }
+    ::close(server);
+    return 0;
+}
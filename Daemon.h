@@ -0,0 +1,79 @@
+#ifndef FIRSTPROJECT_DAEMON_H
+#define FIRSTPROJECT_DAEMON_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "Directory.h"
+#include "FileStorage.h"
+#include "PathCache.h"
+#include "OutputBuffer.h"
+#include "CommandGenerator.h"
+
+/**
+ * Daemon owns one virtual tree and serves it to many terminal sessions over a local Unix domain socket.
+ * Every connection is a session running on its own thread, with its own working directory and output,
+ * reading commands from the socket and printing the output and the errors back into it.
+ * Sessions share the root, the path cache and the storage layer:
+ *  - every command holds the SharedTree mutex, shared for commands using one Directory, which they lock
+ *    themselves (Directory::Lock: shared for ls, cat, wc and read, exclusive for touch, write, remove, mkdir,
+ *    and for a read right after the last character, which extends the count),
+ *    exclusive for commands using several directories or the working directories of other sessions.
+ *  - the storage layer is serialized by FileStorage::Guard, cat and wc only hold it to write back the file.
+ * 'exit' (or closing the connection) ends the session only. SIGINT or SIGTERM stop the daemon: the sessions
+ * are disconnected, the physical files are removed like on 'exit' of the terminal, and the socket is unlinked.
+ * **/
+class Daemon {
+    struct Session {
+        int descriptor;                     //< Socket of the client, closed by the daemon after the thread ended.
+        Directory* workingDirectory;        //< Working directory of this session.
+        OutputBuffer output;                //< Output and errors of the session, written into the socket.
+        CommandContext context;             //< What the commands of this session use.
+        std::thread thread;
+        std::atomic<bool> finished;         //< Set by the thread once the session ended.
+
+        Session(int descriptor, Directory& root, PathCache& paths, SharedTree& shared)
+            : descriptor(descriptor), workingDirectory(&root), output(descriptor, descriptor),
+              context{root, paths, workingDirectory, output, &shared}, finished(false) {}
+    };
+
+    FileStorage::BackendUse backendUse;     //< Holds the storage backend of the process while the daemon lives.
+    Directory root;                         //< Root Directory served to every session.
+    PathCache paths;                        //< Shared by every session.
+    SharedTree shared;                      //< Mutex held by the commands, and the working directories.
+    std::string socketPath;                 //< Path of the listening socket.
+    int listener;                           //< Listening socket.
+    std::list<Session> sessions;            //< Connected sessions (a list, so a Session never moves).
+
+    static int wakeup[2];                   //< Pipe written by the signal handler, wakes up run().
+    static void onSignal(int signal);
+
+    void serve(Session& session);           // Runs the commands of one session until 'exit' or disconnection.
+    void reap(bool all);                    // Joins and closes finished sessions (every session if 'all').
+
+public:
+    // Holds the storage backend of the process and creates the listening socket (replacing a stale one),
+    // throws FileSystemException (also if another terminal or daemon of the process uses a different backend).
+    Daemon(const std::string& rootName, std::string socketPath, StorageBackend backend = StorageBackend::Stream);
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+    ~Daemon();
+
+    // Rebuilds the tree of a crashed daemon from its journal, and journals from then on, before run() (see Journal).
+    // Returns the amount of replayed commands.
+    size_t recover(const std::string& journal);
+
+    // Replaces the tree with the one saved in a snapshot image, before run() (see Snapshot).
+    void load(const std::string& snapshot);
+
+    // Accepts sessions until SIGINT or SIGTERM, then disconnects them and removes the physical files.
+    void run();
+
+    // Connects to a daemon, sends stdin to it and prints what it answers, returns the exit status.
+    static int connect(const std::string& socketPath);
+};
+
+#endif //FIRSTPROJECT_DAEMON_H
@@ -1,20 +1,126 @@
 #include "Directory.h"
-#include <iostream>
 #include <algorithm>
 #include "FileSystemException.h"
+#include "AsyncIO.h"
 
-// Function that adds a new File into the vector and returns his index.
-int Directory::addFile(const std::string &filename) {
-    const std::string path = getFullPath() + filename;
-    files.emplace_back(path);
+bool Directory::concurrent = false;
+
+// Function that enables or disables Lock, called by the daemon before the first session and after the last one.
+void Directory::setConcurrent(const bool enabled) {
+    concurrent = enabled;
+}
+
+// Function that locks a Directory (shared or exclusive), after releasing the Directory locked before.
+void Directory::Lock::acquire(const Directory& directory, const bool exclusiveAccess) {
+    release();
+    if (!concurrent) return;
+    locked = &directory.mutex;
+    exclusive = exclusiveAccess;
+    if (exclusive) locked->lock();
+    else locked->lock_shared();
+}
+
+// Function that releases the locked Directory, if any.
+void Directory::Lock::release() {
+    if (!locked) return;
+    if (exclusive) locked->unlock();
+    else locked->unlock_shared();
+    locked = nullptr;
+}
+
+// Function that adds a new File into the vector, registers it in the name index and returns his index.
+// Growing the vector moves the Files, so the reference counts of their contents do not change.
+int Directory::addFile(const std::string_view filename) {
+    const NameId id = NameTable::instance().intern(filename);
+    files.emplace_back(this, id);
+    fileIndex.emplace(id, files.size() - 1);
     return static_cast<int>(files.size()) - 1;
 }
 
+// Function that drops the empty slots left by removed files, keeping the order of the others,
+// and writes their new positions into the name index. It only runs once half of the slots are empty,
+// so it costs O(1) per removed file, however many files the directory holds.
+void Directory::squeezeFiles() {
+    files.erase(std::remove_if(files.begin(), files.end(),
+                               [](const File& file) { return file.getNameId() == NameTable::none; }),
+                files.end());
+    removedFiles = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        fileIndex[files[i].getNameId()] = i;
+    }
+}
+
+// Function that returns the subdirectory with the given name via the name index, nullptr if there is none.
+Directory* Directory::findSubDirectory(const std::string_view name) {
+    const Lock lock(*this, false);
+    const auto found = subDirectoryIndex.find(NameTable::instance().find(name));
+    return found == subDirectoryIndex.end() ? nullptr : found->second;
+}
+
+// Function that returns the arena shared by every subdirectory.
+NodePool<Directory>& Directory::pool() {
+    static NodePool<Directory> nodes;
+    return nodes;
+}
+
+// Destructor, returns the whole subtree into the pool.
+Directory::~Directory() {
+    releaseChildren();
+}
+
+// Function that links a new subdirectory after the last one, and registers it in the name index.
+void Directory::linkChild(Directory* child) {
+    child->previousSibling = lastChild;
+    child->nextSibling = nullptr;
+    if (lastChild) lastChild->nextSibling = child;
+    else firstChild = child;
+    lastChild = child;
+    subDirectoryIndex.emplace(child->name, child);
+}
+
+// Function that unlinks a subdirectory from the list of siblings, and from the name index.
+void Directory::unlinkChild(Directory* child) {
+    if (child->previousSibling) child->previousSibling->nextSibling = child->nextSibling;
+    else firstChild = child->nextSibling;
+    if (child->nextSibling) child->nextSibling->previousSibling = child->previousSibling;
+    else lastChild = child->previousSibling;
+    child->previousSibling = child->nextSibling = nullptr;
+    subDirectoryIndex.erase(child->name);
+}
+
+// Function that destroys every subdirectory of this Directory.
+// Uses an explicit stack instead of recursion, so very deep trees cannot overflow the call stack.
+void Directory::releaseChildren() {
+    std::vector<Directory*> pending;
+    for (Directory* child = firstChild; child; child = child->nextSibling) {
+        pending.push_back(child);
+    }
+    firstChild = lastChild = nullptr;
+    subDirectoryIndex.clear();
+    while (!pending.empty()) {
+        Directory* current = pending.back();
+        pending.pop_back();
+        for (Directory* child = current->firstChild; child; child = child->nextSibling) {
+            pending.push_back(child);
+        }
+        current->firstChild = current->lastChild = nullptr;     // Children are already pending.
+        pool().destroy(current);
+    }
+}
+
+// Function that checks if this Directory is the given ancestor, or lies anywhere below it.
+bool Directory::isInside(const Directory* ancestor) const {
+    for (const Directory* current = this; current; current = current->parent) {
+        if (current == ancestor) return true;
+    }
+    return false;
+}
+
 // Function that validates that the path exists from the root, until the last directory.
 // Check if the last part of path exists, if not create a new Directory,
 // else throw DirectoryAlreadyExistsException.
 void Directory::mkdir(const std::vector<std::string>& path) {
-    if (path.empty() || path[0] != directoryName) {
+    if (path.empty() || path[0] != getDirectoryName()) {
         throw LocationException("Invalid path: must start from root.");
     }
     if (path.size() == 1) {
@@ -22,21 +128,23 @@ void Directory::mkdir(const std::vector<std::string>& path) {
     }
     const std::vector<std::string> parentPath(path.begin() + 1,path.end() - 1);
     Directory* current = depthSearch(parentPath);
+    current->addSubDirectory(path.back());
+}
 
-    const std::string& targetDirectory = path.back();
-    for (auto& sub : current->subDirectories) {         // Check if the last of the path exists.
-        if (sub.directoryName == targetDirectory) {
-            throw DirectoryAlreadyExistsException("Directory already exists at targetDirectory location.");
-        }
+// Function that creates a new Directory inside this one, if the name is not taken yet,
+// else throw DirectoryAlreadyExistsException.
+void Directory::addSubDirectory(const std::string_view name) {
+    const Lock lock(*this, true);
+    if (subDirectoryIndex.count(NameTable::instance().find(name)) != 0) {
+        throw DirectoryAlreadyExistsException("Directory already exists at targetDirectory location.");
     }
-
-    current->subDirectories.emplace_back(targetDirectory, current);
+    linkChild(pool().create(NameTable::instance().intern(name), this));
 }
 
 // Function to change the current working-directory, check if the path exists with
 // depthSearch, and return a pointer if found, or throw DirectoryNotFoundException.
 Directory* Directory::chdir(const std::vector<std::string>& path) {
-    if (path.empty() || path[0] != directoryName) {
+    if (path.empty() || path[0] != getDirectoryName()) {
         throw LocationException("Invalid path: must start from root.");
     }
     const std::vector<std::string> subPath(path.begin() + 1, path.end());
@@ -48,98 +156,90 @@ Directory* Directory::chdir(const std::vector<std::string>& path) {
     return depthSearch(subPath);
 }
 
-// Function to remove a directory, finds the directory to remove, if found, it gets removed
-// from the directory vector via the parent directory, if the working-directory is removed,
-// it gets transferred to its parent.
-Directory* Directory::rmdir(const std::vector<std::string>& path, const Directory* workingDirectory) {
-    if (path.empty() || path[0] != directoryName) {
+// Function to remove a directory, finds the directory to remove, if found, it gets unlinked
+// from the parent directory and returned to the pool, if the working-directory is removed
+// (or lies inside the removed subtree), it gets transferred to the parent of the removed directory.
+Directory* Directory::rmdir(const std::vector<std::string>& path, Directory* workingDirectory) {
+    if (path.empty() || path[0] != getDirectoryName()) {
         throw LocationException("Invalid path: must start from root.");
     }
 
     const std::vector<std::string> parentPath(path.begin() + 1, path.end() - 1);
     Directory *current = depthSearch(parentPath);         // Find the parent directory of toBeRemoved.
-    const std::string& target = path.back();
-
-    const Directory* toBeRemoved = nullptr;
-    for (auto &sub : current->subDirectories) {     // Find the directory to remove.
-        if (sub.directoryName == target) {
-            toBeRemoved = &sub;
-            break;
-        }
-    }
+    return current->removeSubDirectory(path.back(), workingDirectory);
+}
 
+// Function that removes a Directory inside this one with all its files, and returns the new working-directory.
+// If the working-directory lies inside the removed subtree, this Directory becomes the working-directory.
+Directory* Directory::removeSubDirectory(const std::string_view name, Directory* workingDirectory) {
+    Directory* toBeRemoved = findSubDirectory(name);    // Find the directory to remove.
     if (!toBeRemoved) {
         throw DirectoryNotFoundException("Target directory not found.");
     }
 
-    // Validate the removal.
-    const auto it = std::find_if(current->subDirectories.begin(),current->subDirectories.end(), [&](const Directory& d) {
-        return d.directoryName == target;
-    });
-
-    if (it == current->subDirectories.end()) {
-        throw DirectoryNotFoundException("Directory not found at target location.");
-    }
-    clearFiles(*it);
-    current->subDirectories.erase(it);
-    if (workingDirectory == toBeRemoved) {
-        return current;
+    const bool movesWorkingDirectory = workingDirectory->isInside(toBeRemoved);
+    clearFiles(*toBeRemoved);
+    unlinkChild(toBeRemoved);
+    pool().destroy(toBeRemoved);
+    if (movesWorkingDirectory) {
+        return this;
     }
-    return this;
+    return workingDirectory;
 }
 
 // Function that prints the content of the folder given a path.
 // If a function is called from lproot, also print the reference count for all files.
-void Directory::ls(const std::string& path, const std::string& lp_root){
-    std::cout << path + "/:\n";
+void Directory::ls(OutputBuffer& output, const std::string& path, const bool references) const {
+    const Lock lock(*this, false);
+    output << path << "/:\n";
     int i = 1;
-    for(const auto& directory : subDirectories){      // Print all directory names.
+    for(const Directory* directory = firstChild; directory; directory = directory->nextSibling){   // Print all directory names.
         if( i % tab_amount == 0)
-            std::cout << "\n";
-        std::cout << "\t" << directory.directoryName << "\t";
+            output << '\n';
+        output << '\t' << directory->getDirectoryName() << '\t';
         i++;
     }
-    for(int j = 0; j < static_cast<int>(files.size()); j++){               // Print all File names.
+    for(const File& file : files){                                          // Print all File names.
+        if (file.getNameId() == NameTable::none) continue;                  // Slot of a removed file.
         if( i % tab_amount == 0)
-            std::cout << "\n";
-        if(lp_root == "HL"){
-            std::cout << "\t" << getFileAt(j).getFileName() << " " << getFileAt(j).getRefCounter() << "\t";
-        }else {
-            std::cout << "\t" << getFileAt(j).getFileName() << "\t";
+            output << '\n';
+        output << '\t' << file.getFileName();
+        if(references){
+            output << ' ' << file.getRefCounter();
         }
+        output << '\t';
         i++;
     }
-    if (i % tab_amount != 1) std::cout << "\n";
+    if (i % tab_amount != 1) output << '\n';
 }
 
-// Function that prints all the file names, with directory names, across the whole
-// File System recursively.
-void Directory::lproot(const std::string& path) {
-    const std::string Path = path + directoryName;
-    ls(Path,"HL");
-    for (auto& sub : subDirectories) {
-        sub.lproot(path + directoryName + "/");
+// Function that prints all the file names, with directory names, across the whole File System.
+// Walks the tree with an explicit stack (deepest first, subdirectories in order), and keeps the current path
+// in one buffer: a pending directory only remembers how long its parent's path is, and its name is written over
+// whatever the previous subtree left there, so no path string is allocated per directory.
+void Directory::lproot(OutputBuffer& output) const {
+    std::vector<std::pair<const Directory*, size_t>> pending(1, std::make_pair(this, size_t(0)));
+    std::string path;
+    while (!pending.empty()) {
+        const Directory* current = pending.back().first;
+        path.resize(pending.back().second);
+        pending.pop_back();
+        path += current->getDirectoryName();
+        current->ls(output, path, true);
+        path += '/';
+        const size_t firstPushed = pending.size();
+        for (const Directory* sub = current->firstChild; sub; sub = sub->nextSibling) {
+            pending.emplace_back(sub, path.size());
+        }
+        std::reverse(pending.begin() + static_cast<long>(firstPushed), pending.end());   // First subdirectory on top.
     }
 }
 
 // Function that prints the working-directory via going backwards in the directory tree with parent pointer.
-// Reverse the vector to get the accurate path, and print to user.
-void Directory::pwd() const {
-    std::vector<std::string> pathInParts;
-    const Directory* current = this;
-
-    while(current != nullptr){
-        pathInParts.push_back(current->directoryName);
-        current = current->parent;
-    }
-
-    std::reverse(pathInParts.begin(),pathInParts.end());
-
+void Directory::pwd(OutputBuffer& output) const {
     std::string fullPwd;
-    for(const auto& part : pathInParts){
-        fullPwd += part + "/";
-    }
-    std::cout << fullPwd << "\n";
+    getFullPath(fullPwd, '/');
+    output << fullPwd << "/\n";
 }
 
 // Function that traverses the directory tree of vectors, if the whole path given was found,
@@ -147,42 +247,43 @@ void Directory::pwd() const {
 Directory* Directory::depthSearch(const std::vector<std::string> &path) {
     Directory* current = this;
     for (const auto &part: path) {
-        bool target = false;
-
-        for (auto &sub: current->subDirectories) {
-            if (sub.directoryName == part) {
-                current = &sub;
-                target = true;
-                break;
-            }
-        }
-        if (!target) {
+        current = current->findSubDirectory(part);
+        if (!current) {
             throw DirectoryNotFoundException("Invalid path: Directory was not found.");
         }
     }
     return current;
 }
 
-// Function that returns the whole path of any given directory recursively.
-std::string Directory::getFullPath() const {
-    if (parent == nullptr) return directoryName;
-    return parent->getFullPath() + "!" + directoryName;
+// Function that writes the whole path of a directory into the buffer, names joined by the separator.
+// The length is summed up the parent chain first, then the names are written from the end backwards,
+// so the path is built in place without recursion or temporary strings.
+void Directory::getFullPath(std::string& buffer, const char separator) const {
+    const NameTable& table = NameTable::instance();
+    size_t length = 0;
+    for (const Directory* current = this; current; current = current->parent) {
+        length += table.name(current->name).length() + (current->parent ? 1 : 0);
+    }
+    buffer.resize(length);
+    for (const Directory* current = this; current; current = current->parent) {
+        const std::string& part = table.name(current->name);
+        length -= part.length();
+        buffer.replace(length, part.length(), part);
+        if (current->parent) {
+            buffer[--length] = separator;
+        }
+    }
 }
 
 // Function that returns the current directory name.
 const std::string& Directory::getDirectoryName() const {
-    return directoryName;
+    return NameTable::instance().name(name);
 }
 
-// Function that returns an index of a File from the File vector via name.
-int Directory::isFileExists(const std::string& filename) const{
-    const std::string fullPath = getFullPath() + "!" + filename;
-    for(size_t i = 0 ;i < files.size(); i++){
-        if(files[i].getFullFileName() == fullPath) {
-            return static_cast<int>(i);
-        }
-    }
-    return -1;
+// Function that returns an index of a File from the File vector via the name index.
+int Directory::isFileExists(const std::string_view filename) const{
+    const auto found = fileIndex.find(NameTable::instance().find(filename));
+    return found == fileIndex.end() ? -1 : static_cast<int>(found->second);
 }
 
 // Function that returns a File from the File vector via index.
@@ -193,21 +294,60 @@ File& Directory::getFileAt(const int index) {
     throw FileSystemException("Invalid file index.");
 }
 
-// Function that removes a File from the File vector via index.
+// Function that removes a File from the File vector via index. Its slot is emptied, so the Files after it
+// keep their position (and their order), and only its own entry leaves the name index.
 void Directory::removeFileAt(const int index) {
-    if (index >= 0 && index < static_cast<int>(files.size())) {
-        files.erase(files.begin() + index);
+    if (index >= 0 && index < static_cast<int>(files.size()) && files[index].getNameId() != NameTable::none) {
+        fileIndex.erase(files[index].getNameId());
+        files[index] = File();
+        if (++removedFiles * 2 > files.size()) {
+            squeezeFiles();
+        }
         return;
     }
     throw FileSystemException("Invalid file index.");
 }
 
-// Function that removes all the physical files created by the user recursively.
-void Directory::clearFiles(Directory &directory) {
-    for(File& file : directory.files) {
-        file.remove();
+// Function that visits every file of the subtree in a fixed order (the order lproot prints them).
+// Uses an explicit stack instead of recursion, so very deep trees cannot overflow the call stack.
+void Directory::forEachFile(const std::function<void(const std::string& path, File& file)>& visitor) {
+    std::string path;
+    getFullPath(path, '/');
+    std::vector<std::pair<Directory*, std::string>> pending(1, std::make_pair(this, path + "/"));
+    while (!pending.empty()) {
+        Directory* current = pending.back().first;
+        const std::string prefix = std::move(pending.back().second);
+        pending.pop_back();
+        for (File& file : current->files) {
+            if (file.getNameId() == NameTable::none) continue;
+            path = prefix;
+            path += file.getFileName();
+            visitor(path, file);
+        }
+        const size_t firstPushed = pending.size();
+        for (Directory* sub = current->firstChild; sub; sub = sub->nextSibling) {
+            pending.emplace_back(sub, prefix + sub->getDirectoryName() + "/");
+        }
+        std::reverse(pending.begin() + static_cast<long>(firstPushed), pending.end());   // First subdirectory on top.
     }
-    for(auto& sub: directory.subDirectories){
-        clearFiles(sub);
+}
+
+// Function that removes all the physical files created by the user, across the whole subtree.
+// Uses an explicit stack instead of recursion, so very deep trees cannot overflow the call stack.
+// The unlinks run in the background (see UnlinkBatch) while the walk goes on, a failed one is reported at the end.
+void Directory::clearFiles(Directory &directory) {
+    UnlinkBatch batch;
+    std::vector<Directory*> pending(1, &directory);
+    while (!pending.empty()) {
+        Directory* current = pending.back();
+        pending.pop_back();
+        for(File& file : current->files) {
+            if (file.getNameId() == NameTable::none) continue;
+            file.remove(&batch);
+        }
+        for(Directory* sub = current->firstChild; sub; sub = sub->nextSibling){
+            pending.push_back(sub);
+        }
     }
+    batch.finish();
 }
\ No newline at end of file
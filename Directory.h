@@ -2,48 +2,108 @@
 #define FIRSTPROJECT_DIRECTORY_H
 #include <vector>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <functional>
+#include <shared_mutex>
 #include "File.h"
+#include "NodePool.h"
+#include "NameTable.h"
+#include "OutputBuffer.h"
 
 /**
  *  Directory class.
- *  Simulates a virtual folder and file system tree via vectors.
- *  Each layer of Directories has its own vector of subdirectories and file vector just like in any operating system.
+ *  Simulates a virtual folder and file system tree.
+ *  Each layer of Directories has its own list of subdirectories and file vector just like in any operating system.
+ *  Subdirectories are allocated inside a NodePool, and linked as a list of siblings (in creation order),
+ *  so their addresses never change: mkdir and rmdir are O(1) and never move other subtrees,
+ *  and pointers to a Directory (parent, working-directory) stay valid until it is removed.
+ *  Each Directory has a name index for subdirectories and files, so finding an entry by name does not scan.
+ *  Names are interned in the NameTable, nodes and indexes hold a NameId, and full paths are only
+ *  written (into a reused buffer) when a physical file name is needed.
  *  Holds and executes each of the Directory functions (mkdir,chdir,rmdir,ls,lproot,pwd)
  *  alongside other helper functions.
+ *  While a daemon serves the tree to several sessions, every Directory has a reader/writer lock (see Lock).
 
  The big 3:
-    Not implemented, since the default is enough.
-    1) I never make copies of Directory, only raw pointer assignments (Copy constructor isn't needed)
-    2) I never assign one Directory to another, only raw pointer assignments. (Assignment operator isn't needed)
-    3) I never delete a Directory, since each object is not allocated on the heap, only on stack. (Deconstruction isn't needed).
-    All default operations are enough here.
+    1) Copy constructor - deleted, Directories are only referenced by raw pointers.
+    2) Assignment operator - deleted, for the same reason.
+    3) Destructor - returns the whole subtree into the NodePool.
  * **/
 constexpr int tab_amount = 4;               // Used for printing.
 class Directory {
-    std::string directoryName;              //< Each directory has its own name.
+    friend class Snapshot;
+    NameId name;                            //< Each directory has its own name (interned).
     Directory* parent;                      //< Each directory holds a pointer to his parent.
-    std::vector<Directory> subDirectories;  //< Each directory holds a vector of subdirectories.
-    std::vector<File> files;                //< Each directory holds a vector of files.
+    Directory* firstChild = nullptr;        //< First subdirectory, in creation order.
+    Directory* lastChild = nullptr;         //< Last subdirectory, new subdirectories are linked after it.
+    Directory* previousSibling = nullptr;   //< Previous subdirectory of the parent.
+    Directory* nextSibling = nullptr;       //< Next subdirectory of the parent.
+    std::vector<File> files;                //< Each directory holds a vector of files, a removed one leaves an empty File.
+    size_t removedFiles = 0;                //< Empty slots in files, squeezed out once they are half of the vector.
+    std::unordered_map<NameId, Directory*> subDirectoryIndex;       //< Subdirectory name -> subdirectory.
+    std::unordered_map<NameId, size_t> fileIndex;                   //< File name -> position in files (stable until squeezed).
+    mutable std::shared_mutex mutex;        //< Guards the subdirectory list, the files and both indexes (see Lock).
+
+    static bool concurrent;                 //< True while sessions of a daemon share the tree.
+
+    void squeezeFiles();                                        // Drops the empty slots of files, and reindexes the rest.
+    static NodePool<Directory>& pool();                         // Returns the arena every subdirectory lives in.
+    void linkChild(Directory* child);                           // Appends a subdirectory to the list and the index.
+    void unlinkChild(Directory* child);                         // Removes a subdirectory from the list and the index.
+    void releaseChildren();                                     // Returns every subdirectory (recursively) to the pool.
 
 public:
+    /**
+     * Lock holds the reader/writer lock of one Directory while a daemon serves several sessions.
+     * Lookups and reads (path resolution, ls, cat, wc, read) hold it shared, commands adding, removing
+     * or writing files hold it exclusive. A thread holds at most one Directory lock at a time (paths are
+     * resolved one node after the other), so the locks never deadlock. Directory nodes are only removed
+     * by rmdir, which runs while no other command does, so a resolved node stays valid without its lock.
+     * When commands run one at a time, or in disjoint groups of a parallel script, it costs nothing.
+     * **/
+    class Lock {
+        std::shared_mutex* locked = nullptr;
+        bool exclusive = false;
+    public:
+        Lock() = default;
+        Lock(const Directory& directory, bool exclusive) { acquire(directory, exclusive); }
+        ~Lock() { release(); }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+        void acquire(const Directory& directory, bool exclusive);  // Locks a Directory, releasing the previous one.
+        void release();
+    };
+
     // Creates a new Directory constructor.
-    explicit Directory(std::string name, Directory* parent = nullptr): directoryName(std::move(name)), parent(parent) {};
-    int addFile(const std::string& filename);                     // Adds a new File into the File vector.
+    explicit Directory(const std::string& name, Directory* parent = nullptr): name(NameTable::instance().intern(name)), parent(parent) {};
+    Directory(const NameId name, Directory* parent): name(name), parent(parent) {}    // Name already interned.
+    Directory(const Directory&) = delete;
+    Directory& operator=(const Directory&) = delete;
+    ~Directory();
+    int addFile(std::string_view filename);                       // Adds a new File (by name) into the File vector.
     void mkdir(const std::vector<std::string>& path);             // Adds a new Directory to an existing one by given path.
+    void addSubDirectory(std::string_view name);                  // Adds a new Directory (by name) inside this one.
     Directory* chdir(const std::vector<std::string>& path);       // Change the working-directory by given path.
-    Directory* rmdir(const std::vector<std::string>& path, const Directory* workingDirectory); // Removes a directory by given path, change working-directory if needed.
-    void ls(const std::string& path, const std::string& lp_root = "");                      // Prints the contents of a given path.
-    void lproot(const std::string& path);                         // Prints all the directories and files inside the system.
-    void pwd() const;                                             // Prints the working-directory path.
+    Directory* rmdir(const std::vector<std::string>& path, Directory* workingDirectory); // Removes a directory by given path, change working-directory if needed.
+    Directory* removeSubDirectory(std::string_view name, Directory* workingDirectory);  // Removes a Directory (by name) inside this one.
+    void ls(OutputBuffer& output, const std::string& path, bool references = false) const;  // Prints the contents of a given path.
+    void lproot(OutputBuffer& output) const;                      // Prints all the directories and files inside the system.
+    void pwd(OutputBuffer& output) const;                         // Prints the working-directory path.
 
-    std::string getFullPath() const;                              // Returns the full path of a Directory.
+    void getFullPath(std::string& buffer, char separator) const;  // Writes the full path of a Directory into a buffer.
     const std::string& getDirectoryName() const;                  // Returns the Directory name.
-    int isFileExists(const std::string& filename) const;          // Returns the index of a File inside the vector of Files, -1 otherwise.
+    int isFileExists(std::string_view filename) const;            // Returns the index of a File inside the vector of Files, -1 otherwise.
     Directory* depthSearch(const std::vector<std::string>& path); // Returns the Directory at a given path.
+    Directory* findSubDirectory(std::string_view name);           // Returns a subdirectory by name, nullptr otherwise.
+    bool isInside(const Directory* ancestor) const;               // Returns true if ancestor is this Directory or above it.
     File& getFileAt(int index);                                   // Returns an address of a file inside the File vector.
+    // Calls the visitor with the path and File of every file in the subtree: files first, then subdirectories in order.
+    void forEachFile(const std::function<void(const std::string& path, File& file)>& visitor);
     void removeFileAt(int index);                                 // Removes a file from File vector.
+    static void setConcurrent(bool enabled);                      // Enables Lock, only while no command is running.
 
-    // Recursively removes all physical files in the directory tree.
+    // Removes all physical files in the directory tree.
     // (used from Terminal.cpp on 'exit' command, on root directory)
     void clearFiles(Directory& directory);
 };
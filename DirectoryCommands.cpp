@@ -1,89 +1,96 @@
 #include "CommandGenerator.h"
 #include "FileSystemException.h"
+#include "Snapshot.h"
 #include "Terminal.h"
-#include <map>
 #include <string>
-#include <functional>
 
 /**
- * Welcome to the Directory commandMap generator!
+ * Welcome to the Directory commands!
  * Here is where I activate all the Directory functions!
  * The main functionality of the Directories happens here.
  * We are transferred to here from the Terminal, when a Directory command is inserted before execution.
+ * The amount of arguments is checked by the Terminal through the command table (see CommandGenerator.cpp).
  * **/
-std::map<std::string, CommandFunction> buildDirectoryCommandsMap(Directory& root, Directory* workingDirectory){
-    std::map<std::string, CommandFunction> directoryCommandMap;
 
-    // mkdir command, checks number of arguments given, and activate mkdir from root.
-    directoryCommandMap["mkdir"] = [&root](const std::vector<std::string>& parameters){
-        if(parameters.size() != 1) {
-            throw CommandException("'mkdir' requires only 1 argument.");
+// mkdir command, finds the parent through the path cache, and creates the new directory inside it.
+void mkdirCommand(CommandContext& context, const CommandArguments& parameters) {
+    std::string_view name;
+    Directory* parent = context.paths.resolveParent(context.root, parameters[0], name);
+    if (!parent) {
+        if (name == context.root.getDirectoryName()) {
+            throw DirectoryAlreadyExistsException("Root directory cannot be created.");
         }
-        const std::vector<std::string> path = separatePath(parameters[0]);
-        root.mkdir(path);
-    };
+        throw LocationException("Invalid path: must start from root.");
+    }
+    parent->addSubDirectory(name);
+}
 
-    // chdir command, checks number of arguments given, and activate chdir from root.
-    directoryCommandMap["chdir"] = [&root, &workingDirectory](const std::vector<std::string>& parameters){
-        if (parameters.size() != 1) {
-            throw CommandException("'chdir' requires only 1 argument.");
-        }
-
-        const std::vector<std::string> path = separatePath(parameters[0]);
-        workingDirectory = root.chdir(path);
-    };
+// chdir command, resolves the new working-directory through the path cache.
+void chdirCommand(CommandContext& context, const CommandArguments& parameters) {
+    context.workingDirectory = context.paths.resolveDirectory(context.root, parameters[0]);
+}
 
-    // rmdir command, checks number of arguments given, and if the path starts from root.
-    // then activate remove from root, and change working-directory if needed.
-    directoryCommandMap["rmdir"] = [&root, &workingDirectory](const std::vector<std::string>& parameters) {
-        if (parameters.size() != 1) {
-            throw CommandException("'rmdir' requires only 1 argument.");
+// rmdir command, checks if the path starts from root.
+// then removes the directory from its parent, drops its path cache entries, and change working-directory if needed.
+// The working directory of every other session of a daemon inside the removed subtree moves to the parent too.
+void rmdirCommand(CommandContext& context, const CommandArguments& parameters) {
+    std::string_view name;
+    Directory* parent = context.paths.resolveParent(context.root, parameters[0], name);
+    if (!parent) {
+        if (name == context.root.getDirectoryName()) {
+            throw FileSystemException("Cannot delete root directory.");
         }
+        throw LocationException("Invalid path: must start from root.");
+    }
 
-        const std::vector<std::string> path = separatePath(parameters[0]);
-        if(path.size() == 1 && path[0] == "V"){
-            throw FileSystemException("Cannot delete root directory.");
+    const Directory* target = parent->findSubDirectory(name);
+    if (target) {
+        context.paths.invalidate(target);
+        if (context.shared) {
+            for (Directory** other : context.shared->workingDirectories) {
+                if ((*other)->isInside(target)) *other = parent;
+            }
         }
+    }
+    context.workingDirectory = parent->removeSubDirectory(name, context.workingDirectory);
+}
 
-        workingDirectory = root.rmdir(path,workingDirectory);
-    };
+// Ls command, lists the working directory without arguments, otherwise the directory the path resolves to.
+void lsCommand(CommandContext& context, const CommandArguments& parameters) {
+    if (parameters.empty()) {
+        context.workingDirectory->ls(context.output, context.workingDirectory->getDirectoryName());
+        return;
+    }
+    Directory *current = context.paths.resolveDirectory(context.root, parameters[0]);
+    current->ls(context.output, current->getDirectoryName());
+}
 
-    // Ls command, check the number of arguments given, and if the path starts from root.
-    // Activate ls on the Directory returned from depthSearch.
-    directoryCommandMap["ls"] = [&root, &workingDirectory](const std::vector<std::string>& parameters){
-        if (parameters.empty()) {
-            workingDirectory->ls(workingDirectory->getDirectoryName());
-            return;
-        }
-        std::vector<std::string> path = separatePath(parameters[0]);
-        if (path[0] != root.getDirectoryName()) {
-            throw LocationException("Invalid path: must start from root.");
-        }
+// lproot command, activate lproot from root.
+void lprootCommand(CommandContext& context, const CommandArguments&) {
+    context.root.lproot(context.output);
+}
 
-        if(path.size() == 1){
-            root.ls("V");
-        }else {
-            const std::vector<std::string> subPath(path.begin() + 1, path.end());
-            Directory *current = root.depthSearch(subPath);
-            current->ls(current->getDirectoryName());
-        }
-    };
+// pwd command, activate pwd on the working directory.
+void pwdCommand(CommandContext& context, const CommandArguments&) {
+    context.workingDirectory->pwd(context.output);
+}
 
-    // lproot command, check the number of arguments given, and activate lproot from root.
-    directoryCommandMap["lproot"] = [&root](const std::vector<std::string>& parameters){
-        if (!parameters.empty()) {
-            throw CommandException("'lproot' requires 0 arguments.");
-        }
-        root.lproot("");
-    };
+// save command, writes the whole tree into an image file (a physical path, not a path of the tree).
+void saveCommand(CommandContext& context, const CommandArguments& parameters) {
+    Snapshot::save(context.root, std::string(parameters[0]));
+}
 
-    // pwd command, check the number of arguments given, and activate pwd.
-    directoryCommandMap["pwd"] = [&workingDirectory](const std::vector<std::string>& parameters){
-        if(!parameters.empty()) {
-            throw CommandException("'pwd' takes no arguments.");
+// load command, replaces the whole tree with the one saved in an image file.
+// Once the image is checked, every node of the old tree goes away: the path cache forgets them,
+// and every working directory returns to the root. A rejected image changes nothing.
+void loadCommand(CommandContext& context, const CommandArguments& parameters) {
+    Snapshot::load(context.root, std::string(parameters[0]), [&context] {
+        context.paths.invalidate(&context.root);
+        context.workingDirectory = &context.root;
+        if (context.shared) {
+            for (Directory** other : context.shared->workingDirectories) {
+                *other = &context.root;
+            }
         }
-        workingDirectory->pwd();
-    };
-
-    return directoryCommandMap;
-}
\ No newline at end of file
+    });
+}
@@ -1,43 +1,81 @@
-#include <iostream>
-#include <sstream>
+#include <cstdio>
+#include <utility>
 #include "File.h"
-#include "CommandGenerator.h"
+#include "Directory.h"
+#include "HostCopy.h"
+#include "AsyncIO.h"
+#include "WordCount.h"
 
-File::File(const std::string& filename) : value(new FileValue(filename)), count(0), logicalName(filename){}
+// Buffer reused for physical file names, so building one does not allocate in the common case.
+static std::string& pathBuffer() {
+    thread_local std::string buffer;
+    return buffer;
+}
+
+File::File(const std::string& filename)
+    : value(new FileValue(filename, false)), count(0), owner(nullptr), name(NameTable::instance().intern(filename)) {}
+
+File::File(const Directory* owner, const NameId name)
+    : value(nullptr), count(0), owner(owner), name(name) {
+    value = new FileValue(hostPath(pathBuffer()));
+}
 
-// Assignment operator, RCPtr handles the value.
+// Assignment operator, RCPtr handles the value, the hard-link mark goes with the entry.
 File& File::operator=(const File& rhs) {
     if (this != &rhs) {
         value = rhs.value;
         count = rhs.count;
-        logicalName = rhs.logicalName;
+        owner = rhs.owner;
+        name = rhs.name;
+        hardLink = rhs.hardLink;
+    }
+    return *this;
+}
+
+// Move assignment operator, the reference of rhs is handed over, the count does not change.
+File& File::operator=(File&& rhs) noexcept {
+    if (this != &rhs) {
+        value = std::move(rhs.value);
+        count = rhs.count;
+        owner = rhs.owner;
+        name = rhs.name;
+        hardLink = rhs.hardLink;
     }
     return *this;
 }
 
+// Function that writes the physical file name into the buffer: the path of the owner and the name, joined by '!'.
+const std::string& File::hostPath(std::string& buffer) const {
+    const std::string& fileName = getFileName();
+    if (owner == nullptr) {
+        buffer = fileName;
+        return buffer;
+    }
+    owner->getFullPath(buffer, '!');
+    buffer += '!';
+    buffer += fileName;
+    return buffer;
+}
+
 // Function that returns only the actual file name.
-std::string File::getFileName() const {
-    return separatePath(logicalName,'!').back();
+const std::string& File::getFileName() const {
+    return NameTable::instance().name(name);
 }
 
 // Function that returns the full file name.
 std::string File::getFullFileName() const {
-    return logicalName;
+    std::string fullName;
+    return hostPath(fullName);
 }
 
-// Read operator, opens the file, seeks the index you want to read from,
+// Read operator, reads the index you want through the storage of the file,
 // returns the char that was read.
 char File::operator[](const int i) const {
+    const FileStorage::Guard guard;
     if (i < 0 || i > static_cast<int>(count)) {
         throw IndexOutOfBounds("Index is out of bounds.");
     }
-    value->stream->clear();
-    value->stream->open(logicalName, std::ios::in);
-    value->stream->seekg(i);
-    char ch;
-    value->stream->get(ch);
-    value->stream->close();
-    return ch;
+    return value->storage->read(i);
 }
 
 // Write operator, here CharProxy handles the reading and writing,
@@ -53,78 +91,221 @@ CharProxy File::operator[](const int i) {
     return CharProxy(this, i);
 }
 
-// Function that updates the timestamps of a file, or creates a physical file it is not existed before.
-void File::touch() const {
-    value->stream->open(logicalName, std::ios::in | std::ios::out);
-    if (!value->stream->is_open()) {
-        value->stream->open(logicalName, std::ios::out);
+// Function that reads 'length' characters starting at 'position' with one ranged access.
+// The range is checked against the character count once, instead of once per character.
+std::string File::readRange(const size_t position, const size_t length) const {
+    const FileStorage::Guard guard;
+    if (position > count || length > count - position) {
+        throw IndexOutOfBounds("Range is out of bounds.");
     }
-    value->stream->flush();
-    value->stream->close();
+    std::string result(length, '\0');
+    const size_t read = value->storage->read(position, &result[0], length);
+    result.resize(read);
+    return result;
 }
 
-// Function that copies the content of the current file, into a target file.
-void File::copy(const File& target) const {
-    value->stream->open(logicalName, std::ios::in);
-    target.value->stream->open(target.getFullFileName(),std::ios::out);
+// Function that writes a whole string starting at 'position' with one ranged access.
+// Like the write operator, the range may start at most right after the last character.
+void File::writeRange(const size_t position, const std::string_view data) {
+    const FileStorage::Guard guard;
+    if (position > count) {
+        throw IndexOutOfBounds("Index is out of bounds.");
+    }
+    value->noteWrite(position, data.data(), data.length());
+    value->reserve(position + data.length()).write(position, data.data(), data.length());
+    if (position + data.length() > count) {
+        count = position + data.length();
+    }
+}
 
-    *target.value->stream << value->stream->rdbuf();
+// Function that updates the timestamps of a file, or creates a physical file it is not existed before.
+void File::touch() const {
+    const FileStorage::Guard guard;
+    value->storage->create();
+}
 
-    const size_t target_size = value->stream->tellg();
+// Function that copies the content of the current file, into a target file.
+// A file copied over itself (or over a hard link of itself) keeps its content, only the count of the target is set.
+// A target kept inline is moved into its backend first if the source does not fit inline.
+// A backend that can share content (memory) takes the source content in O(1), the copy happens on the first write.
+// Otherwise the kernel copies the physical file (HostCopy). A content it cannot copy (an image extent,
+// an inline content) is streamed block by block into the emptied target, which is never the source itself.
+// The target takes the counts kept for wc of the source, if there are any.
+// With a ticket, a large kernel copy may go on in the background (see HostCopy::copy), only between Files that
+// own their physical file alone, so the physical files of the copy are reachable by their paths only.
+void File::copy(const File& target, std::uint64_t* ticket) const {
+    const FileStorage::Guard guard;
+    WordCount::Counts counts;
+    if (value->getFilename() == target.value->getFilename()) {
+        target.count = value->storage->size();
+        return;
+    }
+    const WordCount::Counts* known = value->cachedStats(counts) ? &counts : nullptr;
+    FileStorage& destination = target.value->isInline() ? target.value->reserve(value->storage->size())
+                                                        : *target.value->storage;
+    if (destination.share(*value->storage)) {
+        target.count = destination.size();
+        target.value->replaceStats(known);
+        return;
+    }
+    size_t copied = 0;
+    const bool background = ticket && value->getRefCount() == 1 && target.value->getRefCount() == 1 &&
+                            value->getFilename() == hostPath(pathBuffer()) &&
+                            target.value->getFilename() == target.hostPath(pathBuffer());
+    if (HostCopy::instance().copy(*value->storage, destination, copied, background ? ticket : nullptr)) {
+        target.count = copied;
+        target.value->replaceStats(known);
+        return;
+    }
+    destination.truncate();
+    size_t target_size = 0;
+    value->storage->forEachBlock([&destination, &target_size](const char* data, const size_t length) {
+        destination.write(target_size, data, length);
+        target_size += length;
+    });
     target.count = target_size;
-
-    value->stream->flush();
-    value->stream->close();
-    target.value->stream->flush();
-    target.value->stream->close();
+    destination.flush();
+    target.value->replaceStats(known);
 }
 
 // Function that removes the physical File from the disk.
-void File::remove() const {
-    if (value->stream->is_open()) {
-        value->stream->close();
+// If this File owns the physical file of its FileValue, the cached content is dropped first.
+// Content kept in the image or inline has no physical file, dropping it frees its extent (or its sync'ed file).
+// A hard-link path may still have the physical file of the File it replaced, it is removed if it exists.
+// With a batch, the physical file is unlinked in the background, and a failure is reported by the batch.
+void File::remove(UnlinkBatch* batch) const {
+    const FileStorage::Guard guard;
+    const std::string& path = hostPath(pathBuffer());
+    const bool owned = value->getFilename() == path;
+    if (owned) {
+        value->storage->discard();
+        value->detach();
+    }
+    if (!value->storage->hasHostFile()) {
+        if (!owned) {
+            if (batch) batch->unlink(path, false);
+            else std::remove(path.c_str());
+        }
+        return;
+    }
+    if (batch) {
+        batch->unlink(path, true);
+        return;
     }
-    if (std::remove(logicalName.c_str()) != 0) {
+    if (std::remove(path.c_str()) != 0) {
         perror("Remove failed");
         throw FileSystemException("Failed to remove the file.");
     }
 }
 
-// Function that prints all the current file content.
-void File::cat() const{
-    value->stream->open(value->filename,std::ios::in);
-    std::string line;
-    while (std::getline(*value->stream, line)) {
-        std::cout << line << std::endl;
+// Function that moves the content of this File into the target by renaming the physical file
+// (or by handing over its extent inside the image, or its inline content).
+// Only possible if no other File (hard-link) shares the content, and this File owns its physical file.
+// Returns false if the caller must copy and remove instead, on success this File has no physical file anymore.
+bool File::moveTo(const File& target) const {
+    const FileStorage::Guard guard;
+    if (value->getRefCount() != 1 || value->getFilename() != hostPath(pathBuffer())) {
+        return false;
+    }
+    const size_t size = value->storage->size();
+    WordCount::Counts counts;
+    const bool known = value->cachedStats(counts);
+    FileStorage& destination = target.value->reserve(size);
+    if (!destination.take(*value->storage) && !HostCopy::instance().move(*value->storage, destination, size)) {
+        return false;
     }
-    value->stream->flush();
-    value->stream->close();
+    target.count = size;
+    target.value->replaceStats(known ? &counts : nullptr);
+    return true;
+}
+
+// Function that prints all the current file content, byte for byte (a missing last newline stays missing).
+// If stdout is a pipe, file or socket, the kernel sends the physical file directly (HostCopy::send),
+// after the pending output. Otherwise the content is appended to the output in large blocks.
+// While commands run on several threads, only the write-back holds the storage Guard, the physical file
+// is sent without it, so sessions of a daemon print files in parallel.
+void File::cat(OutputBuffer& output) const{
+    output.flush();
+    if (FileStorage::isConcurrent() && value->storage->isHostBacked()) {
+        size_t length;
+        const std::string& path = syncedPath(length);
+        if (HostCopy::instance().send(path, length, output.getDescriptor())) {
+            return;
+        }
+    }
+    const FileStorage::Guard guard;
+    if (HostCopy::instance().send(*value->storage, output.getDescriptor())) {
+        return;
+    }
+    value->storage->forEachBlock([&output](const char* data, const size_t length) {
+        output.write(data, length);
+    });
 }
 
 // Function that prints the number of lines,words,and characters inside the current file.
-void File::wc() const{
-    value->stream->clear();
-    value->stream->open(logicalName, std::ios::in);
-    size_t lines = 0, words = 0, characters = 0;
-    std::string word, line;
-    while (std::getline(*value->stream, line)) {
-        ++lines;
-        characters += line.length();
-        std::istringstream iss(line);
-        while (iss >> word) {
-            ++words;
+// Newlines end a line and are not counted as characters, any whitespace separates words.
+// The counts kept by the FileValue answer without reading the file. Otherwise the content is streamed
+// block by block into WordCount, which counts with SIMD kernels when available, and the result is kept.
+// While commands run on several threads, the written back physical file is counted without the storage Guard.
+void File::wc(OutputBuffer& output) const{
+    WordCount counter;
+    size_t version;
+    if (!cachedCounts(counter, version)) {
+        if (FileStorage::isConcurrent() && value->storage->isHostBacked()) {
+            size_t length;
+            const std::string& path = syncedPath(length);
+            counter = WordCount::countFile(path, length);
+        } else {
+            counter = countContent();
         }
+        keepCounts(counter, version);
     }
-    std::cout << "Lines: " << lines << ", Words: " << words << ", Characters: " << characters << '\n';
-    value->stream->flush();
-    value->stream->close();
+    output << "Lines: " << counter.getLines() << ", Words: " << counter.getWords()
+           << ", Characters: " << counter.getCharacters() << '\n';
+}
+
+// Function that writes every cached change of the content into the physical file,
+// and returns its name and content size, so another thread can read the physical file directly.
+const std::string& File::syncedPath(size_t& length) const {
+    const FileStorage::Guard guard;
+    value->storage->flush();
+    length = value->storage->size();
+    return value->getFilename();
+}
+
+// Function that counts the content through the storage, on this thread.
+WordCount File::countContent() const {
+    const FileStorage::Guard guard;
+    WordCount counter;
+    value->storage->forEachBlock([&counter](const char* data, const size_t length) {
+        counter.add(data, length);
+    });
+    return counter;
+}
+
+// Function that returns the counts kept for wc, if they still describe the content.
+// Otherwise returns false, and the version of the content to hand to keepCounts with the new counts.
+bool File::cachedCounts(WordCount& counter, size_t& version) const {
+    const FileStorage::Guard guard;
+    WordCount::Counts counts;
+    if (value->cachedStats(counts)) {
+        counter = WordCount(counts);
+        return true;
+    }
+    version = value->getVersion();
+    return false;
+}
+
+// Function that keeps counts for the next wc, unless the content changed since 'version'.
+void File::keepCounts(const WordCount& counter, const size_t version) const {
+    const FileStorage::Guard guard;
+    value->keepStats(counter.getCounts(), version);
 }
 
 // Function that creates a Hard-Link.
 void File::ln(File& target) const {
     if (!target.hardLink) {
         target.value = value;
-        target.value->filename = logicalName;
         target.count = count;
         target.hardLink = true;
     }
@@ -4,6 +4,13 @@
 #include "RCPtr.h"
 #include "FileValue.h"
 #include "CharProxy.h"
+#include "NameTable.h"
+#include "OutputBuffer.h"
+#include <cstdint>
+#include <string_view>
+
+class Directory;    // Forward declaration to eliminate circular including.
+class UnlinkBatch;
 
 /**
  *  File class
@@ -11,30 +18,50 @@
  *  Holds and executes each of the File functions (touch, copy, remove, move, cat, wc, ln)
  *  alongside other helper functions.
  *  (since 'move' uses copy and remove, It's not here).
+ *  A File holds its interned name and the Directory it lives in, the physical file name
+ *  (Example: V!tt!gg!test.txt) is only written out when a system call needs it.
  * **/
 class File {
     friend class CharProxy;
+    friend class Snapshot;
     RCPtr<FileValue> value;     //< Smart pointer to a FileValue.
     mutable size_t count;       //< Character count on each File.
-    std::string logicalName;    //< Full file name. (Example: V!tt!gg!test.txt)
+    const Directory* owner;     //< Directory holding this File, nullptr for a file outside the virtual tree.
+    NameId name;                //< File name, interned.
     bool hardLink = false;      //< File that was hard-linked cannot be hard-linked AGAIN.
 
+    const std::string& hostPath(std::string& buffer) const;     // Writes the physical file name into a buffer.
+
 public:
-    File():value(nullptr),count(0){}
-    explicit File(const std::string& filename);
+    File():value(nullptr),count(0),owner(nullptr),name(NameTable::none){}
+    explicit File(const std::string& filename);             // File outside the virtual tree (physical name only).
+    File(const Directory* owner, NameId name);              // File inside a Directory.
     File(const File& other) = default;      // Default copy constructor.
+    File(File&& other) noexcept = default;  // Move constructor, takes the reference without counting (vector growth).
     char operator[](int i) const;           // Read operator.
     CharProxy operator[](int i);            // Write operator.
+    std::string readRange(size_t position, size_t length) const;    // Reads a whole range in one access.
+    void writeRange(size_t position, std::string_view data);        // Writes a whole range in one access.
     File& operator=(const File& rhs);       // Assignment operator.
-    std::string getFileName() const;        // Returns the current file name.
+    File& operator=(File&& rhs) noexcept;   // Move assignment operator (vector erase, temporaries).
+    const std::string& getFileName() const; // Returns the current file name.
+    NameId getNameId() const { return name; }
     std::string getFullFileName() const;    // Returns the full name of a file.
     int getRefCounter() const;              // Return the reference count of a file.
+    size_t getCount() const { return count; }  // Returns the character count.
 
     void touch() const;                     // Creates a physical file, or refreshes timestamp of an existing file.
-    void copy(const File& target) const;    // Copies the content of this File, into another target.
-    void remove() const;                    // Removes a physical file from the system.
-    void cat() const;                       // Prints the content of this File.
-    void wc() const;                        // Prints word/lines/characters of this File.
+    // Copies the content of this File, into another target. With 'ticket', a large copy may run in the background.
+    void copy(const File& target, std::uint64_t* ticket = nullptr) const;
+    void remove(UnlinkBatch* batch = nullptr) const;    // Removes a physical file from the system (through a batch).
+    bool moveTo(const File& target) const;  // Renames the physical file over the target, if possible.
+    void cat(OutputBuffer& output) const;   // Prints the content of this File.
+    void wc(OutputBuffer& output) const;    // Prints word/lines/characters of this File.
+    const std::string& syncedPath(size_t& length) const;   // Writes back cached changes, returns the physical file and its size.
+    bool hasHostFile() const { return value->storage->hasHostFile(); }  // False for content kept in the image.
+    WordCount countContent() const;         // Counts the content on this thread.
+    bool cachedCounts(WordCount& counter, size_t& version) const;  // Counts kept for wc, if still valid.
+    void keepCounts(const WordCount& counter, size_t version) const;   // Keeps counts for the next wc.
     void ln(File& target) const;            // Creates a hard-link.
 };
 
@@ -0,0 +1,56 @@
+#include "FileHandleCache.h"
+#include "FileStorage.h"
+
+constexpr size_t FileHandleCache::default_capacity;
+
+// Function that returns the single cache shared by all FileStorages.
+FileHandleCache& FileHandleCache::instance() {
+    static FileHandleCache cache;
+    return cache;
+}
+
+// Function that changes the maximum amount of open files.
+// Copy keeps its source and target open together, therefore the bound is at least 2.
+void FileHandleCache::setCapacity(const size_t maxOpenFiles) {
+    capacity = maxOpenFiles < 2 ? 2 : maxOpenFiles;
+    while (lru.size() > capacity && evict()) {}
+}
+
+// Function that moves an already open FileStorage to the front of the list.
+void FileHandleCache::touch(FileStorage& storage) {
+    ++hits;
+    if (storage.lruPosition != lru.begin()) {
+        lru.splice(lru.begin(), lru, storage.lruPosition);
+    }
+}
+
+// Function that registers a FileStorage that was just opened, closing the least recently used one if full.
+// Pinned storages are skipped, so the bound may be exceeded while they are in use.
+void FileHandleCache::admit(FileStorage& storage) {
+    ++misses;
+    while (lru.size() >= capacity && evict()) {}
+    lru.push_front(&storage);
+    storage.lruPosition = lru.begin();
+    storage.cached = true;
+}
+
+// Function that removes a FileStorage from the list, the handle itself is closed by the FileStorage.
+void FileHandleCache::forget(FileStorage& storage) {
+    if (storage.cached) {
+        lru.erase(storage.lruPosition);
+        storage.cached = false;
+    }
+}
+
+// Function that closes the least recently used FileStorage which is not pinned.
+// Returns false if every open FileStorage is pinned.
+bool FileHandleCache::evict() {
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+        if ((*it)->pins == 0) {
+            ++evictions;
+            (*it)->close();
+            return true;
+        }
+    }
+    return false;
+}
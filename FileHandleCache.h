@@ -0,0 +1,46 @@
+#ifndef FIRSTPROJECT_FILEHANDLECACHE_H
+#define FIRSTPROJECT_FILEHANDLECACHE_H
+
+#include <cstddef>
+#include <list>
+
+class FileStorage;  // Forward declaration to eliminate circular including.
+
+/**
+ * FileHandleCache keeps the handle (stream or mapping) of every FileStorage open between operations,
+ * instead of opening and closing the physical file on every read/write.
+ * The cache is process-wide, and bounded by a configurable amount of open files,
+ * when the bound is reached, the least recently used FileStorage gets closed.
+ * Hard-linked Files share one FileValue, therefore they share one cached handle.
+ * **/
+class FileHandleCache {
+    std::list<FileStorage*> lru;    //< Open storages, most recently used first.
+    size_t capacity;                //< Maximum amount of open files.
+    size_t hits;                    //< Accesses to an already open file.
+    size_t misses;                  //< Accesses that had to open the file.
+    size_t evictions;               //< Files closed to make room for another one.
+
+    FileHandleCache(): capacity(default_capacity), hits(0), misses(0), evictions(0) {}
+    bool evict();                                   // Closes the least recently used unpinned FileStorage.
+
+public:
+    static constexpr size_t default_capacity = 64;
+
+    FileHandleCache(const FileHandleCache&) = delete;
+    FileHandleCache& operator=(const FileHandleCache&) = delete;
+
+    static FileHandleCache& instance();             // Returns the process-wide cache.
+    void setCapacity(size_t maxOpenFiles);          // Changes the bound, closes files above it.
+    size_t getCapacity() const { return capacity; }
+
+    void touch(FileStorage& storage);               // Marks an open FileStorage as most recently used.
+    void admit(FileStorage& storage);               // Registers a newly opened FileStorage, evicts if needed.
+    void forget(FileStorage& storage);              // Removes a FileStorage that was closed.
+
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    size_t getEvictions() const { return evictions; }
+    size_t openFiles() const { return lru.size(); }
+};
+
+#endif //FIRSTPROJECT_FILEHANDLECACHE_H
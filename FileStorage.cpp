@@ -0,0 +1,94 @@
+#include "FileStorage.h"
+#include "FileHandleCache.h"
+#include "StreamStorage.h"
+#include "MappedStorage.h"
+#include "MemoryStorage.h"
+#include "ImageStorage.h"
+#include "InlineStorage.h"
+#include "PageCache.h"
+#include "FileSystemException.h"
+
+StorageBackend FileStorage::backend = StorageBackend::Stream;
+std::atomic<size_t> FileStorage::live(0);
+size_t FileStorage::users = 0;
+bool FileStorage::concurrent = false;
+std::recursive_mutex FileStorage::layerMutex;
+
+// Function that creates a new storage for a physical file, using the selected backend.
+// The image only holds files of the virtual tree, a file outside of it is always its physical file.
+FileStorage* FileStorage::create(const std::string& name, const bool inTree) {
+    switch (backend) {
+        case StorageBackend::Mapped:
+            return new MappedStorage(name);
+        case StorageBackend::Memory:
+            return new MemoryStorage(name);
+        case StorageBackend::Image:
+            if (inTree) return new ImageStorage(name);
+            return new StreamStorage(name);
+        case StorageBackend::Stream:
+        default:
+            return new StreamStorage(name);
+    }
+}
+
+// Function that selects the backend of the process, used by every storage created afterwards.
+// Selecting the same backend again is allowed. A different one is rejected while a terminal or daemon holds the backend,
+// or while storages created with it are alive, since every tree of the process shares it.
+// Throws FileSystemException.
+void FileStorage::setBackend(const StorageBackend selected) {
+    if (selected == backend) return;
+    if (users > 0 || live.load(std::memory_order_relaxed) > 0) {
+        throw FileSystemException(std::string("The storage backend is already '") + getBackendName() +
+                                  "' for this process, it cannot change while files use it.");
+    }
+    backend = selected;
+}
+
+// Function that returns the backend used for new storages.
+StorageBackend FileStorage::getBackend() {
+    return backend;
+}
+
+// Function that returns the name of the selected backend, as given to '--backend'.
+const char* FileStorage::getBackendName() {
+    switch (backend) {
+        case StorageBackend::Mapped:
+            return "mmap";
+        case StorageBackend::Memory:
+            return "memory";
+        case StorageBackend::Image:
+            return "image";
+        case StorageBackend::Stream:
+        default:
+            return "stream";
+    }
+}
+
+// Function that writes back the dirty pages of stream storages, and the changed content of memory and inline storages.
+void FileStorage::syncAll() {
+    PageCache::instance().sync();
+    MemoryStorage::syncAll();
+    InlineStorage::syncAll();
+}
+
+// Function that enables or disables Guard, called by the Terminal before and after running commands in parallel.
+void FileStorage::setConcurrent(const bool enabled) {
+    concurrent = enabled;
+}
+
+// Function that checks if the handle is still open, and if so marks it as the most recently used.
+bool FileStorage::reuse() {
+    if (!cached) return false;
+    FileHandleCache::instance().touch(*this);
+    return true;
+}
+
+// Function that registers a newly opened handle, which may close the least recently used one.
+void FileStorage::admit() {
+    FileHandleCache::instance().admit(*this);
+}
+
+// Function that removes this storage from FileHandleCache.
+void FileStorage::forget() {
+    FileHandleCache::instance().forget(*this);
+}
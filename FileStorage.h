@@ -0,0 +1,117 @@
+#ifndef FIRSTPROJECT_FILESTORAGE_H
+#define FIRSTPROJECT_FILESTORAGE_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+
+// The storage backends a FileValue can use, one per process (see FileStorage::BackendUse).
+enum class StorageBackend {
+    Stream,     //< Heap allocated fstream, served through the PageCache.
+    Mapped,     //< Physical file mapped into memory with mmap.
+    Memory,     //< Content kept in RAM, copies share it until one side is written.
+    Image       //< Content kept in extents of one image file (files outside the virtual tree use Stream).
+};
+
+// Alias for the function receiving the content of a file block by block (used by cat, wc and copy).
+using BlockConsumer = std::function<void(const char* data, size_t length)>;
+
+/**
+ * FileStorage is the abstract backend behind FileValue, it holds the content of one physical file.
+ * Every backend supports character access, ranged access, and streaming the whole content.
+ * An open backend holds a handle (stream or mapping), FileHandleCache bounds the amount of open handles,
+ * and calls close() on the least recently used one.
+ * **/
+class FileStorage {
+    friend class FileHandleCache;
+    std::list<FileStorage*>::iterator lruPosition;  //< Position inside the FileHandleCache list.
+    bool cached = false;                            //< True while a handle is open and registered in the cache.
+    int pins = 0;                                   //< A pinned handle is never closed by the cache.
+
+    static StorageBackend backend;                  //< Backend used for every new FileStorage.
+    static std::atomic<size_t> live;                //< Storages alive, they were created with the current backend.
+    static size_t users;                            //< Terminals and daemons holding the backend (see BackendUse).
+    static bool concurrent;                         //< True while commands run on several threads.
+    static std::recursive_mutex layerMutex;         //< Serializes the storage layer while 'concurrent'.
+
+protected:
+    std::string filename;                           //< Physical file name.
+    bool reuse();                                   // Returns true (marking it recently used) if the handle is open.
+    void admit();                                   // Registers a handle that was just opened.
+    void forget();                                  // Releases the cache slot, called by close().
+
+    // Keeps the handle open while a block handed to a BlockConsumer is in use.
+    class Pin {
+        FileStorage& storage;
+    public:
+        explicit Pin(FileStorage& s): storage(s) { ++storage.pins; }
+        ~Pin() { --storage.pins; }
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+    };
+
+public:
+    /**
+     * BackendUse holds the backend of the process for a Terminal or a Daemon, as long as it lives.
+     * The backend is process-wide (the page cache, the image and the inline limit are too), so every tree of the
+     * process uses the same one: a second terminal asking for another backend is rejected, instead of silently
+     * changing the backend of the first one. Without users and storages, the backend may be selected again.
+     * **/
+    class BackendUse {
+    public:
+        explicit BackendUse(StorageBackend selected) { setBackend(selected); ++users; }
+        ~BackendUse() { --users; }
+        BackendUse(const BackendUse&) = delete;
+        BackendUse& operator=(const BackendUse&) = delete;
+    };
+
+    /**
+     * Guard serializes the whole storage layer (every backend, FileHandleCache, PageCache, HostCopy and
+     * the content shared by memory storages) while commands of a parallel script run on several threads.
+     * Files take it around every access to their storage. When commands run one at a time it costs nothing.
+     * **/
+    class Guard {
+        const bool locked;
+    public:
+        Guard(): locked(concurrent) { if (locked) layerMutex.lock(); }
+        ~Guard() { if (locked) layerMutex.unlock(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    explicit FileStorage(std::string name): filename(std::move(name)) { live.fetch_add(1, std::memory_order_relaxed); }
+    FileStorage(const FileStorage&) = delete;
+    FileStorage& operator=(const FileStorage&) = delete;
+    virtual ~FileStorage() { live.fetch_sub(1, std::memory_order_relaxed); }
+
+    static FileStorage* create(const std::string& name, bool inTree = true);   // Creates a storage of the selected backend.
+    static void setBackend(StorageBackend selected);        // Selects the backend, while nothing uses another one.
+    static StorageBackend getBackend();                     // Returns the selected backend.
+    static const char* getBackendName();                    // Returns the name of the selected backend.
+    static void syncAll();                                  // Writes back every cached change of every backend.
+    static void setConcurrent(bool enabled);                // Enables Guard, only while no command is running.
+    static bool isConcurrent() { return concurrent; }
+    const std::string& getFilename() const { return filename; }
+
+    virtual char read(size_t index) = 0;                                // Reads one character, 0 past the end.
+    virtual void write(size_t index, char c) = 0;                       // Writes one character.
+    virtual size_t read(size_t position, char* buffer, size_t length) = 0;          // Reads a range, returns bytes read.
+    virtual void write(size_t position, const char* data, size_t length) = 0;       // Writes a range.
+    virtual void forEachBlock(const BlockConsumer& consumer) = 0;      // Streams the whole content in order.
+    virtual size_t size() = 0;                                          // Returns the content size.
+    virtual bool share(FileStorage&) { return false; }                  // Takes the content of source without copying, if supported.
+    virtual bool take(FileStorage&) { return false; }                   // Takes over the content of source, which becomes empty, if supported.
+    virtual bool isHostBacked() const { return true; }                  // True if the flushed physical file holds the content.
+    virtual bool hasHostFile() const { return true; }                   // False if the content has no physical file of its own.
+
+    virtual void create() = 0;      // Creates the physical file if it does not exist.
+    virtual void truncate() = 0;    // Empties the content.
+    virtual void flush() = 0;       // Makes every write visible inside the physical file.
+    virtual void close() = 0;       // Flushes and releases the handle, the content stays on disk.
+    virtual void discard() = 0;     // Drops cached content and the handle, used before the physical file is removed.
+};
+
+#endif //FIRSTPROJECT_FILESTORAGE_H
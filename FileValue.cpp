@@ -1,25 +1,184 @@
-#include <fstream>
+#include <algorithm>
+#include <sys/stat.h>
 #include "FileValue.h"
 
-void FileValue::init() {
-    stream = new std::fstream();
+size_t FileValue::generation = 0;
+
+// Function that returns the storage of a new value: its inline storage for a file of the virtual tree
+// (holding a copy of the inline content of source, if any) while contents are kept inline,
+// otherwise a new storage of the selected backend for the same physical file.
+FileStorage* FileValue::initialStorage(const FileValue* source) {
+    if (source != nullptr && !source->isInline()) {
+        return FileStorage::create(source->getFilename(), source->inTree);
+    }
+    if (!inTree || InlineStorage::getLimit() == 0) {
+        return FileStorage::create(small.getFilename(), inTree);
+    }
+    if (source != nullptr) {
+        small.assign(source->small);
+    }
+    return &small;
 }
 
-// Assignment Operator, copy the filename, and copy the pointer of other.
+// Assignment Operator, creates a new storage for the physical file of other.
 // RCPtr manages reference counting.
 FileValue& FileValue::operator=(const FileValue &other){
     if (this != &other) {
-        filename = other.filename;
-        stream = other.stream;
+        const FileStorage::Guard guard;
+        FileStorage* replacement = other.isInline() ? &small : FileStorage::create(other.getFilename(), other.inTree);
+        if (!isInline()) {
+            delete storage;
+        }
+        if (replacement == &small) {
+            small.assign(other.small);
+        }
+        storage = replacement;
+        inTree = other.inTree;
+        detached = !inTree;
+        statsValid = false;
+        ++version;
     }
     return *this;
 }
 
-// Straightforward destructure.
+// Straightforward destructure, deleting a storage may write back cached pages.
 FileValue::~FileValue() {
-    if (stream) {
-        if (stream->is_open())
-            stream->close();
-        delete stream;
+    const FileStorage::Guard guard;
+    if (!isInline()) {
+        delete storage;
     }
-}
\ No newline at end of file
+}
+
+// Function that returns the storage a content of 'end' bytes is written into.
+// An inline content that would grow past the limit is moved into a new storage of the selected backend first.
+FileStorage& FileValue::reserve(const size_t end) {
+    if (isInline() && end > InlineStorage::getLimit()) {
+        FileStorage* promoted = FileStorage::create(small.getFilename(), inTree);
+        try {
+            small.promote(*promoted);
+        } catch (...) {
+            delete promoted;
+            throw;
+        }
+        storage = promoted;
+    }
+    return *storage;
+}
+
+// Function that stats the physical file, returns false if it does not exist.
+bool FileValue::HostStamp::read(const std::string& path) {
+    struct stat status{};
+    if (::stat(path.c_str(), &status) != 0) {
+        return false;
+    }
+    inode = status.st_ino;
+    size = status.st_size;
+    modified = status.st_mtim;
+    return true;
+}
+
+bool FileValue::HostStamp::operator==(const HostStamp& other) const {
+    return inode == other.inode && size == other.size &&
+           modified.tv_sec == other.modified.tv_sec && modified.tv_nsec == other.modified.tv_nsec;
+}
+
+// Function that returns true if the counts still describe the content, and drops them otherwise.
+// Detached content changed since they were kept, or the physical file changed while nothing was written
+// through the terminal since the stamp: the counts are dropped.
+bool FileValue::checkStats() {
+    if (!statsValid) return false;
+    if (statsGeneration != generation) {
+        statsValid = false;
+    } else if (version == stampVersion && storage->isHostBacked()) {
+        HostStamp current;
+        statsValid = current.read(getFilename()) && current == stamp;
+    }
+    return statsValid;
+}
+
+// Function that updates the counts for 'length' bytes about to be written at 'position', called before the write.
+// The old bytes of the range are counted out and the new ones counted in, both starting after the byte before
+// the range, then the word that may start right after the range is fixed. Costs O(length), never O(file).
+// A write past the end leaves a gap of zero bytes, the counts are dropped then.
+void FileValue::noteWrite(const size_t position, const char* data, const size_t length) {
+    if (detached) ++generation;
+    const bool valid = checkStats();
+    ++version;
+    if (!valid || length == 0) return;
+    const size_t size = stats.bytes;
+    if (position > size) {
+        statsValid = false;
+        return;
+    }
+    const size_t end = position + length;
+    const size_t overlap = std::min(end, size) - position;
+    std::string old(overlap, '\0');
+    if (overlap > 0) {
+        storage->read(position, &old[0], overlap);
+    }
+
+    WordCount::Counts removed, added;
+    removed.inWord = added.inWord = position > 0 && !WordCount::isSpace(storage->read(position - 1));
+    const WordCount::Kernel kernel = WordCount::kernel();
+    kernel(old.data(), overlap, removed);
+    kernel(data, length, added);
+    stats.newlines = stats.newlines - removed.newlines + added.newlines;
+    stats.words = stats.words - removed.words + added.words;
+    if (end < size) {
+        if (!WordCount::isSpace(storage->read(end))) {
+            stats.words = stats.words - WordCount::isSpace(old[overlap - 1]) + WordCount::isSpace(data[length - 1]);
+        }
+    } else {
+        stats.bytes = end;
+        stats.last = data[length - 1];
+        stats.inWord = !WordCount::isSpace(stats.last);
+    }
+}
+
+// Function that returns the counts of the content if they are still valid.
+// If something was written through the terminal since the last stamp, it is flushed and stamped again.
+bool FileValue::cachedStats(WordCount::Counts& counts) {
+    if (!checkStats()) return false;
+    if (version != stampVersion && storage->isHostBacked()) {
+        keepStats(stats, version);
+        if (!statsValid) return false;
+    }
+    counts = stats;
+    return true;
+}
+
+// Function that keeps counts made when the content was at version 'counted', unless it changed since then.
+// A host backed storage is flushed first, so the stamp matches the content that was counted.
+void FileValue::keepStats(const WordCount::Counts& counts, const size_t counted) {
+    if (counted != version || detached) return;
+    if (storage->isHostBacked()) {
+        storage->flush();
+        if (!stamp.read(getFilename())) {
+            statsValid = false;
+            return;
+        }
+        stampVersion = version;
+    }
+    stats = counts;
+    statsValid = true;
+    statsGeneration = generation;
+}
+
+// Function that takes the counts of a content that replaced this one (copy, mv), or drops them (nullptr).
+void FileValue::replaceStats(const WordCount::Counts* counts) {
+    if (detached) ++generation;
+    ++version;
+    statsValid = false;
+    if (counts != nullptr) {
+        keepStats(*counts, version);
+    }
+}
+
+// Function that detaches the content: it is outside the virtual tree, or its physical file was removed
+// while hard-links still use it. Another File may own a physical file of the same name, its counts are
+// dropped whenever this content changes, and this content is never counted ahead.
+void FileValue::detach() {
+    ++version;
+    statsValid = false;
+    detached = true;
+}
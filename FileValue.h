@@ -1,32 +1,87 @@
 #ifndef FIRSTPROJECT_FILEVALUE_H
 #define FIRSTPROJECT_FILEVALUE_H
 
-#include <fstream>
-#include <utility>
+#include <ctime>
+#include <string>
+#include <sys/types.h>
 #include "FileSystemException.h"
+#include "FileStorage.h"
+#include "InlineStorage.h"
 #include "RCObject.h"
+#include "WordCount.h"
 
 /**
  * FileValue class acts as a shared file object. Used with
  * RCPtr<FileValue> in the File wrapper class (File.h).
- * FileValue contains a heap allocated fstream, and a file name.
+ * FileValue contains a heap allocated FileStorage, which holds the file name and the content.
+ * The backend of the storage (fstream or mmap) is picked once by the Terminal.
+ * A small content of the virtual tree is kept inside the FileValue instead (see InlineStorage), and moved into
+ * a storage of the backend once a write would make it larger than the limit: writers call reserve() first.
+ * Hard-links of one FileValue may live in directories used by different threads (parallel scripts, daemon
+ * sessions), so while FileStorage is concurrent the reference count is atomic (see SwitchedCount).
+ * FileValue also keeps the counts of its content for wc (see WordCount), so polling wc does not read the file.
+ * Every change made through the terminal updates them from the changed bytes and their neighbours (noteWrite),
+ * copy and mv hand them to the target. The physical file is stamped (inode, size, mtime) whenever the counts
+ * are checked, and a stamp that changed while nothing was written through the terminal drops them.
+ * Content outside the virtual tree, or left to hard-links after its physical file was removed, is detached:
+ * it may write into the physical file of another File, so its changes drop the counts of every FileValue.
+ * Every member handling the counts runs under FileStorage::Guard.
 
 The big 3:
-    1) Copy constructors - are for sharing or copying, like touch and ln. (Can be default)
+    1) Copy constructors - are for sharing or copying, like touch and ln. (A copy gets its own storage)
     2) Copy assignment   - when assigning one FileValue to another.
-    3) Destructor        - to clean up your heap-allocated fstream.
+    3) Destructor        - to clean up your heap-allocated storage.
  */
-class FileValue: public RCObject{
-    void init();
+using FileValueCount = SwitchedCount<&FileStorage::isConcurrent>;
+
+class FileValue: public RCObjectBase<FileValueCount>{
+    // What stat(2) tells about the physical file, compared to notice changes made outside the terminal.
+    struct HostStamp {
+        ino_t inode = 0;
+        off_t size = 0;
+        timespec modified{};
+
+        bool read(const std::string& path);     // Stats the physical file, false if it does not exist.
+        bool operator==(const HostStamp& other) const;
+    };
+
+    WordCount::Counts stats;    //< Counts of the content, meaningful while statsValid.
+    bool statsValid = false;
+    size_t version = 0;         //< Bumped by every change of the content made through the terminal.
+    size_t stampVersion = 0;    //< Version of the content when 'stamp' was taken.
+    HostStamp stamp;            //< Physical file when the counts were last checked.
+    size_t statsGeneration = 0; //< Value of 'generation' when the counts were kept.
+    bool inTree;                //< False for a file outside the virtual tree, always kept in its physical file.
+    bool detached;              //< Content outside the virtual tree, or whose physical file was removed.
+    InlineStorage small;        //< Content of a small file, used while 'storage' points to it.
+
+    static size_t generation;   //< Bumped when detached content changes, it may be another File's physical file.
+
+    bool checkStats();          // True if the counts are still valid, drops them otherwise.
+    FileStorage* initialStorage(const FileValue* source);   // Storage of a new value (inline if possible).
 
 public:
-    explicit FileValue(std::string  name):filename(std::move(name)){ stream = new std::fstream(); };
-    FileValue(const FileValue& other): RCObject(other), filename(other.filename), stream(other.stream) {}
+    explicit FileValue(const std::string& name, bool inTree = true)
+        : inTree(inTree), detached(!inTree), small(name), storage(initialStorage(nullptr)) {}
+    FileValue(const FileValue& other)
+        : RCObjectBase(other), inTree(other.inTree), detached(!other.inTree), small(other.getFilename()),
+          storage(initialStorage(&other)) {}
     FileValue& operator=(const FileValue& other);
 	~FileValue() override;
 
-    std::string filename;   //< Actual file name opened.
-    std::fstream* stream;   //< File stream used for file operations (allocated on heap as required).
+    const std::string& getFilename() const { return storage->getFilename(); }
+    bool isInline() const { return storage == &small; }
+    bool isDetached() const { return detached; }
+    FileStorage& reserve(size_t end);   // Returns the storage to write a content of 'end' bytes into.
+
+    size_t getVersion() const { return version; }
+    void noteWrite(size_t position, const char* data, size_t length);   // Updates the counts, before a write.
+    bool cachedStats(WordCount::Counts& counts);                        // Returns the counts, if still valid.
+    void keepStats(const WordCount::Counts& counts, size_t counted);    // Keeps counts made at version 'counted'.
+    void replaceStats(const WordCount::Counts* counts);                 // Content replaced (copy, mv), nullptr if unknown.
+    void detach();                                                      // Content is not the physical file's only user.
+
+    FileStorage* storage;   //< Content of the file (allocated on heap as required).
 };
 
-#endif //FIRSTPROJECT_FILEVALUE_H
\ No newline at end of file
+#endif //FIRSTPROJECT_FILEVALUE_H
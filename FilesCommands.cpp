@@ -1,309 +1,496 @@
 #include "FileSystemException.h"
 #include "CommandGenerator.h"
-#include <functional>
-#include <iostream>
+#include "FileHandleCache.h"
+#include "PageCache.h"
+#include "MemoryStorage.h"
+#include "InlineStorage.h"
+#include "ImageFile.h"
+#include "Journal.h"
+#include "HostCopy.h"
+#include "AsyncIO.h"
+#include "JobTable.h"
+#include "WordCount.h"
+#include "ThreadPool.h"
 #include <algorithm>
+#include <charconv>
 #include <string>
-#include <map>
 
 /**
- * Welcome to the File commandMap generator!
+ * Welcome to the File commands!
  * Here is where I activate all the File functions!
  * The main functionality of the File happens here.
  * We are transferred to here from the Terminal, when a File command is inserted before execution.
+ * The amount of arguments is checked by the Terminal through the command table (see CommandGenerator.cpp),
+ * except for touch and wc, which check their own.
  * **/
-std::map<std::string, CommandFunction> buildFileCommandsMap(Directory& root) {
-    std::map<std::string, CommandFunction> fileCommandMap;
-
-    /**
-     *  Read command, check arguments given, and validate the path start from root.
-     *  Find the file needed to be read from the file vector of the found Directory.
-     *  Read the file with [] operator.
-     *  Upon any error, throw CommandException, NotIndexException, LocationException, FileNotFoundException.
-     ***/
-    fileCommandMap["read"] = [&root](const std::vector<std::string>& parameters){
-        if(parameters.size() != 2){
-            throw CommandException("'read' requires 2 arguments.");
-        }
-
-        if(!std::all_of(parameters[1].begin(), parameters[1].end(), ::isdigit)){
-            throw NotIndexException("Invalid index for reading.");
-        }
-
-        std::vector<std::string> path = separatePath(parameters[0]);
-        if (path.empty() || path[0] != root.getDirectoryName()) {
-            throw LocationException("Invalid path: must start from root.");
-        }
-
-        const std::vector<std::string> subPath(path.begin() + 1, path.end() - 1);
-        Directory* current = root.depthSearch(subPath);
-
-        const int fileIndex = current->isFileExists(path.back());
-        if (fileIndex == -1) {
-            throw FileNotFoundException("File does not exist in this path.");
-        }
-
-        File& file = current->getFileAt(fileIndex);
-        const int index = std::stoi(parameters[1]);
-        std::cout << file[index] << "\n";
+// Function that resolves a virtual file path through the PathCache, into the Directory holding it,
+// its name, and its index inside the Directory (-1 if it does not exist yet).
+// Given a lock, the Directory is locked (shared or exclusive) before its files are looked at, and stays locked
+// as long as the caller keeps the lock. Commands using several directories run alone, and pass no lock.
+static Directory* resolveFile(Directory& root, PathCache& paths, const std::string_view path, std::string_view& name, int& index,
+                              Directory::Lock* lock = nullptr, const bool exclusive = false) {
+    Directory* directory = paths.resolveParent(root, path, name);
+    if (!directory) {
+        throw LocationException("Invalid path: must start from root.");
+    }
+    if (lock) {
+        lock->acquire(*directory, exclusive);
+    }
+    index = directory->isFileExists(name);
+    return directory;
+}
+
+// Function that counts every file below a directory in parallel, and prints one line per file plus a total.
+// Files whose counts are kept (see FileValue) are not read, files kept in the image are counted on this thread.
+// The cached changes of every other file are written back first (on this thread), then each one is counted
+// by a ThreadPool worker through its own descriptor, so the workers never touch a shared cache,
+// and the counts are kept for the next wc.
+// The results are printed in the order of the tree, no matter which worker finished first.
+static void wcRecursive(Directory& directory, OutputBuffer& output) {
+    struct Job {
+        std::string path;           //< Path printed for the file.
+        const File* file;           //< File counted.
+        std::string filename;       //< Physical file to count, empty if the counts were kept.
+        size_t length = 0;          //< Amount of bytes to count.
+        size_t version = 0;         //< Version of the content counted.
+        WordCount result;
     };
-
-    /**
-     * Write command, check arguments given, and validate the path start from root.
-     * Find the file needed to be written to from the file vector of the found Directory.
-     * Write into file with [] operator.
-     * Upon any error, throw CommandException, NotIndexException, LocationException, FileNotFoundException.
-     **/
-    fileCommandMap["write"] = [&root](const std::vector<std::string>& parameters){
-        if(parameters.size() != 3){
-            throw CommandException("'write' requires 3 arguments.");
-        }
-
-        if(!std::all_of(parameters[1].begin(), parameters[1].end(), ::isdigit)){
-            throw NotIndexException("Invalid index for writing.");
+    std::vector<Job> jobs;
+    directory.forEachFile([&jobs](const std::string& path, const File& file) {
+        Job job;
+        job.path = path;
+        job.file = &file;
+        if (!file.cachedCounts(job.result, job.version)) {
+            if (file.hasHostFile()) {
+                job.filename = file.syncedPath(job.length);
+            } else {
+                job.result = file.countContent();
+                file.keepCounts(job.result, job.version);
+            }
         }
+        jobs.push_back(std::move(job));
+    });
 
-        if(parameters[2].length() != 1){
-            throw CommandException("'write' receives only 1 argument to write.");
+    ThreadPool& pool = ThreadPool::instance();
+    for (Job& job : jobs) {
+        if (!job.filename.empty()) {
+            pool.submit([&job] { job.result = WordCount::countFile(job.filename, job.length); });
         }
-
-        std::vector<std::string> path = separatePath(parameters[0]);
-        if (path.empty() || path[0] != root.getDirectoryName()) {
-            throw LocationException("Invalid path: must start from root.");
+    }
+    pool.wait();
+    for (const Job& job : jobs) {
+        if (!job.filename.empty()) {
+            job.file->keepCounts(job.result, job.version);
         }
+    }
+
+    size_t lines = 0, words = 0, characters = 0;
+    for (const Job& job : jobs) {
+        output << job.path << ": Lines: " << job.result.getLines() << ", Words: " << job.result.getWords()
+               << ", Characters: " << job.result.getCharacters() << '\n';
+        lines += job.result.getLines();
+        words += job.result.getWords();
+        characters += job.result.getCharacters();
+    }
+    output << "Total: Lines: " << lines << ", Words: " << words << ", Characters: " << characters << '\n';
+}
+
+// Function that converts an all-digits argument into an index, throws NotIndexException if it does not fit.
+template<class Index>
+static Index parseIndex(const std::string_view digits, const char* error) {
+    Index value = 0;
+    const auto result = std::from_chars(digits.data(), digits.data() + digits.length(), value);
+    if (result.ec != std::errc() || result.ptr != digits.data() + digits.length()) {
+        throw NotIndexException(error);
+    }
+    return value;
+}
 
-        const std::vector<std::string> subPath(path.begin() + 1, path.end() - 1);
-        Directory* current = root.depthSearch(subPath);
+/**
+ *  Cat or Wc or Remove, since those 3 have identical exception checks, I merged them into one function.
+ *  Check the existence of a virtual file, and return the Directory holding it and its index.
+ *  The Directory stays locked by 'lock' (exclusive for remove) while the caller uses the file.
+ *  Throw LocationException, FileNotFoundException, DirectoryNotFoundException.
+ ***/
+static Directory* findExistingFile(CommandContext& context, const std::string_view path, int& index,
+                                   Directory::Lock& lock, const bool exclusive) {
+    std::string_view name;
+    Directory* current = resolveFile(context.root, context.paths, path, name, index, &lock, exclusive);
+    if (index == -1) {
+        throw FileNotFoundException("File does not exist.");
+    }
+    return current;
+}
+
+// Function that removes a virtual file and its physical file (remove, and the fallback of move).
+static void removeFile(CommandContext& context, const std::string_view path) {
+    int target;
+    Directory::Lock lock;
+    Directory* current = findExistingFile(context, path, target, lock, true);
+    current->getFileAt(target).remove();
+    current->removeFileAt(target);
+}
 
-        const int fileIndex = current->isFileExists(path.back());
+/**
+ *  Read command, check the indexes given, and validate the path start from root.
+ *  Find the file needed to be read from the file vector of the found Directory.
+ *  Read the file with [] operator, or a whole range with readRange if a length is given.
+ *  Upon any error, throw NotIndexException, LocationException, FileNotFoundException.
+ ***/
+void readCommand(CommandContext& context, const CommandArguments& parameters) {
+    for (size_t i = 1; i < parameters.size(); i++) {
+        if(!std::all_of(parameters[i].begin(), parameters[i].end(), ::isdigit)){
+            throw NotIndexException("Invalid index for reading.");
+        }
+    }
+
+    std::string_view name;
+    int fileIndex;
+    Directory::Lock lock;
+    Directory* current = resolveFile(context.root, context.paths, parameters[0], name, fileIndex, &lock);
+    if (fileIndex == -1) {
+        throw FileNotFoundException("File does not exist in this path.");
+    }
+
+    const int index = parseIndex<int>(parameters[1], "Invalid index for reading.");
+    if (parameters.size() == 3) {
+        const File& file = current->getFileAt(fileIndex);
+        context.output << file.readRange(index, parseIndex<size_t>(parameters[2], "Invalid index for reading.")) << '\n';
+        return;
+    }
+    // Reading right after the last character extends the count (through the write operator),
+    // the file is found again under the exclusive lock of its Directory for that.
+    if (static_cast<size_t>(index) >= current->getFileAt(fileIndex).getCount()) {
+        current = resolveFile(context.root, context.paths, parameters[0], name, fileIndex, &lock, true);
         if (fileIndex == -1) {
             throw FileNotFoundException("File does not exist in this path.");
         }
+    }
+    File& file = current->getFileAt(fileIndex);
+    context.output << static_cast<char>(file[index]) << '\n';
+}
 
-        File& file = current->getFileAt(fileIndex);
-        const int index = std::stoi(parameters[1]);
+/**
+ * Write command, check the index given, and validate the path start from root.
+ * Find the file needed to be written to from the file vector of the found Directory.
+ * Write a single character into file with [] operator, or a whole string with writeRange.
+ * Upon any error, throw NotIndexException, LocationException, FileNotFoundException.
+ **/
+void writeCommand(CommandContext& context, const CommandArguments& parameters) {
+    if(!std::all_of(parameters[1].begin(), parameters[1].end(), ::isdigit)){
+        throw NotIndexException("Invalid index for writing.");
+    }
+
+    std::string_view name;
+    int fileIndex;
+    Directory::Lock lock;
+    Directory* current = resolveFile(context.root, context.paths, parameters[0], name, fileIndex, &lock, true);
+    if (fileIndex == -1) {
+        throw FileNotFoundException("File does not exist in this path.");
+    }
+
+    File& file = current->getFileAt(fileIndex);
+    const int index = parseIndex<int>(parameters[1], "Invalid index for writing.");
+    if (parameters[2].length() == 1) {
         file[index] = parameters[2][0];
-    };
-
-    /**
-     *  Touch command, check if the Directory of the file we want to touch is valid.
-     *  If it's valid, check if a file exits, if it exists only touch (Timestamp update), otherwise create a physical file and touch.
-     *  Throws LocationException if the path doesn't start with the root 'V'.
-     ***/
-    fileCommandMap["touch"] = [&root](const std::vector<std::string>& parameters){
-        std::vector<std::string> path = separatePath(parameters[0]);
-        if (path.empty() || path[0] != root.getDirectoryName()) {
-            throw LocationException("Invalid path: must start from root.");
-        }
-
-        const std::vector<std::string> subPath(path.begin() + 1, path.end() - 1);
-        Directory* targetDir = root.depthSearch(subPath);
-        int index = targetDir->isFileExists(path.back());
-        if (index == -1) {
-            index = targetDir->addFile("!"+path.back());
-        }
-        targetDir->getFileAt(index).touch();
-    };
+        return;
+    }
+    file.writeRange(index, parameters[2]);
+}
 
-    /**
-     *  Copy command, 4 different checks happen here:
-     *  1) Physical file and a Physical file.
-     *  2) Physical file and a Virtual file.
-     *  3) Virtual file and a Physical file.
-     *  4) Virtual file and a Virtual file.
-     *  Target file may not exist upon copy usage.
-     *  The function copies the content of the src file into target.
-     *  Throw CommandException, FileNotFoundException, FileSystemException, DirectoryNotFoundException.
-     * **/
-    fileCommandMap["copy"] = [&root](const std::vector<std::string>& parameters){
-        if (parameters.size() != 2) {
-            throw CommandException("'copy' requires 2 arguments.");
-        }
-
-        std::vector<std::string> firstPath = separatePath(parameters[0]);
-        std::vector<std::string> secondPath = separatePath(parameters[1]);
-
-        auto isPhysical = [](const std::vector<std::string>& path) {
-            return path.size() == 1;
-        };
-        auto isVirtual = [&root](const std::vector<std::string>& path) {
-            return !path.empty() && path[0] == root.getDirectoryName();
-        };
-
-        const File* srcFile = nullptr;
-        const File* dstFile = nullptr;
-        Directory* parent = nullptr;
-        File tempSrc, tempDst;
-
-        if (isPhysical(firstPath)) {
-            tempSrc = File(firstPath[0]);
-            tempSrc.touch();
-            srcFile = &tempSrc;
-        } else if (isVirtual(firstPath)) {
-            parent = root.depthSearch({firstPath.begin() + 1, firstPath.end() - 1});
-            const int idx = parent->isFileExists(firstPath.back());
-            if (idx == -1)
-                throw FileNotFoundException("Source file does not exist in this path.");
-            tempSrc = parent->getFileAt(idx);
-            srcFile = &tempSrc;
-        }
-
-        if (isPhysical(secondPath)) {
-            tempDst = File(secondPath[0]);
-            tempDst.touch();
-            dstFile = &tempDst;
-        } else if (isVirtual(secondPath)) {
-            parent = root.depthSearch({secondPath.begin() + 1, secondPath.end() - 1});
-            int idx = parent->isFileExists(secondPath.back());
-            if (idx == -1) {
-                idx = parent->addFile("!" + secondPath.back());
-                parent->getFileAt(idx).touch();
-            }
-            dstFile = &parent->getFileAt(idx);
-        }
+/**
+ *  Touch command, check if the Directory of the file we want to touch is valid.
+ *  If it's valid, check if a file exits, if it exists only touch (Timestamp update), otherwise create a physical file and touch.
+ *  Throws LocationException if the path doesn't start with the root 'V'.
+ ***/
+void touchCommand(CommandContext& context, const CommandArguments& parameters) {
+    std::string_view name;
+    int index;
+    Directory::Lock lock;
+    Directory* targetDir = resolveFile(context.root, context.paths, parameters[0], name, index, &lock, true);
+    if (index == -1) {
+        index = targetDir->addFile(name);
+    }
+    targetDir->getFileAt(index).touch();
+}
 
-        if (!srcFile || !dstFile) {
-            throw FileNotFoundException("Invalid source or destination.");
-        }
-        srcFile->copy(*dstFile);
-    };
+/**
+ *  Copy function, 4 different checks happen here:
+ *  1) Physical file and a Physical file.
+ *  2) Physical file and a Virtual file.
+ *  3) Virtual file and a Physical file.
+ *  4) Virtual file and a Virtual file.
+ *  Target file may not exist upon copy usage.
+ *  The function copies the content of the src file into target.
+ *  Given a job name and a JobTable, a large copy goes on in the background and is listed by 'jobs' under that name.
+ *  Throw FileNotFoundException, FileSystemException, DirectoryNotFoundException.
+ * **/
+static void copyFile(CommandContext& context, const CommandArguments& parameters, const char* job) {
+    Directory& root = context.root;
+    const std::string_view firstRoot = firstPathComponent(parameters[0]);
+    const std::string_view secondRoot = firstPathComponent(parameters[1]);
 
-    // Remove command, check arguments, and use the last function -> cat_wc_remove.
-    // Throw CommandException, LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
-    fileCommandMap["remove"] =[&fileCommandMap](const std::vector<std::string>& parameters){
-        if(parameters.size() != 1){
-            throw CommandException("'remove' requires 1 argument.");
-        }
-        fileCommandMap["cat_wc_remove"](parameters);
+    auto isPhysical = [](const std::string_view path) {
+        return isSingleComponent(path);
     };
-
-    /**
-     *  Move command, check arguments, and preform the copy function, then remove.
-     *  Both are implemented above.
-     *  Throw CommandException, LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
-     ***/
-    fileCommandMap["move"] = [&root,&fileCommandMap](const std::vector<std::string>& parameters){
-        if(parameters.size() != 2){
-            throw CommandException("'move' requires 2 arguments.");
-        }
-        const std::vector<std::string> temp = separatePath(parameters[0]);
-        if (temp[0] != root.getDirectoryName()) {
-            fileCommandMap["copy"](parameters);     // File not in our system therefore cannot remove. (trusting user)
-            return;
-        }
-        fileCommandMap["copy"](parameters);
-        fileCommandMap["remove"](std::vector<std::string> {parameters[0]});
+    auto isVirtual = [&root](const std::string_view first) {
+        return first == root.getDirectoryName();
     };
 
-    /**
-     *  Cat command, check arguments, and look for a physical file to cat first.
-     *  Otherwise, the file is virtual, use the last function cat_wc_remove
-     *  Throw CommandException, LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
-     **/
-    fileCommandMap["cat"] = [&root,&fileCommandMap](const std::vector<std::string>& parameters){
-        if(parameters.size() != 1){
-            throw CommandException("'cat' requires 1 argument.");
+    const File* srcFile = nullptr;
+    const File* dstFile = nullptr;
+    Directory* parent = nullptr;
+    Directory* source = nullptr;
+    File tempSrc, tempDst;
+    std::string_view name;
+    int idx, sourceIndex = -1;
+
+    if (isPhysical(parameters[0])) {
+        tempSrc = File(std::string(firstRoot));
+        tempSrc.touch();
+        srcFile = &tempSrc;
+    } else if (isVirtual(firstRoot)) {
+        source = resolveFile(root, context.paths, parameters[0], name, sourceIndex);
+        if (sourceIndex == -1)
+            throw FileNotFoundException("Source file does not exist in this path.");
+    }
+
+    if (isPhysical(parameters[1])) {
+        tempDst = File(std::string(secondRoot));
+        tempDst.touch();
+        dstFile = &tempDst;
+    } else if (isVirtual(secondRoot)) {
+        parent = resolveFile(root, context.paths, parameters[1], name, idx);
+        if (idx == -1) {
+            idx = parent->addFile(name);
+            parent->getFileAt(idx).touch();
         }
-        const std::vector<std::string> outsideFile = separatePath(parameters[0]);
-        if (outsideFile[0] != root.getDirectoryName()) {
-            const File temp(outsideFile[0]);
-            temp.touch();
-            temp.cat();
-            return;
-        }
-        std::vector<std::string> s_parameters(parameters.begin(),parameters.end());
-        s_parameters.emplace_back("cat");
-        fileCommandMap["cat_wc_remove"](s_parameters);
-    };
+        dstFile = &parent->getFileAt(idx);
+    }
+    if (source) {       // Taken after the target was added, which may move the Files of the same Directory.
+        srcFile = &source->getFileAt(sourceIndex);
+    }
+
+    if (!srcFile || !dstFile) {
+        throw FileNotFoundException("Invalid source or destination.");
+    }
+    std::uint64_t ticket = 0;
+    srcFile->copy(*dstFile, job && context.jobs ? &ticket : nullptr);
+    if (ticket) {
+        std::string command(job);
+        command.append(" ").append(parameters[0]).append(" ").append(parameters[1]);
+        context.jobs->add(std::move(command), ticket, source, parent,
+                          srcFile->getFullFileName(), dstFile->getFullFileName());
+    }
+}
+
+// Copy command, see copyFile, a large copy runs in the background.
+void copyCommand(CommandContext& context, const CommandArguments& parameters) {
+    copyFile(context, parameters, "copy");
+}
+
+// Remove command, removes the virtual file and its physical file.
+// Throw LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
+void removeCommand(CommandContext& context, const CommandArguments& parameters) {
+    removeFile(context, parameters[0]);
+}
 
-    /**
-     *  Wc command, check arguments, and look for a physical file to wc first.
-     *  Otherwise, the file is virtual, use the last function cat_wc_remove
-     *  Throw CommandException, LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
-     **/
-    fileCommandMap["wc"] = [&root,&fileCommandMap](const std::vector<std::string>& parameters){
-        if(parameters.size() != 1){
-            throw CommandException("'wc' requires 1 argument.");
+/**
+ *  Move command, try to rename the physical file of the source over the destination.
+ *  If the source is shared (hard-link) or on another filesystem, preform the copy function, then remove.
+ *  Both are implemented above.
+ *  Throw LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
+ ***/
+void moveCommand(CommandContext& context, const CommandArguments& parameters) {
+    Directory& root = context.root;
+    if (firstPathComponent(parameters[0]) != root.getDirectoryName()) {
+        copyFile(context, parameters, "move");  // File not in our system therefore cannot remove. (trusting user)
+        return;
+    }
+
+    std::string_view name;
+    int sourceIndex;
+    Directory* source = resolveFile(root, context.paths, parameters[0], name, sourceIndex);
+    const std::string_view targetRoot = firstPathComponent(parameters[1]);
+    if (sourceIndex != -1 && (isSingleComponent(parameters[1]) || targetRoot == root.getDirectoryName())) {
+        File outside;
+        const File* target = &outside;
+        if (isSingleComponent(parameters[1])) {
+            outside = File(std::string(targetRoot));
+            outside.touch();
+        } else {
+            int targetIndex;
+            Directory* parent = resolveFile(root, context.paths, parameters[1], name, targetIndex);
+            if (targetIndex == -1) {
+                targetIndex = parent->addFile(name);
+                parent->getFileAt(targetIndex).touch();
+            }
+            target = &parent->getFileAt(targetIndex);
         }
-
-        const std::vector<std::string> outsideFile = separatePath(parameters[0]);
-        if (outsideFile[0] != root.getDirectoryName()) {
-            const File temp(outsideFile[0]);
-            temp.touch();
-            temp.wc();
+        if (source->getFileAt(sourceIndex).moveTo(*target)) {
+            source->removeFileAt(sourceIndex);
             return;
         }
+    }
+    copyFile(context, parameters, nullptr);     // The source is removed right after, so it is copied in place.
+    removeFile(context, parameters[0]);
+}
 
-        std::vector<std::string> s_parameters(parameters.begin(),parameters.end());
-        s_parameters.emplace_back("wc");
-        fileCommandMap["cat_wc_remove"](s_parameters);
-    };
+/**
+ *  Cat command, look for a physical file to cat first.
+ *  Otherwise, the file is virtual, find it with findExistingFile.
+ *  Throw LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
+ **/
+void catCommand(CommandContext& context, const CommandArguments& parameters) {
+    const std::string_view outsideFile = firstPathComponent(parameters[0]);
+    if (outsideFile != context.root.getDirectoryName()) {
+        const File temp{std::string(outsideFile)};
+        temp.touch();
+        temp.cat(context.output);
+        return;
+    }
+    int target;
+    Directory::Lock lock;
+    Directory* current = findExistingFile(context, parameters[0], target, lock, false);
+    current->getFileAt(target).cat(context.output);
+}
 
-    /**
-     *  Ln command, creates a hard-link from the target file to the src file.
-     *  Both files must be virtual, inside our system.
-     *  Find the source file, (must be present), try to find the target file,(can be abscent).
-     *  After source is found and target made / found, target will now point on source.
-     *  Throw CommandException, LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
-     ***/
-    fileCommandMap["ln"] = [&root,&fileCommandMap](const std::vector<std::string>& parameters){
+/**
+ *  Wc command, check arguments, 'wc -r DIRECTORY' counts the whole subtree (see wcRecursive).
+ *  Otherwise look for a physical file to wc first.
+ *  Otherwise, the file is virtual, find it with findExistingFile.
+ *  Throw CommandException, LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
+ **/
+void wcCommand(CommandContext& context, const CommandArguments& parameters) {
+    if (!parameters.empty() && parameters[0] == "-r") {
         if (parameters.size() != 2) {
-            throw CommandException("'ln' requires 2 arguments.");
+            throw CommandException("'wc -r' requires 1 directory.");
         }
+        wcRecursive(*context.paths.resolveDirectory(context.root, parameters[1]), context.output);
+        return;
+    }
+    if(parameters.size() != 1){
+        throw CommandException("'wc' requires 1 argument.");
+    }
+
+    const std::string_view outsideFile = firstPathComponent(parameters[0]);
+    if (outsideFile != context.root.getDirectoryName()) {
+        const File temp{std::string(outsideFile)};
+        temp.touch();
+        temp.wc(context.output);
+        return;
+    }
+    int target;
+    Directory::Lock lock;
+    Directory* current = findExistingFile(context, parameters[0], target, lock, false);
+    current->getFileAt(target).wc(context.output);
+}
 
-        std::vector<std::string> path1 = separatePath(parameters[0]);
-        std::vector<std::string> path2 = separatePath(parameters[1]);
-
-        if (path1.empty() || path1[0] != root.getDirectoryName() ||
-            path2.empty() || path2[0] != root.getDirectoryName()) {
-            throw LocationException("Invalid path: must start from root.");
-        }
-
-        const std::vector<std::string> parent1(path1.begin() + 1, path1.end() - 1);
-        const std::vector<std::string> parent2(path2.begin() + 1, path2.end() - 1);
-
-        Directory* source = root.depthSearch(parent1);
-        Directory* target = root.depthSearch(parent2);
-
-        const int src_index = source->isFileExists(path1.back());
-        int trg_index = target->isFileExists(path2.back());
-
-        if (src_index == -1) {
-            throw FileNotFoundException("Source file does not exist.");
-        }
-        if (trg_index == -1) {
-            const std::vector<std::string> temp(parameters.begin() + 1, parameters.end());
-            fileCommandMap["touch"](temp);
-            trg_index = target->isFileExists(path2.back());
-        }
-        source->getFileAt(src_index).ln(target->getFileAt(trg_index));
-    };
-
-    /**
-     *  Cat or Wc or Remove function, since those 3 have identical exception checks, I merged them into one.
-     *  Check the existence of files, and preform the right operation based on the last parameter of the vector given.
-     *  Throw LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
-     ***/
-    fileCommandMap["cat_wc_remove"] = [&root](const std::vector<std::string>& parameters){
-        std::vector<std::string> path = separatePath(parameters[0]);
-        if (path.empty() || path[0] != root.getDirectoryName()) {
-            throw LocationException("Invalid path: must start from root.");
-        }
-
-        const std::vector<std::string> parent(path.begin() + 1, path.end() - 1);
-        Directory* current = root.depthSearch(parent);
-        const int target = current->isFileExists(path.back());
-        if(target == -1){
-            throw FileNotFoundException("File does not exist.");
-        }
-
-        if(parameters.back() == "cat") current->getFileAt(target).cat();
-        else if(parameters.back() == "wc") current->getFileAt(target).wc();
-        else{
-            current->getFileAt(target).remove();
-            current->removeFileAt(target);
-        }
-    };
-
-    return fileCommandMap;
-}
\ No newline at end of file
+/**
+ *  Ln command, creates a hard-link from the target file to the src file.
+ *  Both files must be virtual, inside our system.
+ *  Find the source file, (must be present), try to find the target file,(can be abscent).
+ *  After source is found and target made / found, target will now point on source.
+ *  Throw LocationException, FileNotFoundException, DirectoryNotFoundException, FileSystemException.
+ ***/
+void lnCommand(CommandContext& context, const CommandArguments& parameters) {
+    Directory& root = context.root;
+    if (firstPathComponent(parameters[0]) != root.getDirectoryName() ||
+        firstPathComponent(parameters[1]) != root.getDirectoryName()) {
+        throw LocationException("Invalid path: must start from root.");
+    }
+
+    std::string_view sourceName, targetName;
+    int src_index, trg_index;
+    Directory* source = resolveFile(root, context.paths, parameters[0], sourceName, src_index);
+    Directory* target = resolveFile(root, context.paths, parameters[1], targetName, trg_index);
+
+    if (src_index == -1) {
+        throw FileNotFoundException("Source file does not exist.");
+    }
+    if (trg_index == -1) {                  // Same as touch on the target.
+        trg_index = target->addFile(targetName);
+        target->getFileAt(trg_index).touch();
+    }
+    source->getFileAt(src_index).ln(target->getFileAt(trg_index));
+}
+
+// Sync command, writes back every dirty cached page and every changed memory or inline content into its physical file,
+// and makes every journaled command durable.
+void syncCommand(CommandContext&, const CommandArguments&) {
+    FileStorage::syncAll();
+    Journal::instance().commit();
+}
+
+// Stats command, prints the storage backend, the counters of the handle, page and path caches,
+// the throughput of every host copy method used so far, and what ran in the background.
+void statsCommand(CommandContext& context, const CommandArguments&) {
+    OutputBuffer& output = context.output;
+    const FileHandleCache& handles = FileHandleCache::instance();
+    const PageCache& pages = PageCache::instance();
+    output << "Storage backend: " << FileStorage::getBackendName() << "\n";
+    output << "Word count kernel: " << WordCount::kernelName() << "\n";
+    output << "Handle cache: open " << handles.openFiles() << "/" << handles.getCapacity()
+           << ", hits " << handles.getHits() << ", misses " << handles.getMisses()
+           << ", evictions " << handles.getEvictions() << "\n";
+    output << "Page cache: pages " << pages.cachedPages() << ", hits " << pages.getHits()
+           << ", misses " << pages.getMisses() << ", write-backs " << pages.getWriteBacks() << "\n";
+    output << "Memory storage: shared copies " << MemoryStorage::getShares()
+           << ", copies on write " << MemoryStorage::getDetaches() << "\n";
+    output << "Inline storage: limit " << InlineStorage::getLimit() << " bytes, promotions "
+           << InlineStorage::getPromotions() << "\n";
+    if (FileStorage::getBackend() == StorageBackend::Image) {
+        const ImageFile& image = ImageFile::instance();
+        output << "Image: size " << image.getFileSize() << ", used " << image.getUsedBytes()
+               << ", free " << image.getFreeBytes() << " (" << image.getFreeExtents() << " free extents)"
+               << ", relocations " << image.getRelocations() << ", compactions " << image.getCompactions() << "\n";
+    }
+    const Journal& journal = Journal::instance();
+    if (journal.isActive()) {
+        output << "Journal: " << journal.getPath() << ", records " << journal.getRecords() << ", commits "
+               << journal.getCommits() << ", bytes " << journal.getBytes() << ", commit interval "
+               << static_cast<size_t>(Journal::getInterval()) << " ms\n";
+    }
+    const HostCopy& hostCopy = HostCopy::instance();
+    for (int method = 0; method < HostCopy::method_count; method++) {     // Only the methods that were used.
+        const auto current = static_cast<HostCopy::Method>(method);
+        if (hostCopy.getCalls(current) == 0) continue;
+        output << "Host copy (" << HostCopy::methodName(current) << "): files " << hostCopy.getCalls(current)
+               << ", bytes " << hostCopy.getBytes(current) << ", "
+               << static_cast<size_t>(hostCopy.getBytesPerSecond(current) / (1024 * 1024)) << " MB/s\n";
+    }
+    const AsyncIO& asyncIO = AsyncIO::instance();
+    output << "Async I/O: " << asyncIO.getEngineName() << ", background copies " << asyncIO.getCopies()
+           << ", bytes " << static_cast<size_t>(asyncIO.getCopiedBytes()) << ", "
+           << static_cast<size_t>(asyncIO.getCopyBytesPerSecond() / (1024 * 1024)) << " MB/s, unlinks "
+           << asyncIO.getUnlinks() << ", submissions " << asyncIO.getSubmissions() << "\n";
+    const PathCache& paths = context.paths;
+    output << "Path cache: entries " << paths.size() << ", hits " << paths.getHits()
+           << ", misses " << paths.getMisses() << ", invalidations " << paths.getInvalidations() << "\n";
+}
+
+// Jobs command, lists the copies running in the background with their progress, and the ones that ended since.
+void jobsCommand(CommandContext& context, const CommandArguments&) {
+    if (context.jobs) {
+        context.jobs->list(context.output);
+    }
+}
+
+// Wait command, waits for every background copy, or for the one with the number given.
+// Throw NotIndexException, CommandException.
+void waitCommand(CommandContext& context, const CommandArguments& parameters) {
+    if (!context.jobs) return;
+    if (parameters.empty()) {
+        context.jobs->waitAll(context.output);
+        return;
+    }
+    size_t id = 0;
+    const std::string_view number = parameters[0];
+    const auto parsed = std::from_chars(number.data(), number.data() + number.length(), id);
+    if (parsed.ec != std::errc() || parsed.ptr != number.data() + number.length()) {
+        throw NotIndexException("Invalid job number.");
+    }
+    if (!context.jobs->wait(id, context.output)) {
+        throw CommandException("No such job.");
+    }
+}
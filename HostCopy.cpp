@@ -0,0 +1,279 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+#include "HostCopy.h"
+#include "AsyncIO.h"
+#include "FileStorage.h"
+#include "FileSystemException.h"
+
+constexpr size_t HostCopy::block_size;
+
+// Function that returns the single instance shared by every File.
+HostCopy& HostCopy::instance() {
+    static HostCopy hostCopy;
+    return hostCopy;
+}
+
+// Function that returns the name of a method, as printed by 'stats'.
+const char* HostCopy::methodName(const Method method) {
+    switch (method) {
+        case Reflink: return "reflink";
+        case CopyFileRange: return "copy_file_range";
+        case Sendfile: return "sendfile";
+        case Splice: return "splice";
+        case Rename: return "rename";
+        case ReadWrite:
+        default: return "read/write";
+    }
+}
+
+// Function that returns the average throughput of a method, 0 if it was never used.
+double HostCopy::getBytesPerSecond(const Method method) const {
+    const Counter& counter = counters[method];
+    return counter.seconds > 0 ? static_cast<double>(counter.bytes) / counter.seconds : 0;
+}
+
+// Function that adds one call of a method, with its bytes and time, to the counters.
+void HostCopy::record(const Method method, const size_t bytes, const double seconds) {
+    const std::lock_guard<std::mutex> lock(counterMutex);
+    Counter& counter = counters[method];
+    ++counter.calls;
+    counter.bytes += bytes;
+    counter.seconds += seconds;
+}
+
+// Function that copies the rest of the source descriptor (from its current offset) with read/write.
+// Returns the amount of bytes copied.
+static size_t copyBlocks(const int source, const int destination) {
+    char buffer[HostCopy::block_size];
+    size_t copied = 0;
+    while (true) {
+        const ssize_t count = ::read(source, buffer, sizeof(buffer));
+        if (count <= 0) break;
+        ssize_t written = 0;
+        while (written < count) {
+            const ssize_t step = ::write(destination, buffer + written, static_cast<size_t>(count - written));
+            if (step <= 0) {
+                throw FileSystemException("Failed to write the file.");
+            }
+            written += step;
+        }
+        copied += static_cast<size_t>(count);
+    }
+    return copied;
+}
+
+// Function that makes destination share the blocks of source (FICLONE), only some filesystems can.
+static bool reflink(const int source, const int destination, const size_t size) {
+#ifdef __linux__
+    return size > 0 && ioctl(destination, FICLONE, source) == 0;
+#else
+    (void) source;
+    (void) destination;
+    (void) size;
+    return false;
+#endif
+}
+
+// Function that copies 'size' bytes between two open descriptors, and returns the method that did it.
+// Each kernel method is tried until one works, a method that is not supported fails before copying anything.
+HostCopy::Method HostCopy::transfer(const int source, const int destination, const size_t size, size_t& copied) {
+    copied = 0;
+    if (reflink(source, destination, size)) {
+        copied = size;
+        return Reflink;
+    }
+#ifdef __linux__
+    while (copied < size) {
+        const ssize_t count = copy_file_range(source, nullptr, destination, nullptr, size - copied, 0);
+        if (count <= 0) break;
+        copied += static_cast<size_t>(count);
+    }
+    if (copied == size) return CopyFileRange;
+    if (copied == 0) {
+        while (copied < size) {
+            const ssize_t count = sendfile(destination, source, nullptr, size - copied);
+            if (count <= 0) break;
+            copied += static_cast<size_t>(count);
+        }
+        if (copied == size) return Sendfile;
+    }
+#endif
+    copied += copyBlocks(source, destination);      // Portable fallback, also finishes a kernel copy that stopped midway.
+    return ReadWrite;
+}
+
+// Function that copies 'size' bytes between two open descriptors (used by the background copies of
+// the thread pool), and counts the call under the method that did it.
+size_t HostCopy::copyDescriptors(const int source, const int destination, const size_t size) {
+    const auto start = std::chrono::steady_clock::now();
+    size_t copied;
+    const Method method = transfer(source, destination, size, copied);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    record(method, copied, elapsed.count());
+    return copied;
+}
+
+// Function that copies the physical file of source over the physical file of destination.
+// The cached changes of source are written first, and the cached content of destination is dropped,
+// then the files are copied by the kernel. Copying a physical file onto itself, or a content without
+// a physical file (image), is left to the caller.
+// A large copy with a ticket goes on in the background once both files are open (see AsyncIO),
+// the caller must not touch either file before it ended. A reflink needs no background.
+bool HostCopy::copy(FileStorage& source, FileStorage& destination, size_t& copied, std::uint64_t* ticket) {
+    if (ticket) {
+        *ticket = 0;
+    }
+    if (&source == &destination || source.getFilename() == destination.getFilename() ||
+        !source.hasHostFile() || !destination.hasHostFile()) {
+        return false;
+    }
+    source.flush();
+    const int input = ::open(source.getFilename().c_str(), O_RDONLY);
+    if (input < 0) {
+        return false;
+    }
+    struct stat status{};
+    if (fstat(input, &status) != 0) {
+        ::close(input);
+        return false;
+    }
+    destination.discard();
+    const int output = ::open(destination.getFilename().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output < 0) {
+        ::close(input);
+        throw FileSystemException("Failed to open the file.");
+    }
+
+    const size_t size = static_cast<size_t>(status.st_size);
+    const auto start = std::chrono::steady_clock::now();
+    Method method = Reflink;
+    if (ticket && size >= AsyncIO::getThreshold()) {
+        if (!reflink(input, output, size)) {
+            *ticket = AsyncIO::instance().copy(input, output, size);
+            copied = size;
+            return true;
+        }
+        copied = size;
+    } else {
+        try {
+            method = transfer(input, output, size, copied);
+        } catch (...) {
+            ::close(input);
+            ::close(output);
+            throw;
+        }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ::close(input);
+    ::close(output);
+
+    record(method, copied, elapsed.count());
+    return true;
+}
+
+// Function that moves the physical file of source over the physical file of destination with rename(2).
+// Fails (without changing anything) if the files are on different filesystems, then the caller copies instead.
+bool HostCopy::move(FileStorage& source, FileStorage& destination, const size_t size) {
+    if (&source == &destination || source.getFilename() == destination.getFilename() ||
+        !source.hasHostFile() || !destination.hasHostFile()) {
+        return false;
+    }
+    source.flush();
+    const auto start = std::chrono::steady_clock::now();
+    if (std::rename(source.getFilename().c_str(), destination.getFilename().c_str()) != 0) {
+        return false;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    source.discard();
+    destination.discard();
+
+    record(Rename, size, elapsed.count());
+    return true;
+}
+
+#ifdef __linux__
+// Function that checks if the kernel can send a file into the output descriptor, and if it is a pipe.
+// A terminal (or anything else) is left to the caller.
+static bool isSendTarget(const int output, bool& pipe) {
+    struct stat target{};
+    if (fstat(output, &target) != 0) {
+        return false;
+    }
+    pipe = S_ISFIFO(target.st_mode);
+    return pipe || S_ISREG(target.st_mode) || S_ISSOCK(target.st_mode);
+}
+#endif
+
+// Function that sends the content of source into the output descriptor without user-space buffers.
+// A pipe gets the content with splice, a regular file or a socket with sendfile (both move the output offset),
+// a terminal (or a backend whose content is not on the host) is left to the caller.
+bool HostCopy::send(FileStorage& source, const int output) {
+#ifdef __linux__
+    bool pipe;
+    if (!source.isHostBacked() || !isSendTarget(output, pipe)) {
+        return false;
+    }
+    source.flush();
+    return send(source.getFilename(), source.size(), output);
+#else
+    (void) source;
+    (void) output;
+    return false;
+#endif
+}
+
+// Function that sends 'size' bytes of a physical file into the output descriptor.
+// If the kernel stops midway, the rest is written with read/write, so the output is always complete.
+bool HostCopy::send(const std::string& filename, const size_t size, const int output) {
+#ifdef __linux__
+    bool pipe;
+    if (!isSendTarget(output, pipe)) {
+        return false;
+    }
+    const int input = ::open(filename.c_str(), O_RDONLY);
+    if (input < 0) {
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t sent = 0;
+    while (sent < size) {
+        const ssize_t count = pipe
+            ? splice(input, nullptr, output, nullptr, size - sent, SPLICE_F_MOVE)
+            : sendfile(output, input, nullptr, size - sent);
+        if (count <= 0) break;
+        sent += static_cast<size_t>(count);
+    }
+    if (sent == 0 && size > 0) {        // Not supported here (for example an O_APPEND file), nothing was written.
+        ::close(input);
+        return false;
+    }
+    if (sent < size) {                  // Both calls moved the input offset, read/write continues from there.
+        try {
+            sent += copyBlocks(input, output);
+        } catch (...) {
+            ::close(input);
+            throw;
+        }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ::close(input);
+
+    record(pipe ? Splice : Sendfile, sent, elapsed.count());
+    return true;
+#else
+    (void) filename;
+    (void) size;
+    (void) output;
+    return false;
+#endif
+}
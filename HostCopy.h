@@ -0,0 +1,66 @@
+#ifndef FIRSTPROJECT_HOSTCOPY_H
+#define FIRSTPROJECT_HOSTCOPY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+class FileStorage;  // Forward declaration to eliminate circular including.
+
+/**
+ * HostCopy copies and moves whole physical files inside the kernel, without passing the content
+ * through user-space buffers. A copy tries, in order: a reflink (FICLONE, the filesystem shares the blocks),
+ * copy_file_range, sendfile, and a plain read/write loop as the portable fallback.
+ * A move of a file nobody else references becomes a rename, with no data copy at all.
+ * cat sends a physical file straight to stdout with splice (pipe) or sendfile (file, socket).
+ * Every method counts its calls, bytes and time, so 'stats' can report the throughput of each one.
+ * Sending a physical file that was already written back needs no storage, so daemon sessions send in parallel.
+ * A copy of at least AsyncIO::getThreshold() bytes may be handed to AsyncIO once both files are open,
+ * unless a reflink copies it at once.
+ * **/
+class HostCopy {
+public:
+    enum Method { Reflink, CopyFileRange, Sendfile, Splice, ReadWrite, Rename, method_count };
+
+private:
+    struct Counter {
+        size_t calls = 0;           //< Files copied (or renamed) with this method.
+        size_t bytes = 0;           //< Bytes copied (or moved) with this method.
+        double seconds = 0;         //< Time spent inside this method.
+    };
+    Counter counters[method_count];
+    std::mutex counterMutex;            //< Guards the counters, updated by sends running outside the storage Guard.
+
+    HostCopy() = default;
+    Method transfer(int source, int destination, size_t size, size_t& copied);     // Copies with the best working method.
+    void record(Method method, size_t bytes, double seconds);                       // Adds one call to a counter.
+
+public:
+    static constexpr size_t block_size = 64 * 1024;     // Size of the blocks of the read/write fallback.
+
+    HostCopy(const HostCopy&) = delete;
+    HostCopy& operator=(const HostCopy&) = delete;
+
+    static HostCopy& instance();                        // Returns the process-wide instance.
+    static const char* methodName(Method method);
+
+    // Replaces the content of destination with the content of source, returns false if it must be copied by the caller.
+    // With 'ticket', a large copy runs in the background, 'ticket' is set to its AsyncIO ticket (0 if it is done).
+    bool copy(FileStorage& source, FileStorage& destination, size_t& copied, std::uint64_t* ticket = nullptr);
+    // Copies 'size' bytes between two open descriptors with the best working method, returns the bytes copied.
+    size_t copyDescriptors(int source, int destination, size_t size);
+    // Renames the physical file of source over the one of destination, returns false if they are on different filesystems.
+    bool move(FileStorage& source, FileStorage& destination, size_t size);
+    // Writes the whole content of source into an output descriptor inside the kernel,
+    // returns false (before writing anything) if the descriptor or the backend does not allow it.
+    bool send(FileStorage& source, int output);
+    // Same as above for a physical file whose content is already written back, 'size' bytes of it are sent.
+    bool send(const std::string& filename, size_t size, int output);
+
+    size_t getCalls(Method method) const { return counters[method].calls; }
+    size_t getBytes(Method method) const { return counters[method].bytes; }
+    double getBytesPerSecond(Method method) const;
+};
+
+#endif //FIRSTPROJECT_HOSTCOPY_H
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "ImageFile.h"
+#include "FileSystemException.h"
+
+constexpr size_t ImageFile::granule;
+constexpr size_t ImageFile::initial_size;
+constexpr size_t ImageFile::compact_min;
+constexpr size_t ImageFile::reserved;
+
+// Function that rounds a size up to a multiple of 'step' (at least one step).
+static size_t roundUp(const size_t size, const size_t step) {
+    return size == 0 ? step : (size + step - 1) / step * step;
+}
+
+ImageFile::ImageFile()
+    : path("V.img"), descriptor(-1), base(nullptr), fileSize(0), end(0), usedBytes(0), freeBytes(0),
+      pins(0), compactions(0), relocations(0) {}
+
+// Destructor, unmaps and removes the image, like the physical files are removed at exit.
+ImageFile::~ImageFile() {
+    if (descriptor < 0) return;
+    munmap(base, reserved);
+    ::close(descriptor);
+    ::unlink(path.c_str());
+}
+
+// Function that returns the single image shared by every ImageStorage.
+ImageFile& ImageFile::instance() {
+    static ImageFile image;
+    return image;
+}
+
+// Function that changes the physical file of the image, ignored once the image is in use.
+void ImageFile::setPath(std::string imagePath) {
+    if (descriptor < 0) {
+        path = std::move(imagePath);
+    }
+}
+
+// Function that creates the image (replacing an old one), maps the whole reserved range, and preallocates it.
+// Pages of the mapping past the end of the physical file are never touched, extents always lie below it.
+void ImageFile::create() {
+    descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to create the image.");
+    }
+    void* mapping = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(descriptor);
+        descriptor = -1;
+        ::unlink(path.c_str());
+        throw FileSystemException("Failed to map the image.");
+    }
+    base = static_cast<char*>(mapping);
+    resize(initial_size);
+}
+
+// Function that changes the size of the physical file. Growing allocates the blocks (fallocate),
+// so writing through the mapping never finds a full disk.
+void ImageFile::resize(const size_t size) {
+    if (size > reserved) {
+        throw FileSystemException("The image is full.");
+    }
+    if (size > fileSize) {
+        const int error = posix_fallocate(descriptor, static_cast<off_t>(fileSize), static_cast<off_t>(size - fileSize));
+        if (error != 0) {
+            throw FileSystemException("Failed to grow the image.");
+        }
+    } else if (ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+        return;                                 // The image stays larger, nothing is lost.
+    }
+    fileSize = size;
+}
+
+// Function that returns 'capacity' bytes of the image: the smallest free range that fits (its rest stays free),
+// or the space at the end of the used part, growing the physical file (at least doubling it) if needed.
+size_t ImageFile::take(const size_t capacity) {
+    if (descriptor < 0) {
+        create();
+    }
+    usedBytes += capacity;
+    const auto fit = freeBySize.lower_bound(std::make_pair(capacity, size_t(0)));
+    if (fit != freeBySize.end()) {
+        const size_t offset = fit->second;
+        const size_t length = fit->first;
+        removeFree(freeByOffset.find(offset));
+        if (length > capacity) {
+            addFree(offset + capacity, length - capacity);
+        }
+        return offset;
+    }
+    if (end + capacity > fileSize) {
+        try {
+            resize(roundUp(std::max(end + capacity, fileSize * 2), initial_size));
+        } catch (...) {
+            usedBytes -= capacity;
+            throw;
+        }
+    }
+    const size_t offset = end;
+    end += capacity;
+    return offset;
+}
+
+// Function that gives an extent back to the free list.
+void ImageFile::giveBack(const size_t offset, const size_t capacity) {
+    usedBytes -= capacity;
+    addFree(offset, capacity);
+}
+
+// Function that adds a range to the free list, merged with the free ranges right before and after it.
+// A free range reaching the end of the used part is not kept, the used part shrinks instead.
+void ImageFile::addFree(size_t offset, size_t length) {
+    auto next = freeByOffset.lower_bound(offset);
+    if (next != freeByOffset.begin()) {
+        const auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            length += previous->second;
+            removeFree(previous);
+        }
+    }
+    if (next != freeByOffset.end() && offset + length == next->first) {
+        length += next->second;
+        removeFree(next);
+    }
+    if (offset + length == end) {
+        end = offset;
+        return;
+    }
+    freeByOffset.emplace(offset, length);
+    freeBySize.emplace(length, offset);
+    freeBytes += length;
+}
+
+// Function that removes a range from the free list.
+void ImageFile::removeFree(const std::map<size_t, size_t>::iterator range) {
+    freeBySize.erase(std::make_pair(range->second, range->first));
+    freeBytes -= range->second;
+    freeByOffset.erase(range);
+}
+
+// Function that compacts the image once more space is free inside it than used, unless a block is pinned,
+// and shrinks a physical file that is mostly unused.
+void ImageFile::reclaim() {
+    if (pins > 0) return;
+    if (freeBytes >= compact_min && freeBytes > usedBytes) {
+        compact();
+    }
+    if (fileSize > initial_size && end < fileSize / 4) {
+        resize(roundUp(std::max(end * 2, initial_size), initial_size));
+    }
+}
+
+// Function that gives an empty extent room for 'bytes' bytes.
+void ImageFile::allocate(Extent& extent, const size_t bytes) {
+    const size_t capacity = roundUp(bytes, granule);
+    extent.offset = take(capacity);
+    extent.capacity = capacity;
+    owners[extent.offset] = &extent;
+}
+
+// Function that makes room for 'needed' bytes in an extent holding 'used' bytes, the capacity at least doubles.
+// The extent grows in place if the space after it is free (or is the end of the used part),
+// otherwise it moves to a new place, and its first 'used' bytes are copied there.
+void ImageFile::grow(Extent& extent, const size_t needed, const size_t used) {
+    if (needed <= extent.capacity) return;
+    if (extent.capacity == 0) {
+        allocate(extent, needed);
+        return;
+    }
+    const size_t capacity = roundUp(std::max(needed, extent.capacity * 2), granule);
+    const size_t extra = capacity - extent.capacity;
+    const size_t after = extent.offset + extent.capacity;
+    if (after == end) {
+        if (end + extra > fileSize) {
+            resize(roundUp(std::max(end + extra, fileSize * 2), initial_size));
+        }
+        end += extra;
+        usedBytes += extra;
+        extent.capacity = capacity;
+        return;
+    }
+    const auto next = freeByOffset.find(after);
+    if (next != freeByOffset.end() && next->second >= extra) {
+        const size_t rest = next->second - extra;
+        removeFree(next);
+        if (rest > 0) {
+            addFree(after + extra, rest);
+        }
+        usedBytes += extra;
+        extent.capacity = capacity;
+        return;
+    }
+
+    const size_t offset = take(capacity);
+    std::memcpy(base + offset, base + extent.offset, used);
+    owners.erase(extent.offset);
+    giveBack(extent.offset, extent.capacity);
+    extent.offset = offset;
+    extent.capacity = capacity;
+    owners[offset] = &extent;
+    ++relocations;
+    reclaim();
+}
+
+// Function that frees an extent, which becomes empty.
+void ImageFile::release(Extent& extent) {
+    if (extent.capacity == 0) return;
+    owners.erase(extent.offset);
+    giveBack(extent.offset, extent.capacity);
+    extent = Extent();
+    reclaim();
+}
+
+// Function that hands the extent of source to an empty extent, source becomes empty.
+void ImageFile::adopt(Extent& extent, Extent& source) {
+    extent = source;
+    source = Extent();
+    if (extent.capacity > 0) {
+        owners[extent.offset] = &extent;
+    }
+}
+
+// Function that slides every extent, in order, right after the previous one, so the free list becomes empty.
+// Ranges only move towards the start of the image, memmove handles the overlaps.
+void ImageFile::compact() {
+    std::map<size_t, Extent*> moved;
+    size_t cursor = 0;
+    for (const auto& owner : owners) {
+        Extent& extent = *owner.second;
+        if (extent.offset != cursor) {
+            std::memmove(base + cursor, base + extent.offset, extent.capacity);
+            extent.offset = cursor;
+        }
+        moved.emplace_hint(moved.end(), cursor, &extent);
+        cursor += extent.capacity;
+    }
+    owners.swap(moved);
+    freeByOffset.clear();
+    freeBySize.clear();
+    freeBytes = 0;
+    end = cursor;
+    ++compactions;
+}
@@ -0,0 +1,84 @@
+#ifndef FIRSTPROJECT_IMAGEFILE_H
+#define FIRSTPROJECT_IMAGEFILE_H
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+/**
+ * ImageFile is one preallocated physical file holding the content of every ImageStorage, each one in an extent.
+ * The image is mapped once into a large reserved address range, so it grows with fallocate and never moves:
+ * character and ranged access are memory accesses, and no virtual file costs an inode, an open or an unlink.
+ * Extents are allocated in granules, from the free list (best fit) or at the end of the used part.
+ * Freed extents are merged with their free neighbours, a free extent at the end gives the space back.
+ * A growing content is extended in place when the space after it is free, and moved otherwise.
+ * Once more space is free than used (and at least compact_min bytes), the used extents are compacted
+ * towards the start of the image and the file is shrunk. Compaction waits while a block is pinned (forEachBlock).
+ * The image is created on first use, and removed at exit like the physical files of the other backends.
+ * **/
+class ImageFile {
+public:
+    // Place of a content inside the image, registered so compaction can move it.
+    struct Extent {
+        size_t offset = 0;
+        size_t capacity = 0;        //< Bytes owned, 0 for an empty content.
+    };
+
+private:
+    std::string path;                                   //< Physical file of the image.
+    int descriptor;                                     //< Open image, -1 before first use.
+    char* base;                                         //< Start of the reserved mapping.
+    size_t fileSize;                                    //< Size of the physical file (preallocated).
+    size_t end;                                         //< End of the used part, everything after it is free.
+    size_t usedBytes;                                   //< Capacity of every allocated extent.
+    size_t freeBytes;                                   //< Bytes inside the free list.
+    std::map<size_t, size_t> freeByOffset;              //< Free list: offset -> length.
+    std::set<std::pair<size_t, size_t>> freeBySize;     //< Free list: (length, offset), for best fit.
+    std::map<size_t, Extent*> owners;                   //< Allocated extents by offset.
+    int pins;                                           //< Blocks handed out by forEachBlock right now.
+    size_t compactions;                                 //< Times the image was compacted.
+    size_t relocations;                                 //< Extents moved because they could not grow in place.
+
+    ImageFile();
+    ~ImageFile();
+    void create();                                      // Creates, preallocates and maps the image.
+    void resize(size_t size);                           // Grows (fallocate) or shrinks the physical file.
+    size_t take(size_t capacity);                       // Returns the offset of 'capacity' free bytes.
+    void giveBack(size_t offset, size_t capacity);      // Frees a range of the image.
+    void addFree(size_t offset, size_t length);         // Adds a range to the free list, merging neighbours.
+    void removeFree(std::map<size_t, size_t>::iterator range);     // Removes a range from the free list.
+    void reclaim();                                     // Compacts and shrinks the image when worth it.
+    void compact();                                     // Slides every extent towards the start of the image.
+
+public:
+    static constexpr size_t granule = 64;                       // Extents are a whole amount of granules.
+    static constexpr size_t initial_size = 1024 * 1024;         // Preallocated size of a new image.
+    static constexpr size_t compact_min = 1024 * 1024;          // Less free space than this is never compacted.
+    static constexpr size_t reserved = sizeof(size_t) >= 8 ? size_t(1) << 40 : size_t(1) << 30;    // Maximal image size.
+
+    ImageFile(const ImageFile&) = delete;
+    ImageFile& operator=(const ImageFile&) = delete;
+
+    static ImageFile& instance();                       // Returns the process-wide image.
+    void setPath(std::string imagePath);                // Changes the physical file, only before first use.
+
+    char* at(const Extent& extent) { return base + extent.offset; }    // Content of an allocated extent.
+    void allocate(Extent& extent, size_t bytes);        // Gives an empty extent room for 'bytes' bytes.
+    void grow(Extent& extent, size_t needed, size_t used);  // Makes room for 'needed' bytes, keeping 'used' bytes.
+    void release(Extent& extent);                       // Frees an extent, it becomes empty.
+    void adopt(Extent& extent, Extent& source);         // Moves an allocated extent to another owner.
+    void pin() { ++pins; }                              // A block of the image is in use, compaction waits.
+    void unpin() { --pins; }
+
+    const std::string& getPath() const { return path; }
+    size_t getFileSize() const { return fileSize; }
+    size_t getUsedBytes() const { return usedBytes; }
+    size_t getFreeBytes() const { return freeBytes + (fileSize - end); }
+    size_t getFreeExtents() const { return freeByOffset.size(); }
+    size_t getCompactions() const { return compactions; }
+    size_t getRelocations() const { return relocations; }
+};
+
+#endif //FIRSTPROJECT_IMAGEFILE_H
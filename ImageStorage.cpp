@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstring>
+#include "ImageStorage.h"
+
+// Destructor, gives the extent back to the image.
+ImageStorage::~ImageStorage() {
+    const Guard guard;
+    ImageFile::instance().release(extent);
+}
+
+// Function that makes room for the first 'needed' bytes, zero filling a gap after the content.
+char* ImageStorage::reserve(const size_t needed) {
+    ImageFile& image = ImageFile::instance();
+    image.grow(extent, needed, length);
+    char* content = image.at(extent);
+    if (needed > length) {
+        std::memset(content + length, 0, needed - length);
+    }
+    return content;
+}
+
+// Function that reads one character from the image, 0 past the end.
+char ImageStorage::read(const size_t index) {
+    return index < length ? ImageFile::instance().at(extent)[index] : 0;
+}
+
+// Function that writes one character into the image, growing the extent if needed.
+void ImageStorage::write(const size_t index, const char c) {
+    reserve(std::max(length, index + 1))[index] = c;
+    length = std::max(length, index + 1);
+}
+
+// Function that copies a range out of the image, returns the amount of bytes read.
+size_t ImageStorage::read(const size_t position, char* buffer, const size_t amount) {
+    if (position >= length) return 0;
+    const size_t available = std::min(amount, length - position);
+    std::memcpy(buffer, ImageFile::instance().at(extent) + position, available);
+    return available;
+}
+
+// Function that copies a range into the image, growing the extent if needed.
+void ImageStorage::write(const size_t position, const char* source, const size_t amount) {
+    if (amount == 0) return;
+    char* content = reserve(std::max(length, position + amount));
+    std::memcpy(content + position, source, amount);
+    length = std::max(length, position + amount);
+}
+
+// Function that hands the whole content to the consumer as one block of the image.
+// The image is pinned meanwhile, so a write of the consumer into another storage does not compact it.
+void ImageStorage::forEachBlock(const BlockConsumer& consumer) {
+    if (length == 0) return;
+    ImageFile& image = ImageFile::instance();
+    image.pin();
+    try {
+        consumer(image.at(extent), length);
+    } catch (...) {
+        image.unpin();
+        throw;
+    }
+    image.unpin();
+}
+
+// Function that replaces the content with the content of another ImageStorage, with one copy inside the image.
+// Returns false for any other source (or itself), the caller copies it block by block.
+bool ImageStorage::share(FileStorage& source) {
+    const ImageStorage* other = dynamic_cast<ImageStorage*>(&source);
+    if (other == nullptr || other == this) return false;
+    ImageFile& image = ImageFile::instance();
+    if (extent.capacity < other->length) {
+        image.release(extent);
+    }
+    length = 0;
+    if (other->length > 0) {
+        image.grow(extent, other->length, 0);
+        std::memcpy(image.at(extent), image.at(other->extent), other->length);
+    }
+    length = other->length;
+    return true;
+}
+
+// Function that takes over the extent of another ImageStorage, whose content becomes empty, no byte is copied.
+bool ImageStorage::take(FileStorage& source) {
+    ImageStorage* other = dynamic_cast<ImageStorage*>(&source);
+    if (other == nullptr || other == this) return false;
+    ImageFile& image = ImageFile::instance();
+    image.release(extent);
+    image.adopt(extent, other->extent);
+    length = other->length;
+    other->length = 0;
+    return true;
+}
+
+// Function that empties the content and frees its extent.
+void ImageStorage::truncate() {
+    ImageFile::instance().release(extent);
+    length = 0;
+}
+
+// Function that drops the content, used when the file is removed.
+void ImageStorage::discard() {
+    truncate();
+}
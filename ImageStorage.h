@@ -0,0 +1,44 @@
+#ifndef FIRSTPROJECT_IMAGESTORAGE_H
+#define FIRSTPROJECT_IMAGESTORAGE_H
+
+#include "FileStorage.h"
+#include "ImageFile.h"
+
+/**
+ * ImageStorage is a FileStorage backend keeping the content in an extent of the ImageFile,
+ * instead of a physical file of its own: touch and remove cost no system call, and so do most writes.
+ * Character access, ranged access, cat and wc are memory accesses into the mapped image.
+ * A copy between two image storages is one copy inside the image, a move hands the extent over.
+ * Like MemoryStorage, the content belongs to the storage: a hard-link left after its file was removed
+ * does not see a new file created under the same name.
+ * Files outside the virtual tree keep their physical files (StreamStorage), they are copied block by block.
+ * **/
+class ImageStorage final : public FileStorage {
+    ImageFile::Extent extent;   //< Place of the content inside the image.
+    size_t length;              //< Size of the content.
+
+    char* reserve(size_t needed);       // Makes room for 'needed' bytes, returns the start of the content.
+
+public:
+    explicit ImageStorage(std::string name): FileStorage(std::move(name)), length(0) {}
+    ~ImageStorage() override;
+
+    char read(size_t index) override;
+    void write(size_t index, char c) override;
+    size_t read(size_t position, char* buffer, size_t length) override;
+    void write(size_t position, const char* data, size_t length) override;
+    void forEachBlock(const BlockConsumer& consumer) override;
+    size_t size() override { return length; }
+    bool share(FileStorage& source) override;
+    bool take(FileStorage& source) override;
+    bool isHostBacked() const override { return false; }       // The content lives in the image.
+    bool hasHostFile() const override { return false; }
+
+    void create() override {}           // Nothing to create, the image is created by the first write.
+    void truncate() override;
+    void flush() override {}            // Writes go straight into the mapped image.
+    void close() override {}            // Holds no handle of its own.
+    void discard() override;
+};
+
+#endif //FIRSTPROJECT_IMAGESTORAGE_H
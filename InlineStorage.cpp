@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "InlineStorage.h"
+#include "FileSystemException.h"
+
+constexpr size_t InlineStorage::capacity;
+size_t InlineStorage::limit = InlineStorage::capacity;
+size_t InlineStorage::promotions = 0;
+
+// Function that returns the set of inline storages whose content is newer than their physical file.
+std::unordered_set<InlineStorage*>& InlineStorage::dirtyStorages() {
+    static std::unordered_set<InlineStorage*> dirty;
+    return dirty;
+}
+
+// Destructor, the content is dropped like the content of any removed file.
+InlineStorage::~InlineStorage() {
+    dirtyStorages().erase(this);
+}
+
+// Function that changes the largest content kept inline, used by '--inline-size' before any file exists.
+void InlineStorage::setLimit(const size_t bytes) {
+    limit = std::min(bytes, capacity);
+}
+
+// Function that writes back every inline content changed since the last sync, used by 'sync'.
+void InlineStorage::syncAll() {
+    std::unordered_set<InlineStorage*> dirty;
+    dirty.swap(dirtyStorages());
+    for (InlineStorage* storage : dirty) {
+        try {
+            storage->writeBack();
+        } catch (...) {
+            dirtyStorages().insert(storage);
+            throw;
+        }
+    }
+}
+
+// Function that prepares the dirty set for many new contents at once (a snapshot being loaded),
+// so it is sized once instead of rehashing while it grows.
+void InlineStorage::expectDirty(const size_t amount) {
+    dirtyStorages().reserve(dirtyStorages().size() + amount);
+}
+
+// Function that registers this storage for the next write back.
+void InlineStorage::markDirty() {
+    dirtyStorages().insert(this);
+}
+
+// Function that replaces the physical file with the content.
+void InlineStorage::writeBack() {
+    const int descriptor = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to open the file.");
+    }
+    size_t total = 0;
+    while (total < length) {
+        const ssize_t count = ::write(descriptor, bytes + total, length - total);
+        if (count <= 0) break;
+        total += static_cast<size_t>(count);
+    }
+    ::close(descriptor);
+    if (total < length) {
+        throw FileSystemException("Failed to write the file.");
+    }
+    written = true;
+}
+
+// Function that makes this storage a copy of another inline storage (name and content), used when a FileValue is copied.
+void InlineStorage::assign(const InlineStorage& source) {
+    if (&source == this) return;
+    filename = source.filename;
+    std::memcpy(bytes, source.bytes, source.length);
+    length = source.length;
+    written = source.written;
+    markDirty();
+}
+
+// Function that moves the content into the storage of the selected backend replacing this one.
+// The target is created like a touched file, and emptied, so a physical file left at its name does not show through.
+void InlineStorage::promote(FileStorage& target) {
+    target.create();
+    target.truncate();
+    target.write(0, bytes, length);
+    length = 0;
+    dirtyStorages().erase(this);
+    ++promotions;
+}
+
+// Function that reads one character, 0 past the end.
+char InlineStorage::read(const size_t index) {
+    return index < length ? bytes[index] : 0;
+}
+
+// Function that writes one character, a gap after the content is zero filled.
+// FileValue promotes a content before it outgrows the limit, a write past the capacity is a bug of the caller.
+void InlineStorage::write(const size_t index, const char c) {
+    if (index >= capacity) {
+        throw FileSystemException("Inline content is full.");
+    }
+    if (index >= length) {
+        std::memset(bytes + length, 0, index - length);
+        length = index + 1;
+    }
+    bytes[index] = c;
+    markDirty();
+}
+
+// Function that copies a range into the buffer, returns how many bytes were copied.
+size_t InlineStorage::read(const size_t position, char* buffer, const size_t amount) {
+    if (position >= length) return 0;
+    const size_t count = std::min(amount, length - position);
+    std::memcpy(buffer, bytes + position, count);
+    return count;
+}
+
+// Function that writes a range, a gap after the content is zero filled.
+void InlineStorage::write(const size_t position, const char* data, const size_t amount) {
+    if (amount == 0) return;
+    if (position > capacity || amount > capacity - position) {
+        throw FileSystemException("Inline content is full.");
+    }
+    if (position > length) {
+        std::memset(bytes + length, 0, position - length);
+    }
+    std::memcpy(bytes + position, data, amount);
+    length = std::max(length, position + amount);
+    markDirty();
+}
+
+// Function that hands the whole content to the consumer as one block.
+void InlineStorage::forEachBlock(const BlockConsumer& consumer) {
+    if (length == 0) return;
+    consumer(bytes, length);
+}
+
+// Function that copies a content that fits inline from any storage, with one ranged read.
+// Returns false for a larger content, the caller promotes this storage first (see FileValue::reserve).
+bool InlineStorage::share(FileStorage& source) {
+    if (&source == this) return false;
+    const size_t amount = source.size();
+    if (amount > limit) return false;
+    length = source.read(0, bytes, amount);
+    markDirty();
+    return true;
+}
+
+// Function that takes over the content of another inline storage, which becomes empty.
+// A source already written back by sync keeps its physical file, the caller copies and removes it instead.
+bool InlineStorage::take(FileStorage& source) {
+    InlineStorage* other = dynamic_cast<InlineStorage*>(&source);
+    if (other == nullptr || other == this || other->written) return false;
+    std::memcpy(bytes, other->bytes, other->length);
+    length = other->length;
+    markDirty();
+    other->length = 0;
+    dirtyStorages().erase(other);
+    return true;
+}
+
+// Function that empties the content.
+void InlineStorage::truncate() {
+    length = 0;
+    markDirty();
+}
+
+// Function that drops the content without writing it, used when the file is removed.
+// A physical file written by sync is removed with it.
+void InlineStorage::discard() {
+    length = 0;
+    dirtyStorages().erase(this);
+    if (written) {
+        ::unlink(filename.c_str());
+        written = false;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef FIRSTPROJECT_INLINESTORAGE_H
+#define FIRSTPROJECT_INLINESTORAGE_H
+
+#include <string>
+#include <unordered_set>
+#include "FileStorage.h"
+
+/**
+ * InlineStorage keeps a small content inside the FileValue itself, like the short string optimization:
+ * touch, read, write and wc of a small file are memory accesses, without a heap storage, a handle or a system call.
+ * FileValue promotes the content into a storage of the selected backend once a write would make it larger
+ * than the limit ('--inline-size', at most 'capacity' bytes, 0 keeps every content in its backend).
+ * A promoted content stays in its backend, even if it becomes small again.
+ * The physical file is only written by 'sync', like the content of a memory storage, so a file that stays small
+ * never costs an inode. A physical file left by an earlier run is not read.
+ * **/
+class InlineStorage final : public FileStorage {
+public:
+    static constexpr size_t capacity = 256;    // Largest content kept inline.
+
+private:
+    char bytes[capacity];       //< The content.
+    size_t length;              //< Size of the content.
+    bool written;               //< True once 'sync' wrote the physical file.
+
+    static size_t limit;        //< Contents larger than this are promoted.
+    static size_t promotions;   //< Contents moved into their backend.
+
+    static std::unordered_set<InlineStorage*>& dirtyStorages();    // Contents not written back yet.
+
+    void markDirty();           // Registers this storage for the next write back.
+    void writeBack();           // Writes the content into the physical file.
+
+public:
+    explicit InlineStorage(std::string name): FileStorage(std::move(name)), bytes(), length(0), written(false) {}
+    ~InlineStorage() override;
+
+    static void setLimit(size_t bytes);     // Changes the limit, at most 'capacity'.
+    static size_t getLimit() { return limit; }
+    static size_t getPromotions() { return promotions; }
+    static void syncAll();                  // Writes back every content changed since the last sync.
+    static void expectDirty(size_t amount); // Makes room for 'amount' more contents to write back.
+
+    void assign(const InlineStorage& source);   // Becomes a copy of another inline storage.
+    void promote(FileStorage& target);          // Moves the content into the storage replacing this one.
+
+    char read(size_t index) override;
+    void write(size_t index, char c) override;
+    size_t read(size_t position, char* buffer, size_t amount) override;
+    void write(size_t position, const char* data, size_t amount) override;
+    void forEachBlock(const BlockConsumer& consumer) override;
+    size_t size() override { return length; }
+    bool share(FileStorage& source) override;
+    bool take(FileStorage& source) override;
+    bool isHostBacked() const override { return false; }       // The content lives in the FileValue.
+    bool hasHostFile() const override { return false; }
+
+    void create() override { markDirty(); }     // The physical file is created by the next sync.
+    void truncate() override;
+    void flush() override {}            // Only 'sync' writes the physical file.
+    void close() override {}            // Holds no handle.
+    void discard() override;
+};
+
+#endif //FIRSTPROJECT_INLINESTORAGE_H
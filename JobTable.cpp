@@ -0,0 +1,81 @@
+#include "JobTable.h"
+
+// Function that adds a background copy, the paths of its files are kept to find the commands it conflicts with.
+size_t JobTable::add(std::string command, const AsyncIO::Ticket ticket, const Directory* source,
+                     const Directory* target, std::string sourceFile, std::string targetFile) {
+    jobs.push_back(Job{++lastId, std::move(command), ticket, {source, target},
+                       {std::move(sourceFile), std::move(targetFile)}});
+    return lastId;
+}
+
+// Function that waits for a job, prints its error (after the pending output) if it failed, and drops it.
+void JobTable::finish(const size_t index, OutputBuffer& output) {
+    std::string error;
+    if (!AsyncIO::instance().wait(jobs[index].ticket, error)) {
+        output.error((jobs[index].command + ": " + error).c_str());
+    }
+    jobs.erase(jobs.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+// Function that waits for every job whose source or target File is inside a directory.
+void JobTable::waitFor(const Directory* directory, OutputBuffer& output) {
+    for (size_t i = 0; i < jobs.size();) {
+        if (jobs[i].directories[0] == directory || jobs[i].directories[1] == directory) {
+            finish(i, output);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Function that waits for every job reading or writing a physical file.
+void JobTable::waitFor(const std::string_view physicalFile, OutputBuffer& output) {
+    for (size_t i = 0; i < jobs.size();) {
+        if (jobs[i].files[0] == physicalFile || jobs[i].files[1] == physicalFile) {
+            finish(i, output);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Function that waits for the job with a number.
+bool JobTable::wait(const size_t id, OutputBuffer& output) {
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].id == id) {
+            finish(i, output);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function that waits for every job, in the order they started.
+void JobTable::waitAll(OutputBuffer& output) {
+    while (!jobs.empty()) {
+        finish(0, output);
+    }
+}
+
+// Function that prints one line for every job: running ones with the bytes copied so far,
+// finished ones as done (or failed, with the error), and forgets the finished ones.
+void JobTable::list(OutputBuffer& output) {
+    AsyncIO& engine = AsyncIO::instance();
+    for (size_t i = 0; i < jobs.size();) {
+        const Job& job = jobs[i];
+        const AsyncIO::Progress progress = engine.poll(job.ticket);
+        output << '[' << job.id << "] ";
+        if (!progress.done) {
+            output << "Running " << job.command << ' ' << progress.copied << '/' << progress.size << " bytes\n";
+            i++;
+            continue;
+        }
+        std::string error;
+        if (engine.wait(job.ticket, error)) {
+            output << "Done " << job.command << '\n';
+        } else {
+            output << "Failed " << job.command << ": " << error << '\n';
+        }
+        jobs.erase(jobs.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+}
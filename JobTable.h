@@ -0,0 +1,52 @@
+#ifndef FIRSTPROJECT_JOBTABLE_H
+#define FIRSTPROJECT_JOBTABLE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AsyncIO.h"
+#include "OutputBuffer.h"
+
+class Directory;    // Forward declaration to eliminate circular including.
+
+/**
+ * JobTable keeps the copies a terminal runs in the background (see AsyncIO), so the terminal takes the next
+ * commands while a large copy goes on. A job knows the Directories of its source and target Files (nullptr for
+ * a file outside the tree), and their physical files. Before a command runs, it waits for the jobs it could disturb
+ * (see dispatchCommand): a command that runs alone waits for every job, a command using the directory of a job,
+ * or naming one of its physical files, waits for that job, 'ls', 'pwd' and commands on other directories run at once.
+ * The error of a failed job is printed once the job is waited for, the target keeps what was copied.
+ * **/
+class JobTable {
+    struct Job {
+        size_t id;                          //< Number shown by 'jobs' and taken by 'wait'.
+        std::string command;                //< 'copy SOURCE TARGET', as listed by 'jobs'.
+        AsyncIO::Ticket ticket;             //< The copy running in AsyncIO.
+        const Directory* directories[2];    //< Directories of the source and the target, nullptr outside the tree.
+        std::string files[2];               //< Physical files of the source and the target.
+    };
+
+    std::vector<Job> jobs;                  //< Jobs not waited for, in the order they started.
+    size_t lastId = 0;
+
+    void finish(size_t index, OutputBuffer& output);    // Waits for a job, prints its error, and drops it.
+
+public:
+    JobTable() = default;
+    JobTable(const JobTable&) = delete;
+    JobTable& operator=(const JobTable&) = delete;
+
+    // Adds a copy started in the background, returns its job number.
+    size_t add(std::string command, AsyncIO::Ticket ticket, const Directory* source, const Directory* target,
+               std::string sourceFile, std::string targetFile);
+    bool empty() const { return jobs.empty(); }
+
+    void waitFor(const Directory* directory, OutputBuffer& output);     // Waits for the jobs using a directory.
+    void waitFor(std::string_view physicalFile, OutputBuffer& output); // Waits for the jobs using a physical file.
+    bool wait(size_t id, OutputBuffer& output);                         // Waits for one job, false if there is none.
+    void waitAll(OutputBuffer& output);                                 // Waits for every job.
+    void list(OutputBuffer& output);                                    // Prints every job, drops the finished ones.
+};
+
+#endif //FIRSTPROJECT_JOBTABLE_H
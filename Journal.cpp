@@ -0,0 +1,233 @@
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Journal.h"
+#include "FileSystemException.h"
+
+constexpr char Journal::magic[8];
+unsigned Journal::interval = 10;
+
+namespace {
+
+// Header of every record, followed by the command.
+struct RecordHeader {
+    std::uint32_t length;       //< Bytes of the command.
+    std::uint32_t checksum;     //< FNV-1a of the command, a torn record does not match it.
+};
+
+constexpr size_t batch_limit = 1 << 20;     // Pending bytes that wake up the committer before its interval.
+
+// FNV-1a hash of a record, seeded with its length.
+std::uint32_t checksum(const char* data, const size_t length) {
+    std::uint32_t hash = 2166136261u ^ static_cast<std::uint32_t>(length);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Writes bytes at the current position of a descriptor, retrying short writes.
+bool writeAll(const int descriptor, const char* data, size_t length) {
+    while (length > 0) {
+        const ssize_t count = ::write(descriptor, data, length);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        data += count;
+        length -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+}
+
+Journal::Journal()
+    : descriptor(-1), active(false), appended(0), durable(0), committing(false), failed(false), stopping(false),
+      records(0), commits(0), bytes(0) {}
+
+// Destructor, stops the committer and makes what is left durable.
+Journal::~Journal() {
+    if (descriptor < 0) return;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (committer.joinable()) {
+        committer.join();
+    }
+    try {
+        commit();
+    } catch (...) {
+    }
+    ::close(descriptor);
+}
+
+// Function that returns the single journal of the process.
+Journal& Journal::instance() {
+    static Journal journal;
+    return journal;
+}
+
+// Function that changes the commit interval, used by '--commit-interval' before the journal is opened.
+void Journal::setInterval(const unsigned milliseconds) {
+    interval = milliseconds;
+}
+
+// Function that opens the journal and replays it. A new journal starts with the magic.
+// Records are replayed until the end, or until the first torn record, which is cut off with what follows it.
+void Journal::open(const std::string& journalPath, const std::function<void(std::string_view)>& replay) {
+    path = journalPath;
+    descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to open the journal.");
+    }
+    struct stat status {};
+    if (::fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        descriptor = -1;
+        throw FileSystemException("Failed to open the journal.");
+    }
+    std::string content(static_cast<size_t>(status.st_size), '\0');
+    size_t total = 0;
+    while (total < content.size()) {
+        const ssize_t count = ::read(descriptor, &content[total], content.size() - total);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        total += static_cast<size_t>(count);
+    }
+    content.resize(total);
+    if (content.empty()) {
+        if (!writeAll(descriptor, magic, sizeof(magic)) || ::fdatasync(descriptor) != 0) {
+            ::close(descriptor);
+            descriptor = -1;
+            throw FileSystemException("Failed to write the journal.");
+        }
+    } else if (content.size() < sizeof(magic) || std::memcmp(content.data(), magic, sizeof(magic)) != 0) {
+        ::close(descriptor);
+        descriptor = -1;
+        throw FileSystemException("Not a journal.");
+    }
+
+    size_t offset = sizeof(magic);
+    while (content.size() - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, content.data() + offset, sizeof(header));
+        const size_t start = offset + sizeof(header);
+        if (header.length > content.size() - start || checksum(content.data() + start, header.length) != header.checksum) {
+            break;
+        }
+        replay(std::string_view(content.data() + start, header.length));
+        offset = start + header.length;
+    }
+    if ((offset < content.size() && ::ftruncate(descriptor, static_cast<off_t>(offset)) != 0) ||
+        ::lseek(descriptor, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        ::close(descriptor);
+        descriptor = -1;
+        throw FileSystemException("Failed to repair the journal.");
+    }
+    active = true;
+    if (interval > 0) {
+        committer = std::thread(&Journal::runCommitter, this);
+    }
+}
+
+// Function that appends a command to the pending batch, it is written by the next commit.
+std::uint64_t Journal::append(const std::string_view command) {
+    const RecordHeader header{static_cast<std::uint32_t>(command.length()), checksum(command.data(), command.length())};
+    std::unique_lock<std::mutex> lock(mutex);
+    if (failed) {
+        throw FileSystemException("Failed to write the journal.");
+    }
+    pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    pending.append(command.data(), command.length());
+    ++records;
+    if (interval > 0 && pending.size() >= batch_limit) {
+        wake.notify_one();
+    }
+    return ++appended;
+}
+
+// Function that writes the pending batch and syncs it, without holding the lock meanwhile,
+// so other threads keep appending to the next batch.
+void Journal::commitPending(std::unique_lock<std::mutex>& lock) {
+    committing = true;
+    std::string batch;
+    batch.swap(pending);
+    const std::uint64_t last = appended;
+    lock.unlock();
+    const bool written = writeAll(descriptor, batch.data(), batch.size()) && ::fdatasync(descriptor) == 0;
+    lock.lock();
+    committing = false;
+    if (written) {
+        durable = last;
+        ++commits;
+        bytes += batch.size();
+    } else {
+        failed = true;
+    }
+    committed.notify_all();
+}
+
+// Function that waits until a record is durable, with interval 0 only.
+// The first thread to wait commits every pending record, the threads waiting meanwhile are served by it
+// (or by the next batch), so concurrent commands share one fdatasync.
+void Journal::waitDurable(const std::uint64_t sequence) {
+    if (interval > 0) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (durable < sequence) {
+        if (failed) {
+            throw FileSystemException("Failed to write the journal.");
+        }
+        if (committing) {
+            committed.wait(lock);
+        } else {
+            commitPending(lock);
+        }
+    }
+}
+
+// Function that makes every appended record durable, used by 'sync' and before the journal is emptied.
+void Journal::commit() {
+    if (descriptor < 0) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    const std::uint64_t last = appended;
+    while (durable < last) {
+        if (failed) {
+            throw FileSystemException("Failed to write the journal.");
+        }
+        if (committing) {
+            committed.wait(lock);
+        } else {
+            commitPending(lock);
+        }
+    }
+}
+
+// Function that empties the journal (keeping the magic), used once the tree was removed at exit.
+void Journal::reset() {
+    if (!active) return;
+    commit();
+    std::unique_lock<std::mutex> lock(mutex);
+    committed.wait(lock, [this] { return !committing; });
+    if (::ftruncate(descriptor, static_cast<off_t>(sizeof(magic))) != 0 ||
+        ::lseek(descriptor, static_cast<off_t>(sizeof(magic)), SEEK_SET) < 0 || ::fdatasync(descriptor) != 0) {
+        throw FileSystemException("Failed to empty the journal.");
+    }
+}
+
+// Function that commits the pending records every interval, or as soon as a large batch piled up.
+void Journal::runCommitter() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(interval), [this] {
+            return stopping || pending.size() >= batch_limit;
+        });
+        if (!pending.empty() && !committing && !failed) {
+            commitPending(lock);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef FIRSTPROJECT_JOURNAL_H
+#define FIRSTPROJECT_JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * Journal is an append-only log of every command that changes the tree (write, touch, copy, move, remove,
+ * mkdir, rmdir, ln, load, and read, which may extend the count), so a crashed terminal or daemon rebuilds
+ * its tree at the next start ('--journal FILE') by replaying the commands, instead of losing it.
+ * A command is appended before it runs, in the order the commands change the tree, and is answered once
+ * its record is durable. Records are written and made durable (fdatasync) in batches, group commit:
+ *  - commit interval 0: a command waits for its record, the first waiting thread writes every pending
+ *    record with one fdatasync, the others (sessions of a daemon, workers of a parallel script) share it;
+ *  - commit interval N ms (default 10): a background thread commits every N ms, commands never wait,
+ *    and a crash loses at most the last N ms.
+ * Replay rebuilds the tree only from the journal: a physical file left by the crashed run is removed right before
+ * the record that created it runs again, host files no record creates are never touched.
+ * Every record carries its length and a checksum, a record torn by the crash ends the journal.
+ * 'exit' (and the shutdown of a daemon) removes the tree on purpose, so it empties the journal.
+ * **/
+class Journal {
+    static constexpr char magic[8] = {'V', 'F', 'S', 'J', 'R', 'N', 'L', '1'};
+
+    std::string path;                       //< Physical file of the journal.
+    int descriptor;                         //< Open journal, -1 while journaling is off.
+    bool active;                            //< True once the journal was replayed, commands are appended.
+    std::mutex mutex;                       //< Guards everything below.
+    std::condition_variable committed;      //< Signaled after every commit.
+    std::condition_variable wake;           //< Wakes up the committer thread.
+    std::string pending;                    //< Records appended and not written yet.
+    std::uint64_t appended;                 //< Sequence number of the last appended record.
+    std::uint64_t durable;                  //< Sequence number of the last durable record.
+    bool committing;                        //< True while a thread writes a batch.
+    bool failed;                            //< Set once writing the journal failed, every later command fails.
+    bool stopping;                          //< Stops the committer thread.
+    std::thread committer;                  //< Commits every interval (interval > 0).
+    size_t records;                         //< Records appended since start.
+    size_t commits;                         //< Batches made durable (fdatasync calls).
+    std::uint64_t bytes;                    //< Bytes written into the journal since start.
+
+    static unsigned interval;               //< Commit interval in milliseconds, 0 commits before answering.
+
+    Journal();
+    ~Journal();
+    void commitPending(std::unique_lock<std::mutex>& lock);    // Writes and syncs a batch, lock held on return.
+    void runCommitter();                                        // Main loop of the committer thread.
+
+public:
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    static Journal& instance();                 // Returns the process-wide journal.
+    static void setInterval(unsigned milliseconds);     // Changes the commit interval, before open().
+    static unsigned getInterval() { return interval; }
+
+    // Opens (or creates) the journal, calls 'replay' with every command it holds, in order,
+    // and from then on appends commands. Throws FileSystemException.
+    void open(const std::string& journalPath, const std::function<void(std::string_view)>& replay);
+    bool isActive() const { return active; }
+    std::uint64_t append(std::string_view command);    // Appends a command, returns its sequence number.
+    void waitDurable(std::uint64_t sequence);           // Returns once the record is durable (interval 0).
+    void commit();                                      // Makes every appended record durable.
+    void reset();                                       // Empties the journal, the tree was removed on purpose.
+
+    size_t getRecords() const { return records; }
+    size_t getCommits() const { return commits; }
+    std::uint64_t getBytes() const { return bytes; }
+    const std::string& getPath() const { return path; }
+};
+
+#endif //FIRSTPROJECT_JOURNAL_H
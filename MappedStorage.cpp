@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MappedStorage.h"
+#include "FileSystemException.h"
+
+constexpr size_t MappedStorage::grow_step;
+
+// Function that rounds a size up to a whole amount of grow steps (at least one step).
+static size_t roundToStep(const size_t size) {
+    return size == 0 ? MappedStorage::grow_step : (size + MappedStorage::grow_step - 1) / MappedStorage::grow_step * MappedStorage::grow_step;
+}
+
+// Destructor, cuts the physical file to its content size and unmaps it.
+MappedStorage::~MappedStorage() {
+    close();
+}
+
+// Function that opens the physical file and maps it, returns false if it is missing and may not be created.
+// Writes create a missing file, reads (create = false) never do: a missing physical file reads as empty.
+// The mapping is registered in FileHandleCache, which may close the least recently used file.
+bool MappedStorage::open(const bool create) {
+    if (reuse()) return true;
+
+    descriptor = ::open(filename.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (descriptor < 0) {
+        if (!create && errno == ENOENT) return false;
+        throw FileSystemException("Failed to open the file.");
+    }
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        descriptor = -1;
+        throw FileSystemException("Failed to read the file size.");
+    }
+    length = static_cast<size_t>(status.st_size);
+    capacity = length;
+    mappedLength = roundToStep(length);
+    void* mapping = mmap(nullptr, mappedLength, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(descriptor);
+        descriptor = -1;
+        throw FileSystemException("Failed to map the file.");
+    }
+    data = static_cast<char*>(mapping);
+    admit();
+    return true;
+}
+
+// Function that extends the physical file so the first 'needed' bytes can be written.
+// The file at least doubles, and the mapping is only replaced when the file outgrows it.
+void MappedStorage::reserve(const size_t needed) {
+    open();
+    if (needed <= capacity) return;
+
+    const size_t newCapacity = roundToStep(std::max(needed, capacity * 2));
+    if (ftruncate(descriptor, static_cast<off_t>(newCapacity)) != 0) {
+        throw FileSystemException("Failed to extend the file.");
+    }
+    if (newCapacity > mappedLength) {
+        void* mapping = mremap(data, mappedLength, newCapacity, MREMAP_MAYMOVE);
+        if (mapping == MAP_FAILED) {
+            throw FileSystemException("Failed to remap the file.");
+        }
+        data = static_cast<char*>(mapping);
+        mappedLength = newCapacity;
+    }
+    capacity = newCapacity;
+}
+
+// Function that reads one character from the mapping.
+char MappedStorage::read(const size_t index) {
+    if (!open(false)) return 0;
+    return index < length ? data[index] : 0;
+}
+
+// Function that writes one character into the mapping, growing the file if needed.
+void MappedStorage::write(const size_t index, const char c) {
+    reserve(index + 1);
+    data[index] = c;
+    length = std::max(length, index + 1);
+}
+
+// Function that copies a range out of the mapping, returns the amount of bytes read.
+size_t MappedStorage::read(const size_t position, char* buffer, const size_t amount) {
+    if (!open(false)) return 0;
+    if (position >= length) return 0;
+    const size_t available = std::min(amount, length - position);
+    std::memcpy(buffer, data + position, available);
+    return available;
+}
+
+// Function that copies a range into the mapping, growing the file if needed.
+void MappedStorage::write(const size_t position, const char* source, const size_t amount) {
+    if (amount == 0) return;
+    reserve(position + amount);
+    std::memcpy(data + position, source, amount);
+    length = std::max(length, position + amount);
+}
+
+// Function that hands the whole mapped content to the consumer as a single block.
+void MappedStorage::forEachBlock(const BlockConsumer& consumer) {
+    if (!open(false)) return;
+    const Pin pin(*this);
+    if (length > 0) {
+        consumer(data, length);
+    }
+}
+
+// Function that returns the size of the content.
+size_t MappedStorage::size() {
+    if (!open(false)) return 0;
+    return length;
+}
+
+// Function that creates the physical file by mapping it.
+void MappedStorage::create() {
+    open();
+}
+
+// Function that empties the content, the space is reserved again on the next write.
+void MappedStorage::truncate() {
+    open();
+    if (ftruncate(descriptor, 0) != 0) {
+        throw FileSystemException("Failed to truncate the file.");
+    }
+    length = 0;
+    capacity = 0;
+}
+
+// Function that cuts the physical file back to the content size, so other readers see exact content.
+void MappedStorage::flush() {
+    if (descriptor < 0 || capacity == length) return;
+    if (ftruncate(descriptor, static_cast<off_t>(length)) != 0) {
+        throw FileSystemException("Failed to resize the file.");
+    }
+    capacity = length;
+}
+
+// Function that flushes the content size, unmaps the file and removes it from FileHandleCache.
+void MappedStorage::close() {
+    if (descriptor >= 0 && capacity != length) {
+        ftruncate(descriptor, static_cast<off_t>(length));
+    }
+    unmap();
+}
+
+// Function that unmaps the file without resizing it, used before the physical file is removed.
+void MappedStorage::discard() {
+    unmap();
+}
+
+// Function that removes the mapping, closes the descriptor, and releases the cache slot.
+void MappedStorage::unmap() {
+    forget();
+    if (data) {
+        munmap(data, mappedLength);
+        data = nullptr;
+    }
+    if (descriptor >= 0) {
+        ::close(descriptor);
+        descriptor = -1;
+    }
+    mappedLength = capacity = length = 0;
+}
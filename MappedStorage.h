@@ -0,0 +1,45 @@
+#ifndef FIRSTPROJECT_MAPPEDSTORAGE_H
+#define FIRSTPROJECT_MAPPEDSTORAGE_H
+
+#include "FileStorage.h"
+
+/**
+ * MappedStorage is a FileStorage backend that maps the physical file into memory with mmap.
+ * Character access, ranged access, cat and wc become plain memory accesses.
+ * While the file grows, the physical file is extended (and remapped when needed) in large steps,
+ * so appending one character at a time does not remap every time.
+ * The extra space is cut off when the storage is flushed or closed.
+ * **/
+class MappedStorage final : public FileStorage {
+    int descriptor;         //< Open file descriptor, -1 when closed.
+    char* data;             //< Start of the mapping, nullptr when closed.
+    size_t mappedLength;    //< Length of the mapping.
+    size_t capacity;        //< Size of the physical file, writes below it need no resize.
+    size_t length;          //< Size of the content.
+
+    bool open(bool create = true);      // Opens and maps the file, if it is not mapped already.
+    void reserve(size_t needed);        // Makes sure the first 'needed' bytes are writable.
+    void unmap();                       // Removes the mapping and closes the descriptor.
+
+public:
+    static constexpr size_t grow_step = 64 * 1024;      // Minimal step the physical file grows in.
+
+    explicit MappedStorage(std::string name)
+        : FileStorage(std::move(name)), descriptor(-1), data(nullptr), mappedLength(0), capacity(0), length(0) {}
+    ~MappedStorage() override;
+
+    char read(size_t index) override;
+    void write(size_t index, char c) override;
+    size_t read(size_t position, char* buffer, size_t length) override;
+    void write(size_t position, const char* data, size_t length) override;
+    void forEachBlock(const BlockConsumer& consumer) override;
+    size_t size() override;
+
+    void create() override;
+    void truncate() override;
+    void flush() override;
+    void close() override;
+    void discard() override;
+};
+
+#endif //FIRSTPROJECT_MAPPEDSTORAGE_H
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MemoryStorage.h"
+#include "FileSystemException.h"
+
+size_t MemoryStorage::shares = 0;
+size_t MemoryStorage::detaches = 0;
+
+// Function that returns the set of storages whose content is newer than their physical file.
+std::unordered_set<MemoryStorage*>& MemoryStorage::dirtyStorages() {
+    static std::unordered_set<MemoryStorage*> dirty;
+    return dirty;
+}
+
+// Destructor, writes back the content if it was changed.
+// A destructor must not throw, a failed write back is reported to stderr instead (the content is lost).
+MemoryStorage::~MemoryStorage() {
+    try {
+        flush();
+    } catch (std::exception& e) {
+        std::fprintf(stderr, "ERROR: %s\n", e.what());
+    }
+}
+
+// Function that writes back every changed storage, used by 'sync'.
+void MemoryStorage::syncAll() {
+    std::unordered_set<MemoryStorage*> dirty;
+    dirty.swap(dirtyStorages());
+    for (MemoryStorage* storage : dirty) {
+        dirtyStorages().insert(storage);    // flush() removes it again once written.
+        storage->flush();
+    }
+}
+
+// Function that reads the physical file into a new buffer the first time the content is needed.
+// A missing physical file is an empty file.
+MemoryStorage::Content& MemoryStorage::load() {
+    if (loaded) return *content;
+
+    content = new Content();
+    const int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor >= 0) {
+        struct stat status{};
+        if (fstat(descriptor, &status) == 0) {
+            content->bytes.resize(static_cast<size_t>(status.st_size));
+        }
+        size_t total = 0;
+        while (total < content->bytes.size()) {
+            const ssize_t count = ::read(descriptor, &content->bytes[total], content->bytes.size() - total);
+            if (count <= 0) break;
+            total += static_cast<size_t>(count);
+        }
+        content->bytes.resize(total);
+        ::close(descriptor);
+    }
+    loaded = true;
+    return *content;
+}
+
+// Function that makes the buffer private to this storage before it is written.
+// This is the copy-on-write step: a buffer shared with other storages is copied once, here.
+MemoryStorage::Content& MemoryStorage::modify() {
+    load();
+    if (content->isShared()) {
+        content = new Content(*content);
+        ++detaches;
+    }
+    markDirty();
+    return *content;
+}
+
+// Function that registers this storage for the next write back.
+void MemoryStorage::markDirty() {
+    dirtyStorages().insert(this);
+}
+
+// Function that reads one character from memory.
+char MemoryStorage::read(const size_t index) {
+    const std::string& bytes = load().bytes;
+    return index < bytes.size() ? bytes[index] : 0;
+}
+
+// Function that writes one character into memory, growing the content if needed.
+void MemoryStorage::write(const size_t index, const char c) {
+    std::string& bytes = modify().bytes;
+    if (index >= bytes.size()) {
+        bytes.resize(index + 1, '\0');
+    }
+    bytes[index] = c;
+}
+
+// Function that copies a range of the content into the buffer, returns how many bytes were copied.
+size_t MemoryStorage::read(const size_t position, char* buffer, const size_t length) {
+    const std::string& bytes = load().bytes;
+    if (position >= bytes.size()) return 0;
+    const size_t count = std::min(length, bytes.size() - position);
+    std::memcpy(buffer, bytes.data() + position, count);
+    return count;
+}
+
+// Function that writes a range into memory, growing the content if needed.
+void MemoryStorage::write(const size_t position, const char* data, const size_t length) {
+    if (length == 0) return;
+    std::string& bytes = modify().bytes;
+    if (position + length > bytes.size()) {
+        bytes.resize(position + length, '\0');
+    }
+    std::memcpy(&bytes[position], data, length);
+}
+
+// Function that hands the whole content to the consumer as one block.
+// The extra reference keeps the block unchanged even if the consumer writes into this storage.
+void MemoryStorage::forEachBlock(const BlockConsumer& consumer) {
+    Content& current = load();
+    if (current.bytes.empty()) return;
+    const RCPtr<Content> reading(&current);
+    consumer(current.bytes.data(), current.bytes.size());
+}
+
+// Function that returns the content size.
+size_t MemoryStorage::size() {
+    return load().bytes.size();
+}
+
+// Function that makes this storage share the buffer of another MemoryStorage, without copying a byte.
+// Returns false if the source keeps its content elsewhere, then the caller copies block by block.
+bool MemoryStorage::share(FileStorage& source) {
+    MemoryStorage* other = dynamic_cast<MemoryStorage*>(&source);
+    if (other == nullptr || other == this) return false;
+    content = RCPtr<Content>(&other->load());
+    loaded = true;
+    markDirty();
+    ++shares;
+    return true;
+}
+
+// Function that creates the physical file if it does not exist.
+void MemoryStorage::create() {
+    const int descriptor = ::open(filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to open the file.");
+    }
+    ::close(descriptor);
+}
+
+// Function that replaces the content with an empty buffer, other storages sharing the old buffer keep it.
+void MemoryStorage::truncate() {
+    content = new Content();
+    loaded = true;
+    markDirty();
+}
+
+// Function that writes the content back into the physical file, if it was changed.
+void MemoryStorage::flush() {
+    auto& dirty = dirtyStorages();
+    if (dirty.erase(this) == 0) return;
+
+    const int descriptor = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to open the file.");
+    }
+    const std::string& bytes = content->bytes;
+    size_t total = 0;
+    while (total < bytes.size()) {
+        const ssize_t count = ::write(descriptor, bytes.data() + total, bytes.size() - total);
+        if (count <= 0) break;
+        total += static_cast<size_t>(count);
+    }
+    ::close(descriptor);
+    if (total < bytes.size()) {
+        throw FileSystemException("Failed to write the file.");
+    }
+}
+
+// Function that writes back the content, and releases this storage's reference to the buffer.
+void MemoryStorage::close() {
+    flush();
+    content = nullptr;
+    loaded = false;
+}
+
+// Function that drops the content without writing it, used before the physical file is removed.
+void MemoryStorage::discard() {
+    dirtyStorages().erase(this);
+    content = nullptr;
+    loaded = false;
+}
@@ -0,0 +1,60 @@
+#ifndef FIRSTPROJECT_MEMORYSTORAGE_H
+#define FIRSTPROJECT_MEMORYSTORAGE_H
+
+#include <string>
+#include <unordered_set>
+#include "FileStorage.h"
+#include "RCObject.h"
+#include "RCPtr.h"
+
+/**
+ * MemoryStorage is a FileStorage backend that keeps the whole content in RAM.
+ * The content is a reference counted buffer: copy makes the target share the buffer of the source in O(1),
+ * and the first write to either side (through CharProxy, writeRange or truncate) copies the buffer,
+ * so the two files only pay for the copy once they diverge.
+ * The physical file is read on first access, and written back when the storage is flushed, closed,
+ * destroyed, or on 'sync'. Memory storages are not bounded by FileHandleCache, they hold no system handle.
+ * **/
+class MemoryStorage final : public FileStorage {
+    // Content of a file, shared by every MemoryStorage copied from it until one of them writes.
+    struct Content : public RCObject {
+        std::string bytes;
+    };
+
+    RCPtr<Content> content;     //< Shared content, nullptr until the physical file is loaded.
+    bool loaded;                //< True once the content was read from the physical file.
+
+    static size_t shares;       //< Copies served by sharing a buffer.
+    static size_t detaches;     //< Buffers copied because a shared buffer was written.
+
+    static std::unordered_set<MemoryStorage*>& dirtyStorages();    // Storages not written back yet.
+
+    Content& load();            // Reads the physical file into memory, if it was not read already.
+    Content& modify();          // Returns a buffer owned by this storage alone, ready for writing.
+    void markDirty();           // Registers this storage for the next write back.
+
+public:
+    explicit MemoryStorage(std::string name): FileStorage(std::move(name)), content(nullptr), loaded(false) {}
+    ~MemoryStorage() override;
+
+    static void syncAll();      // Writes back every storage with unsaved content.
+    static size_t getShares() { return shares; }
+    static size_t getDetaches() { return detaches; }
+
+    char read(size_t index) override;
+    void write(size_t index, char c) override;
+    size_t read(size_t position, char* buffer, size_t length) override;
+    void write(size_t position, const char* data, size_t length) override;
+    void forEachBlock(const BlockConsumer& consumer) override;
+    size_t size() override;
+    bool share(FileStorage& source) override;
+    bool isHostBacked() const override { return false; }       // The content lives in RAM, the physical file may be stale.
+
+    void create() override;
+    void truncate() override;
+    void flush() override;
+    void close() override;
+    void discard() override;
+};
+
+#endif //FIRSTPROJECT_MEMORYSTORAGE_H
@@ -0,0 +1,44 @@
+#include <mutex>
+#include "NameTable.h"
+
+constexpr size_t NameTable::first_chunk;
+constexpr size_t NameTable::chunk_count;
+constexpr NameId NameTable::none;
+
+// Function that returns the single table shared by every Directory and File.
+NameTable& NameTable::instance() {
+    static NameTable table;
+    return table;
+}
+
+// Function that returns the id of a name, a new name gets the next free id.
+// A known name only takes the shared lock, and is not copied.
+NameId NameTable::intern(const std::string_view name) {
+    {
+        const std::shared_lock<std::shared_mutex> reading(mutex);
+        const auto found = ids.find(name);
+        if (found != ids.end()) return found->second;
+    }
+    const std::unique_lock<std::shared_mutex> writing(mutex);
+    const auto found = ids.find(name);          // Another thread may have added it in between.
+    if (found != ids.end()) return found->second;
+    const NameId id = count.load(std::memory_order_relaxed);
+    const std::string& stored = names.emplace_back(name);
+    ids.emplace(stored, id);
+    size_t offset;
+    const size_t chunk = chunkOf(id, offset);
+    if (!chunks[chunk]) {
+        chunks[chunk].reset(new const std::string*[first_chunk << chunk]);
+    }
+    chunks[chunk][offset] = &stored;
+    count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+// Function that returns the id of a name without adding it.
+// A name that was never interned cannot belong to any node, so lookups can stop right away.
+NameId NameTable::find(const std::string_view name) const {
+    const std::shared_lock<std::shared_mutex> reading(mutex);
+    const auto found = ids.find(name);
+    return found == ids.end() ? none : found->second;
+}
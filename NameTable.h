@@ -0,0 +1,60 @@
+#ifndef FIRSTPROJECT_NAMETABLE_H
+#define FIRSTPROJECT_NAMETABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using NameId = std::uint32_t;   // Id of an interned name, equal ids mean equal names.
+
+/**
+ * NameTable interns the names of directories and files.
+ * Every distinct name is stored once, nodes of the tree hold its NameId instead of a string,
+ * so the name indexes of a Directory hash and compare plain integers.
+ * The table is process-wide, and names are never released (there are far less distinct names than nodes).
+ * The map is keyed by views into the stored names, so a name is looked up straight from the path it is part of.
+ * Commands of a parallel script intern names from several threads: the name -> id map is guarded by a
+ * shared mutex, while id -> name is kept in chunks that never move, so name() reads without locking.
+ * **/
+class NameTable {
+    static constexpr size_t first_chunk = 64;       // Size of the first chunk, every next chunk is twice as large.
+    static constexpr size_t chunk_count = 27;       // Enough chunks for every NameId.
+
+    std::deque<std::string> names;                                  //< Every interned name, never moved once added.
+    std::unordered_map<std::string_view, NameId> ids;               //< Name -> id, the keys view into 'names'.
+    std::unique_ptr<const std::string*[]> chunks[chunk_count];      //< Id -> name, points into 'names'.
+    std::atomic<NameId> count;                                      //< Amount of interned names.
+    mutable std::shared_mutex mutex;                                //< Guards 'names', 'ids' and the creation of chunks.
+
+    NameTable(): count(0) {}
+    // Returns the chunk holding an id, and the position of the id inside it.
+    static size_t chunkOf(NameId id, size_t& offset) {
+        const size_t slot = id / first_chunk + 1;
+        const size_t chunk = 63 - static_cast<size_t>(__builtin_clzll(slot));
+        offset = id - first_chunk * ((size_t(1) << chunk) - 1);
+        return chunk;
+    }
+
+public:
+    static constexpr NameId none = UINT32_MAX;      // Returned by find() for a name that was never interned.
+
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    static NameTable& instance();                   // Returns the process-wide table.
+    NameId intern(std::string_view name);           // Returns the id of a name, adds it if needed.
+    NameId find(std::string_view name) const;       // Returns the id of a name, 'none' if it was never interned.
+    const std::string& name(const NameId id) const {
+        size_t offset;
+        const size_t chunk = chunkOf(id, offset);
+        return *chunks[chunk][offset];
+    }
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+};
+
+#endif //FIRSTPROJECT_NAMETABLE_H
@@ -0,0 +1,96 @@
+#ifndef FIRSTPROJECT_NODEPOOL_H
+#define FIRSTPROJECT_NODEPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * NodePool is an arena for objects of type T.
+ * Objects are constructed inside large chunks which are never moved or freed while the pool lives,
+ * so every object keeps a stable address. Destroyed slots are kept on a free list and reused.
+ * Creating and destroying an object are O(1), and never copy or move other objects.
+ * Only the free list is guarded by a mutex, objects are constructed and destructed outside of it,
+ * so a destructor may destroy other objects of the same pool.
+ * **/
+template<class T>
+class NodePool {
+    union Slot {
+        Slot* next;                                         //< Next free slot, while the slot is free.
+        alignas(T) unsigned char object[sizeof(T)];         //< Storage of the object, while the slot is used.
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;    //< Every chunk allocated so far.
+    Slot* freeList;                                 //< First free slot, nullptr if every slot is used.
+    size_t live;                                    //< Amount of objects currently constructed.
+    std::mutex mutex;                               //< Guards the members above.
+
+    void grow();                                    // Allocates a new chunk and puts its slots on the free list.
+
+public:
+    static constexpr size_t chunk_size = 1024;      // Amount of slots allocated at once.
+
+    NodePool(): freeList(nullptr), live(0) {}
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    template<class... Args>
+    T* create(Args&&... args);                      // Constructs a new object inside a free slot.
+    void destroy(T* object);                        // Destructs an object and returns its slot to the free list.
+
+    size_t size() const { return live; }
+    size_t capacity() const { return chunks.size() * chunk_size; }
+};
+
+template<class T>
+constexpr size_t NodePool<T>::chunk_size;
+
+template<class T>
+void NodePool<T>::grow() {
+    chunks.emplace_back(new Slot[chunk_size]);
+    Slot* chunk = chunks.back().get();
+    for (size_t i = 0; i < chunk_size; i++) {
+        chunk[i].next = i + 1 < chunk_size ? &chunk[i + 1] : freeList;
+    }
+    freeList = chunk;
+}
+
+template<class T>
+template<class... Args>
+T* NodePool<T>::create(Args&&... args) {
+    Slot* slot;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (freeList == nullptr) {
+            grow();
+        }
+        slot = freeList;
+        freeList = slot->next;
+        ++live;
+    }
+    try {
+        return new (slot->object) T(std::forward<Args>(args)...);
+    } catch (...) {                                 // Return the slot if the constructor throws.
+        const std::lock_guard<std::mutex> lock(mutex);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+        throw;
+    }
+}
+
+template<class T>
+void NodePool<T>::destroy(T* object) {
+    if (object == nullptr) return;
+    object->~T();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    const std::lock_guard<std::mutex> lock(mutex);
+    slot->next = freeList;
+    freeList = slot;
+    --live;
+}
+
+#endif //FIRSTPROJECT_NODEPOOL_H
@@ -0,0 +1,84 @@
+#include <cstring>
+#include <unistd.h>
+#include "OutputBuffer.h"
+
+constexpr size_t OutputBuffer::flush_threshold;
+constexpr int OutputBuffer::capture;
+
+OutputBuffer::OutputBuffer(const int descriptor, const int errorDescriptor)
+    : descriptor(descriptor), errorDescriptor(errorDescriptor) {
+    if (descriptor != capture) {
+        buffer.reserve(flush_threshold);
+    }
+}
+
+// Destructor, writes whatever is still pending.
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+// Function that appends bytes, a block larger than the threshold is written directly after the pending output.
+OutputBuffer& OutputBuffer::write(const char* data, const size_t length) {
+    if (descriptor != capture && buffer.size() + length > flush_threshold) {
+        flush();
+        if (length >= flush_threshold) {
+            writeAll(descriptor, data, length);
+            return *this;
+        }
+    }
+    buffer.append(data, length);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char* text) {
+    return write(text, std::strlen(text));
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char c) {
+    return write(&c, 1);
+}
+
+// Function that appends a number in decimal, without going through a stream.
+OutputBuffer& OutputBuffer::operator<<(unsigned long long number) {
+    char digits[20];
+    size_t position = sizeof(digits);
+    do {
+        digits[--position] = static_cast<char>('0' + number % 10);
+        number /= 10;
+    } while (number != 0);
+    return write(digits + position, sizeof(digits) - position);
+}
+
+OutputBuffer& OutputBuffer::operator<<(const long long number) {
+    if (number < 0) {
+        *this << '-';
+        return *this << (0ULL - static_cast<unsigned long long>(number));
+    }
+    return *this << static_cast<unsigned long long>(number);
+}
+
+// Function that writes bytes into a descriptor, retrying short writes.
+void OutputBuffer::writeAll(const int target, const char* data, const size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        const ssize_t count = ::write(target, data + written, length - written);
+        if (count <= 0) break;      // Nothing sensible to do if the terminal output is gone.
+        written += static_cast<size_t>(count);
+    }
+}
+
+// Function that writes the pending output into the descriptor, a capturing buffer keeps it.
+void OutputBuffer::flush() {
+    if (descriptor == capture) return;
+    writeAll(descriptor, buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+// Function that prints an error after the pending output, in one write, so errors of concurrent sessions never mix.
+void OutputBuffer::error(const char* message) {
+    flush();
+    std::string line("ERROR: ");
+    line += message;
+    line += '\n';
+    writeAll(errorDescriptor, line.data(), line.size());
+}
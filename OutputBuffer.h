@@ -0,0 +1,52 @@
+#ifndef FIRSTPROJECT_OUTPUTBUFFER_H
+#define FIRSTPROJECT_OUTPUTBUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * OutputBuffer collects everything the terminal prints, and writes it to the output descriptor
+ * in large writes instead of one write per printed piece.
+ * The Terminal owns the buffer and flushes it at explicit points: before waiting for the next command,
+ * before printing an error, and at exit. It also flushes itself once it grows past flush_threshold,
+ * so printing a huge tree never holds more than that in memory.
+ * A buffer created with 'capture' keeps everything in memory instead, so a command running on another thread
+ * can print, and the Terminal copies the captured output in order afterwards.
+ * Errors go to their own descriptor (stderr, or the socket of a daemon session), right after the pending output.
+ * **/
+class OutputBuffer {
+    std::string buffer;     //< Pending output.
+    int descriptor;         //< Descriptor the output is written to.
+    int errorDescriptor;    //< Descriptor the errors are written to.
+
+    // Writes bytes into a descriptor, retrying short writes.
+    static void writeAll(int target, const char* data, size_t length);
+
+public:
+    static constexpr size_t flush_threshold = 64 * 1024;
+    static constexpr int capture = -1;      // Descriptor of a buffer that is never written anywhere.
+
+    explicit OutputBuffer(int descriptor = 1, int errorDescriptor = 2);
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer();
+
+    OutputBuffer& write(const char* data, size_t length);   // Appends raw bytes.
+    OutputBuffer& operator<<(std::string_view text) { return write(text.data(), text.length()); }
+    OutputBuffer& operator<<(const char* text);
+    OutputBuffer& operator<<(char c);
+    OutputBuffer& operator<<(unsigned long long number);
+    OutputBuffer& operator<<(unsigned long number) { return *this << static_cast<unsigned long long>(number); }
+    OutputBuffer& operator<<(unsigned number) { return *this << static_cast<unsigned long long>(number); }
+    OutputBuffer& operator<<(long long number);
+    OutputBuffer& operator<<(long number) { return *this << static_cast<long long>(number); }
+    OutputBuffer& operator<<(int number) { return *this << static_cast<long long>(number); }
+
+    void flush();                                   // Writes the pending output.
+    void error(const char* message);                // Flushes, then writes "ERROR: message" to the error descriptor.
+    int getDescriptor() const { return descriptor; }
+    const std::string& captured() const { return buffer; }     // Output kept so far by a capturing buffer.
+};
+
+#endif //FIRSTPROJECT_OUTPUTBUFFER_H
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cstring>
+#include "PageCache.h"
+#include "StreamStorage.h"
+
+constexpr size_t PageCache::page_size;
+constexpr size_t PageCache::default_capacity;
+
+// Function that returns the single cache shared by all StreamStorages.
+PageCache& PageCache::instance() {
+    static PageCache cache;
+    return cache;
+}
+
+// Function that changes the maximum amount of pages kept in memory, at least one page is kept.
+void PageCache::setCapacity(const size_t maxPages) {
+    capacity = maxPages == 0 ? 1 : maxPages;
+    while (lru.size() > capacity) {
+        evict();
+    }
+}
+
+// Function that returns the page holding a given file offset, the page becomes the most recently used.
+// On a miss the page is read from the physical file, evicting the least recently used page if full.
+// A page that is about to be overwritten completely is not read (load = false).
+PageCache::Page& PageCache::fetch(StreamStorage& storage, const size_t number, const bool load) {
+    const auto found = pages.find(Key(&storage, number));
+    if (found != pages.end()) {
+        ++hits;
+        if (found->second != lru.begin()) {
+            lru.splice(lru.begin(), lru, found->second);
+        }
+        return *found->second;
+    }
+
+    ++misses;
+    while (lru.size() >= capacity) {
+        evict();
+    }
+    std::fstream* stream = load ? storage.openForReading() : nullptr;     // A missing file reads as empty.
+    lru.emplace_front();
+    Page& page = lru.front();
+    page.owner = &storage;
+    page.number = number;
+    page.dirty = false;
+    page.length = 0;
+
+    if (stream) {
+        stream->seekg(static_cast<std::streamoff>(number * page_size));
+        stream->read(page.data, page_size);
+        page.length = static_cast<size_t>(stream->gcount());
+        stream->clear();
+    }
+
+    pages[Key(&storage, number)] = lru.begin();
+    return page;
+}
+
+// Function that writes the valid bytes of a dirty page into its physical file.
+void PageCache::writeBack(Page& page) {
+    if (!page.dirty) return;
+    std::fstream& stream = page.owner->open();
+    stream.seekp(static_cast<std::streamoff>(page.number * page_size));
+    stream.write(page.data, static_cast<std::streamsize>(page.length));
+    page.dirty = false;
+    ++writeBacks;
+}
+
+// Function that writes back (if needed) and removes the least recently used page.
+void PageCache::evict() {
+    Page& victim = lru.back();
+    writeBack(victim);
+    pages.erase(Key(victim.owner, victim.number));
+    lru.pop_back();
+}
+
+// Function that reads a single character, bytes past the end of the file read as 0.
+char PageCache::read(StreamStorage& storage, const size_t index) {
+    const Page& page = fetch(storage, index / page_size);
+    const size_t offset = index % page_size;
+    return offset < page.length ? page.data[offset] : 0;
+}
+
+// Function that writes a single character into its page and marks it dirty.
+// Writing past the end of the file extends the page, filling a gap with zeros.
+void PageCache::write(StreamStorage& storage, const size_t index, const char c) {
+    Page& page = fetch(storage, index / page_size);
+    const size_t offset = index % page_size;
+    if (offset >= page.length) {
+        std::memset(page.data + page.length, 0, offset - page.length);
+        page.length = offset + 1;
+    }
+    page.data[offset] = c;
+    page.dirty = true;
+}
+
+// Function that reads a range page by page, stopping at the end of the file.
+// Returns the amount of bytes read.
+size_t PageCache::read(StreamStorage& storage, size_t position, char* buffer, const size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        const Page& page = fetch(storage, position / page_size);
+        const size_t offset = position % page_size;
+        if (offset >= page.length) break;
+        const size_t amount = std::min(length - done, page.length - offset);
+        std::memcpy(buffer + done, page.data + offset, amount);
+        done += amount;
+        position += amount;
+        if (page.length < page_size) break;     // Last page of the file.
+    }
+    return done;
+}
+
+// Function that writes a range page by page and marks the pages dirty.
+// Pages that are overwritten completely are not read from the physical file.
+void PageCache::write(StreamStorage& storage, size_t position, const char* data, const size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        const size_t offset = position % page_size;
+        const size_t amount = std::min(length - done, page_size - offset);
+        Page& page = fetch(storage, position / page_size, amount != page_size);
+        if (offset > page.length) {
+            std::memset(page.data + page.length, 0, offset - page.length);
+        }
+        std::memcpy(page.data + offset, data + done, amount);
+        page.length = std::max(page.length, offset + amount);
+        page.dirty = true;
+        done += amount;
+        position += amount;
+    }
+}
+
+// Function that writes back all the dirty pages of one file, and flushes its stream.
+void PageCache::flush(StreamStorage& storage) {
+    bool written = false;
+    for (auto it = pages.lower_bound(Key(&storage, 0)); it != pages.end() && it->first.first == &storage; ++it) {
+        written |= it->second->dirty;
+        writeBack(*it->second);
+    }
+    if (written) {
+        storage.open().flush();
+    }
+}
+
+// Function that drops all the pages of one file, used when the physical file is removed or truncated.
+void PageCache::invalidate(StreamStorage& storage) {
+    auto it = pages.lower_bound(Key(&storage, 0));
+    while (it != pages.end() && it->first.first == &storage) {
+        lru.erase(it->second);
+        it = pages.erase(it);
+    }
+}
+
+// Function that writes back every dirty page, and flushes the streams that were written.
+void PageCache::sync() {
+    const StreamStorage* previous = nullptr;
+    for (const auto& entry : pages) {
+        if (entry.first.first != previous) {
+            previous = entry.first.first;
+            flush(*entry.second->owner);
+        }
+    }
+}
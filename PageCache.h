@@ -0,0 +1,64 @@
+#ifndef FIRSTPROJECT_PAGECACHE_H
+#define FIRSTPROJECT_PAGECACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <utility>
+
+class StreamStorage;    // Forward declaration to eliminate circular including.
+
+/**
+ * PageCache keeps fixed-size blocks (pages) of file content in memory.
+ * Character reads and writes of File are served from the pages, a written page
+ * is marked dirty and only written back to the physical file when it is evicted,
+ * when the whole file is used (cat, copy, wc), or on sync/exit.
+ * Pages are keyed by StreamStorage, hard-linked Files share one FileValue and therefore share their pages.
+ * **/
+class PageCache {
+    struct Page {
+        StreamStorage* owner;   //< File the page belongs to.
+        size_t number;          //< Page number inside the file (offset / page_size).
+        size_t length;          //< Amount of valid bytes inside the page.
+        bool dirty;             //< True if the page was written since it was loaded.
+        char data[4096];        //< Page content.
+    };
+    using Key = std::pair<const StreamStorage*, size_t>;
+
+    std::list<Page> lru;                                    //< Pages, most recently used first.
+    std::map<Key, std::list<Page>::iterator> pages;         //< Page lookup, ordered so a file's pages are adjacent.
+    size_t capacity;                                        //< Maximum amount of pages in memory.
+    size_t hits;                                            //< Accesses served from memory.
+    size_t misses;                                          //< Accesses that had to load a page.
+    size_t writeBacks;                                      //< Dirty pages written to a physical file.
+
+    PageCache(): capacity(default_capacity), hits(0), misses(0), writeBacks(0) {}
+    Page& fetch(StreamStorage& storage, size_t number, bool load = true); // Returns a page, loading it on a miss.
+    void writeBack(Page& page);                             // Writes a dirty page into its file.
+    void evict();                                           // Removes the least recently used page.
+
+public:
+    static constexpr size_t page_size = sizeof(Page::data);
+    static constexpr size_t default_capacity = 256;
+
+    PageCache(const PageCache&) = delete;
+    PageCache& operator=(const PageCache&) = delete;
+
+    static PageCache& instance();                           // Returns the process-wide cache.
+    void setCapacity(size_t maxPages);                      // Changes the bound, evicts pages above it.
+
+    char read(StreamStorage& storage, size_t index);        // Reads a character through the cache.
+    void write(StreamStorage& storage, size_t index, char c); // Writes a character into the cache.
+    size_t read(StreamStorage& storage, size_t position, char* buffer, size_t length); // Reads a range.
+    void write(StreamStorage& storage, size_t position, const char* data, size_t length); // Writes a range.
+    void flush(StreamStorage& storage);                     // Writes back the dirty pages of one file.
+    void invalidate(StreamStorage& storage);                // Drops the pages of one file without writing them.
+    void sync();                                            // Writes back every dirty page.
+
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    size_t getWriteBacks() const { return writeBacks; }
+    size_t cachedPages() const { return lru.size(); }
+};
+
+#endif //FIRSTPROJECT_PAGECACHE_H
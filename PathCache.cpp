@@ -0,0 +1,101 @@
+#include <cstring>
+#include "PathCache.h"
+#include "Directory.h"
+#include "CommandGenerator.h"
+#include "FileSystemException.h"
+
+constexpr size_t PathCache::default_capacity;
+
+// Function that trims the slashes around a path, and validates it has no consecutive slashes.
+static void trimPath(const std::string_view path, const char*& begin, const char*& end) {
+    if (path.find("//") != std::string_view::npos) {
+        throw CommandException("Invalid path: contains consecutive slashes.");
+    }
+    begin = path.data();
+    end = begin + path.length();
+    while (begin < end && *begin == '/') ++begin;
+    while (end > begin && *(end - 1) == '/') --end;
+}
+
+// Function that resolves a canonical path, first through the cache, otherwise by walking the tree.
+// The first component must be the root, a path made of the root only resolves to the root (not cached).
+// The key buffer belongs to the thread, so only the entries need the lock.
+Directory* PathCache::lookup(Directory& root, const char* begin, const char* end) {
+    thread_local std::string key;
+    key.assign(begin, end);
+    {
+        const std::shared_lock<std::shared_mutex> lock(mutex);
+        const auto found = entries.find(key);
+        if (found != entries.end()) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return found->second;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    const char* slash = static_cast<const char*>(std::memchr(begin, '/', static_cast<size_t>(end - begin)));
+    const char* firstEnd = slash ? slash : end;
+    if (begin == end || root.getDirectoryName().compare(0, std::string::npos, begin, static_cast<size_t>(firstEnd - begin)) != 0) {
+        throw LocationException("Invalid path: must start from root.");
+    }
+    if (!slash) {
+        return &root;
+    }
+
+    const std::vector<std::string> path = separatePath(key);
+    Directory* directory = root.depthSearch(std::vector<std::string>(path.begin() + 1, path.end()));
+    const std::lock_guard<std::shared_mutex> lock(mutex);
+    if (entries.size() >= capacity) {
+        entries.clear();
+    }
+    entries.emplace(key, directory);
+    return directory;
+}
+
+// Function that resolves a path whose every component is a directory (mkdir parent, chdir, ls).
+Directory* PathCache::resolveDirectory(Directory& root, const std::string_view path) {
+    const char* begin;
+    const char* end;
+    trimPath(path, begin, end);
+    return lookup(root, begin, end);
+}
+
+// Function that resolves the directory part of a path (used by every file command),
+// 'leaf' views the last component inside 'path', and may name a file or a directory.
+Directory* PathCache::resolveParent(Directory& root, const std::string_view path, std::string_view& leaf) {
+    const char* begin;
+    const char* end;
+    trimPath(path, begin, end);
+    if (begin == end) {
+        throw LocationException("Invalid path: must start from root.");
+    }
+    const char* slash = end;
+    while (slash > begin && *(slash - 1) != '/') --slash;
+    leaf = std::string_view(slash, static_cast<size_t>(end - slash));
+    if (slash == begin) {
+        return nullptr;
+    }
+    return lookup(root, begin, slash - 1);
+}
+
+// Function that removes the entries resolving into the subtree of a removed Directory.
+void PathCache::invalidate(const Directory* removed) {
+    const std::lock_guard<std::shared_mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second->isInside(removed)) {
+            it = entries.erase(it);
+            ++invalidations;
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Function that changes the maximum amount of entries, the cache is emptied if it is above the bound.
+void PathCache::setCapacity(const size_t maxEntries) {
+    const std::lock_guard<std::shared_mutex> lock(mutex);
+    capacity = maxEntries == 0 ? 1 : maxEntries;
+    if (entries.size() > capacity) {
+        entries.clear();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef FIRSTPROJECT_PATHCACHE_H
+#define FIRSTPROJECT_PATHCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class Directory;    // Forward declaration to eliminate circular including.
+
+/**
+ * PathCache maps directory path strings (like 'V/a/b') to the Directory they resolve to,
+ * so repeated commands on the same paths skip separatePath and depthSearch.
+ * File paths are resolved to their parent Directory through the cache, the file itself is found
+ * through the name index of that Directory, so touch, remove, move, copy and ln never make an entry stale.
+ * Directory nodes keep their address while they exist, therefore only rmdir invalidates entries,
+ * exactly the ones inside the removed subtree.
+ * Commands of a parallel script, and the sessions of a daemon, resolve paths from several threads:
+ * a hit only holds the lock shared, a miss walks the tree without it and inserts under the exclusive lock.
+ * **/
+class PathCache {
+    std::unordered_map<std::string, Directory*> entries;   //< Canonical directory path -> Directory.
+    size_t capacity;                                        //< Maximum amount of entries, the cache restarts when full.
+    std::atomic<size_t> hits;                               //< Resolutions served from the cache.
+    std::atomic<size_t> misses;                             //< Resolutions that had to walk the tree.
+    size_t invalidations;                                   //< Entries removed by rmdir.
+    std::shared_mutex mutex;                                //< Guards the entries, the capacity and the invalidations.
+
+    // Resolves the canonical path [begin, end) (no leading/trailing slashes) into a Directory.
+    Directory* lookup(Directory& root, const char* begin, const char* end);
+
+public:
+    static constexpr size_t default_capacity = 64 * 1024;
+
+    PathCache(): capacity(default_capacity), hits(0), misses(0), invalidations(0) {}
+
+    // Returns the Directory the whole path points to.
+    Directory* resolveDirectory(Directory& root, std::string_view path);
+    // Returns the Directory holding the last component of the path, and points 'leaf' at that component
+    // (inside 'path', nothing is copied). Returns nullptr if the path is made of one component only.
+    Directory* resolveParent(Directory& root, std::string_view path, std::string_view& leaf);
+    // Removes every entry pointing into the subtree of a Directory that is about to be removed.
+    void invalidate(const Directory* removed);
+
+    void setCapacity(size_t maxEntries);
+    size_t getHits() const { return hits.load(std::memory_order_relaxed); }
+    size_t getMisses() const { return misses.load(std::memory_order_relaxed); }
+    size_t getInvalidations() const { return invalidations; }
+    size_t size() const { return entries.size(); }
+};
+
+#endif //FIRSTPROJECT_PATHCACHE_H
@@ -1,28 +1,75 @@
 /**
  * Code provided by the course lecturer.
+ * The counter itself is a policy (see below), so objects shared between threads count atomically,
+ * while objects only used by one thread at a time keep a plain int.
  * **/
 
 #ifndef FIRSTPROJECT_RCOBJECT_H
 #define FIRSTPROJECT_RCOBJECT_H
 
-class RCObject {
+#include <atomic>
+
+// Counting policy of an object only referenced by one thread at a time (or only under a lock), a plain int.
+class PlainCount {
+    int count = 0;
+public:
+    void increment() { ++count; }
+    bool decrement() { return --count == 0; }      // Returns true if the last reference is gone.
+    int get() const { return count; }
+};
+
+// Counting policy of an object referenced from several threads, lock-free atomic operations.
+// Taking a reference needs no ordering, dropping the last one has to see every write made through the others.
+class AtomicCount {
+    std::atomic<int> count{0};
+public:
+    void increment() { count.fetch_add(1, std::memory_order_relaxed); }
+    bool decrement() { return count.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+    int get() const { return count.load(std::memory_order_relaxed); }
+};
+
+// Counting policy of an object referenced from several threads only in some modes of the program.
+// 'concurrent' tells if such a mode is running, it may only change while no other thread holds references.
+// Otherwise the count is read and written back like a plain int (no locked instruction), in concurrent modes
+// it uses the lock-free operations of AtomicCount.
+template<bool (*concurrent)()>
+class SwitchedCount {
+    std::atomic<int> count{0};
+public:
+    void increment() {
+        if (concurrent()) count.fetch_add(1, std::memory_order_relaxed);
+        else count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    bool decrement() {
+        if (concurrent()) return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        const int remaining = count.load(std::memory_order_relaxed) - 1;
+        count.store(remaining, std::memory_order_relaxed);
+        return remaining == 0;
+    }
+    int get() const { return count.load(std::memory_order_relaxed); }
+};
+
+template<class Count>
+class RCObjectBase {
 protected:
-    RCObject() : refCount(0), shareable(true) { }
-    RCObject(const RCObject&) : refCount(0), shareable(true) { }
-    RCObject& operator=(const RCObject&) { return *this; }
+    RCObjectBase() : shareable(true) { }
+    RCObjectBase(const RCObjectBase&) : shareable(true) { }
+    RCObjectBase& operator=(const RCObjectBase&) { return *this; }
 
-    virtual ~RCObject(){};
+    virtual ~RCObjectBase(){};
 
 public:
-    void addReference() { ++refCount; }
-    void removeReference() { if (--refCount == 0) delete this; }
-    int  getRefCount() const{ return refCount; }
+    void addReference() { refCount.increment(); }
+    void removeReference() { if (refCount.decrement()) delete this; }
+    int  getRefCount() const{ return refCount.get(); }
     void markUnshareable() { shareable = false; }
     bool isShareable() const { return shareable; }
-    bool isShared() const { return refCount > 1; }
+    bool isShared() const { return refCount.get() > 1; }
 
 private:
-    int refCount;
+    Count refCount;
     bool shareable;
 };
-#endif //FIRSTPROJECT_RCOBJECT_H
\ No newline at end of file
+
+using RCObject = RCObjectBase<PlainCount>;
+#endif //FIRSTPROJECT_RCOBJECT_H
@@ -1,5 +1,6 @@
 /**
  * Code provided by the course lecturer.
+ * Moving an RCPtr hands the reference over, without touching the count.
  * **/
 #ifndef FIRSTPROJECT_RCPTR_H
 #define FIRSTPROJECT_RCPTR_H
@@ -14,8 +15,10 @@ public:
 	RCPtr(T* realPtr=nullptr): pointee(realPtr) { init();}
 	RCPtr(const RCPtr& rhs): pointee(rhs.pointee) 
 	{ init();}
+	RCPtr(RCPtr&& rhs) noexcept: pointee(rhs.pointee) { rhs.pointee = nullptr; }
 	~RCPtr(){ if (pointee) pointee->removeReference();}
 	RCPtr& operator=(const RCPtr& rhs);
+	RCPtr& operator=(RCPtr&& rhs) noexcept;
 	T* operator->() const{return pointee;}
 	T& operator*() const{return *pointee;}
 };
@@ -43,4 +46,18 @@ RCPtr<T>& RCPtr<T>::operator=(const RCPtr<T>& rhs)
   }
   return *this;
 }
+
+// Move assignment, takes over the reference of rhs, and drops the one held before.
+template<class T>
+RCPtr<T>& RCPtr<T>::operator=(RCPtr<T>&& rhs) noexcept
+{
+  if (this != &rhs) {
+    T* oldPointee = pointee;
+    pointee = rhs.pointee;
+    rhs.pointee = nullptr;
+    if(oldPointee)
+      oldPointee->removeReference();
+  }
+  return *this;
+}
 #endif //FIRSTPROJECT_RCPTR_H
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ScriptReader.h"
+#include "FileSystemException.h"
+
+constexpr size_t ScriptReader::block_size;
+
+ScriptReader::ScriptReader(const int descriptor)
+    : descriptor(descriptor), ownsDescriptor(false), mapped(nullptr), mappedLength(0),
+      capacity(0), data(nullptr), begin(0), end(0), finished(false) {
+    map();
+}
+
+ScriptReader::ScriptReader(const std::string& path)
+    : descriptor(::open(path.c_str(), O_RDONLY)), ownsDescriptor(true), mapped(nullptr), mappedLength(0),
+      capacity(0), data(nullptr), begin(0), end(0), finished(false) {
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to open the script file.");
+    }
+    map();
+}
+
+// Destructor, releases the mapping and the descriptor opened by the reader.
+ScriptReader::~ScriptReader() {
+    if (mapped) {
+        ::munmap(mapped, mappedLength);
+    }
+    if (ownsDescriptor) {
+        ::close(descriptor);
+    }
+}
+
+// Function that maps the whole input, so every line is a view into the page cache of the kernel.
+// Pipes, terminals, and a stdin that was already partly consumed are read in blocks instead.
+void ScriptReader::map() {
+    struct stat status {};
+    if (::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0 ||
+        ::lseek(descriptor, 0, SEEK_CUR) != 0) {
+        return;
+    }
+    void* address = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (address == MAP_FAILED) {
+        return;
+    }
+    ::madvise(address, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+    mapped = static_cast<char*>(address);
+    mappedLength = static_cast<size_t>(status.st_size);
+    data = mapped;
+    end = mappedLength;
+    finished = true;
+}
+
+// Function that reads the next block after the bytes not handed out yet.
+// Those bytes (the start of an unfinished line) are moved to the front first, the buffer doubles if they fill it.
+bool ScriptReader::fill() {
+    if (finished) return false;
+    if (!buffer) {
+        capacity = block_size;
+        buffer.reset(new char[capacity]);
+    }
+    const size_t pending = end - begin;
+    if (pending == capacity) {
+        std::unique_ptr<char[]> larger(new char[capacity * 2]);
+        std::memcpy(larger.get(), buffer.get() + begin, pending);
+        buffer = std::move(larger);
+        capacity *= 2;
+    } else if (begin > 0) {
+        std::memmove(buffer.get(), buffer.get() + begin, pending);
+    }
+    begin = 0;
+    end = pending;
+    data = buffer.get();
+
+    while (true) {
+        const ssize_t count = ::read(descriptor, buffer.get() + end, capacity - end);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            finished = true;
+            return false;
+        }
+        end += static_cast<size_t>(count);
+        return true;
+    }
+}
+
+// Function that returns the next line, like std::getline the '\n' is dropped and a '\r' is kept.
+// The last line is returned even without a '\n' after it.
+bool ScriptReader::nextLine(std::string_view& line) {
+    while (true) {
+        const char* start = data + begin;
+        const void* newline = begin < end ? std::memchr(start, '\n', end - begin) : nullptr;
+        if (newline) {
+            const size_t length = static_cast<size_t>(static_cast<const char*>(newline) - start);
+            line = std::string_view(start, length);
+            begin += length + 1;
+            return true;
+        }
+        if (!fill()) {
+            if (begin == end) return false;
+            line = std::string_view(data + begin, end - begin);
+            begin = end;
+            return true;
+        }
+    }
+}
+
+// Function that checks if the next line is already in memory, a session flushes its output before waiting for input.
+bool ScriptReader::hasLine() const {
+    if (begin == end) return false;
+    return finished || std::memchr(data + begin, '\n', end - begin) != nullptr;
+}
@@ -0,0 +1,45 @@
+#ifndef FIRSTPROJECT_SCRIPTREADER_H
+#define FIRSTPROJECT_SCRIPTREADER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * ScriptReader hands out the lines of a command stream (a script file, or a piped stdin) as views,
+ * without copying each line into a string.
+ * A regular file is mapped into memory whole, any other descriptor (pipe, socket) is read in large blocks,
+ * a line crossing the end of a block is moved to the front of the buffer before the next read.
+ * A line view stays valid until the next call to nextLine.
+ * **/
+class ScriptReader {
+    int descriptor;                     //< Descriptor the commands are read from.
+    bool ownsDescriptor;                //< True if the reader opened the descriptor (and closes it).
+    char* mapped;                       //< Mapping of the whole file, nullptr when reading in blocks.
+    size_t mappedLength;                //< Length of the mapping.
+    std::unique_ptr<char[]> buffer;     //< Block buffer, used when the input is not mapped.
+    size_t capacity;                    //< Size of the block buffer, doubled for a line longer than it.
+    const char* data;                   //< Start of the available bytes (mapping or buffer).
+    size_t begin;                       //< First byte not handed out yet.
+    size_t end;                         //< End of the available bytes.
+    bool finished;                      //< True once the input has no more bytes to read.
+
+    void map();                         // Maps the descriptor if it is a non-empty regular file at offset 0.
+    bool fill();                        // Reads another block, returns false at the end of the input.
+
+public:
+    static constexpr size_t block_size = 1024 * 1024;
+
+    explicit ScriptReader(int descriptor);          // Reads an already open descriptor (for example stdin).
+    explicit ScriptReader(const std::string& path); // Opens a script file, throws FileSystemException.
+    ScriptReader(const ScriptReader&) = delete;
+    ScriptReader& operator=(const ScriptReader&) = delete;
+    ~ScriptReader();
+
+    bool nextLine(std::string_view& line);          // Returns the next line without its '\n', false at the end.
+    bool hasLine() const;                           // True if nextLine returns without reading (or waiting for) input.
+    bool isMapped() const { return mapped != nullptr; }
+};
+
+#endif //FIRSTPROJECT_SCRIPTREADER_H
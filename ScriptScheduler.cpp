@@ -0,0 +1,203 @@
+#include <exception>
+#include "ScriptScheduler.h"
+#include "FileStorage.h"
+#include "ThreadPool.h"
+
+constexpr size_t ScriptScheduler::window_size;
+
+// Function that returns the representative node of a group, halving the path on the way.
+size_t ScriptScheduler::find(size_t node) {
+    while (parents[node] != node) {
+        parents[node] = parents[parents[node]];
+        node = parents[node];
+    }
+    return node;
+}
+
+// Function that merges the groups of two nodes.
+void ScriptScheduler::unite(const size_t first, const size_t second) {
+    const size_t a = find(first);
+    const size_t b = find(second);
+    if (a != b) parents[b] = a;
+}
+
+// Function that returns the node of a directory key, a new key is merged with every key it is inside of,
+// and with every key inside of it. Keys of sibling subtrees stay apart.
+size_t ScriptScheduler::keyNode(const std::string& key) {
+    const auto found = keys.find(key);
+    if (found != keys.end()) return found->second;
+
+    const size_t node = parents.size();
+    parents.push_back(node);
+    keys.emplace(key, node);
+    for (size_t slash = key.find('/'); slash != std::string::npos; slash = key.find('/', slash + 1)) {
+        pathBuffer.assign(key, 0, slash);
+        const auto ancestor = keys.find(pathBuffer);
+        if (ancestor != keys.end()) unite(node, ancestor->second);
+        below[pathBuffer].push_back(node);
+    }
+    const auto inside = below.find(key);
+    if (inside != below.end()) {
+        for (const size_t other : inside->second) unite(node, other);
+    }
+    return node;
+}
+
+// Function that writes the canonical directory a path uses into 'key' (the path itself, or its parent).
+// Returns false if the path does not start from the root, has consecutive slashes, or has no parent to use,
+// such paths name physical files outside the tree, or fail, and run alone.
+bool ScriptScheduler::directoryKey(std::string_view path, const bool parent, std::string& key) const {
+    if (path.find("//") != std::string_view::npos) return false;
+    while (!path.empty() && path.front() == '/') path.remove_prefix(1);
+    while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+    if (path.substr(0, path.find('/')) != context.root.getDirectoryName()) return false;
+    if (parent) {
+        const size_t slash = path.rfind('/');
+        if (slash == std::string_view::npos) return false;
+        path = path.substr(0, slash);
+    }
+    key.assign(path.data(), path.length());
+    return true;
+}
+
+// Function that checks if the last component of a path is a File sharing its content with a hard-link.
+// Such a File is reachable from other subtrees, so commands using it run alone.
+// The tree is not changing while a window is collected, a path that does not exist yet cannot be a hard-link.
+bool ScriptScheduler::isHardLinked(const std::string& directory, std::string_view path) const {
+    Directory* current = &context.root;
+    size_t begin = directory.find('/');
+    while (begin != std::string::npos) {
+        const size_t end = directory.find('/', begin + 1);
+        current = current->findSubDirectory(std::string_view(directory).substr(begin + 1, end == std::string::npos ? end : end - begin - 1));
+        if (!current) return false;
+        begin = end;
+    }
+    while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+    const int index = current->isFileExists(path.substr(path.rfind('/') + 1));
+    return index != -1 && current->getFileAt(index).getRefCounter() > 1;
+}
+
+// Function that analyses a command and adds it to the window.
+// Returns false, leaving the window unchanged, if the command has to run alone.
+bool ScriptScheduler::add(const std::string_view line) {
+    tokenizeCommand(line, command, parameters);
+    const CommandSpec* spec = findCommand(command);
+    if (!spec || spec->access == CommandAccess::Exclusive) return false;
+    if (spec->directoryCommand && !parameters.empty() && line.back() != '/') return false;
+    if (parameters.size() < spec->minArguments || parameters.size() > spec->maxArguments) return false;
+    if (spec->name == "wc" && (parameters.size() != 1 || parameters[0] == "-r")) return false;
+
+    std::string first, second;
+    switch (spec->access) {
+        case CommandAccess::Directory:
+            if (parameters.empty()) {
+                context.workingDirectory->getFullPath(first, '/');
+            } else if (!directoryKey(parameters[0], false, first)) {
+                return false;
+            }
+            break;
+        case CommandAccess::Parents:
+            if (!directoryKey(parameters[1], true, second) || isHardLinked(second, parameters[1])) return false;
+            [[fallthrough]];
+        case CommandAccess::Parent:
+            if (!directoryKey(parameters[0], true, first) || isHardLinked(first, parameters[0])) return false;
+            break;
+        default:
+            return false;
+    }
+
+    Command added;
+    added.begin = lines.size();
+    added.length = line.length();
+    added.group = keyNode(first);
+    if (!second.empty()) unite(added.group, keyNode(second));
+    lines.append(line.data(), line.length());
+    commands.push_back(std::move(added));
+    return true;
+}
+
+// Function that runs the window, and empties it.
+// A window made of one group runs on this thread, otherwise every group is a ThreadPool task.
+size_t ScriptScheduler::run() {
+    if (commands.empty()) return 0;
+    std::vector<size_t> taskOf(parents.size(), SIZE_MAX);
+    size_t tasks = 0;
+    for (Command& current : commands) {
+        const size_t root = find(current.group);
+        if (taskOf[root] == SIZE_MAX) taskOf[root] = tasks++;
+        current.group = taskOf[root];
+    }
+    const size_t errors = tasks == 1 ? runInOrder() : runGroups(tasks);
+
+    lines.clear();
+    commands.clear();
+    parents.clear();
+    keys.clear();
+    below.clear();
+    return errors;
+}
+
+// Function that runs every command on this thread, printing straight into the output of the Terminal.
+size_t ScriptScheduler::runInOrder() {
+    size_t errors = 0;
+    const std::string_view text(lines);
+    for (const Command& current : commands) {
+        try {
+            if (!dispatchCommand(context, text.substr(current.begin, current.length), command, parameters)) ++errors;
+        } catch (std::exception& e) {
+            printCommandError(context.output, e.what());
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+// Function that runs every group as a ThreadPool task, each with its own captured output,
+// then prints the output and the errors of every command in the order of the script.
+size_t ScriptScheduler::runGroups(const size_t groups) {
+    std::vector<std::vector<Command*>> members(groups);
+    for (Command& current : commands) members[current.group].push_back(&current);
+    std::vector<std::unique_ptr<OutputBuffer>> outputs(groups);
+
+    const std::string_view text(lines);
+    ThreadPool& pool = ThreadPool::instance();
+    FileStorage::setConcurrent(true);
+    for (size_t group = 0; group < groups; group++) {
+        outputs[group].reset(new OutputBuffer(OutputBuffer::capture));
+        pool.submit([this, text, &members, &outputs, group] {
+            OutputBuffer& output = *outputs[group];
+            CommandContext local{context.root, context.paths, context.workingDirectory, output};
+            std::string_view name;
+            CommandArguments arguments;
+            for (Command* current : members[group]) {
+                current->outputBegin = output.captured().size();
+                try {
+                    current->failed = !dispatchCommand(local, text.substr(current->begin, current->length), name, arguments);
+                } catch (std::exception& e) {
+                    current->failed = current->threw = true;
+                    current->error = e.what();
+                }
+                current->outputEnd = output.captured().size();
+            }
+        });
+    }
+    try {
+        pool.wait();
+    } catch (...) {
+        FileStorage::setConcurrent(false);
+        throw;
+    }
+    FileStorage::setConcurrent(false);
+
+    size_t errors = 0;
+    for (const Command& current : commands) {
+        const std::string& captured = outputs[current.group]->captured();
+        context.output.write(captured.data() + current.outputBegin, current.outputEnd - current.outputBegin);
+        if (!current.failed) continue;
+        ++errors;
+        if (current.threw) {
+            printCommandError(context.output, current.error.c_str());
+        }
+    }
+    return errors;
+}
@@ -0,0 +1,64 @@
+#ifndef FIRSTPROJECT_SCRIPTSCHEDULER_H
+#define FIRSTPROJECT_SCRIPTSCHEDULER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "CommandGenerator.h"
+
+/**
+ * ScriptScheduler runs the commands of a script on the ThreadPool, while keeping the result of running them in order.
+ * Commands are collected into a window, every command is given the directories it uses (see CommandAccess),
+ * and commands whose directories are equal, or one inside the other, are put into the same group.
+ * Groups use disjoint subtrees, they run in parallel, while the commands of a group run one after the other.
+ * The output (and error) of every command is captured, and printed in the order of the script once the window ends.
+ * Commands that cannot share the tree (chdir, rmdir, ln, lproot, stats, sync, save, load, 'wc -r', files outside the
+ * virtual tree, hard-linked files, malformed commands) are refused by add(), the Terminal runs the window
+ * and then runs them alone.
+ * **/
+class ScriptScheduler {
+    struct Command {
+        size_t begin;               //< Position of the line inside 'lines'.
+        size_t length;              //< Length of the line.
+        size_t group;               //< Union-find node of the command.
+        size_t outputBegin = 0;     //< Captured output of the command, inside the output of its group.
+        size_t outputEnd = 0;
+        bool failed = false;        //< True if the command threw or was unknown.
+        bool threw = false;         //< True if the command threw.
+        std::string error;          //< Message of the exception.
+    };
+
+    CommandContext& context;                                        //< Terminal state shared by every command.
+    std::string lines;                                              //< Text of every line of the window.
+    std::vector<Command> commands;                                  //< Commands of the window, in order.
+    std::vector<size_t> parents;                                    //< Union-find over the directory keys.
+    std::unordered_map<std::string, size_t> keys;                   //< Directory path -> union-find node.
+    std::unordered_map<std::string, std::vector<size_t>> below;     //< Directory path -> nodes of keys inside it.
+    std::string_view command;                                       //< Reused by the analysis of a line.
+    CommandArguments parameters;
+    std::string pathBuffer;
+
+    size_t find(size_t node);                       // Returns the representative node of a group.
+    void unite(size_t first, size_t second);        // Merges two groups.
+    size_t keyNode(const std::string& key);         // Returns the node of a directory key, merging it with related keys.
+    bool directoryKey(std::string_view path, bool parent, std::string& key) const;  // Canonical directory of a path.
+    bool isHardLinked(const std::string& directory, std::string_view path) const;   // True if the path is a shared File.
+    size_t runGroups(size_t groups);                // Runs the window on the ThreadPool, prints it, returns the errors.
+    size_t runInOrder();                            // Runs the window on this thread, returns the errors.
+
+public:
+    static constexpr size_t window_size = 4096;     // Maximum amount of commands collected before running them.
+
+    explicit ScriptScheduler(CommandContext& context): context(context) {}
+    ScriptScheduler(const ScriptScheduler&) = delete;
+    ScriptScheduler& operator=(const ScriptScheduler&) = delete;
+
+    bool add(std::string_view line);                // Adds a command to the window, false if it must run alone.
+    size_t run();                                   // Runs and prints the window, returns the amount of failed commands.
+    size_t size() const { return commands.size(); }
+};
+
+#endif //FIRSTPROJECT_SCRIPTSCHEDULER_H
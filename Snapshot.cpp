@@ -0,0 +1,436 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Snapshot.h"
+#include "FileSystemException.h"
+#include "FileStorage.h"
+#include "InlineStorage.h"
+
+constexpr char Snapshot::magic[8];
+constexpr std::uint32_t Snapshot::version;
+constexpr std::uint32_t Snapshot::no_name;
+constexpr std::uint32_t Snapshot::hard_link;
+constexpr std::uint32_t Snapshot::detached;
+
+static_assert(sizeof(Snapshot::Header) % 8 == 0 && sizeof(Snapshot::DirectoryRecord) % 8 == 0 &&
+              sizeof(Snapshot::FileRecord) % 8 == 0 && sizeof(Snapshot::ContentRecord) % 8 == 0,
+              "Records keep the sections 8 byte aligned.");
+
+namespace {
+
+// Function that rounds an offset up to the next multiple of 8.
+std::uint64_t align8(const std::uint64_t offset) {
+    return (offset + 7) & ~std::uint64_t(7);
+}
+
+/**
+ * ImageWriter writes the image in large blocks, and checks every write,
+ * so a full disk fails the save instead of leaving a truncated image.
+ * **/
+class ImageWriter {
+    static constexpr size_t block_size = 1 << 20;
+
+    std::string path;
+    int descriptor;
+    std::string buffer;
+    std::uint64_t written;      //< Bytes handed to the writer so far.
+
+    void writeAll(const char* data, size_t length) {
+        while (length > 0) {
+            const ssize_t count = ::write(descriptor, data, length);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                throw FileSystemException("Failed to write the image.");
+            }
+            data += count;
+            length -= static_cast<size_t>(count);
+        }
+    }
+
+public:
+    explicit ImageWriter(std::string imagePath)
+        : path(std::move(imagePath)), descriptor(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)),
+          written(0) {
+        if (descriptor < 0) {
+            throw FileSystemException("Failed to create the image.");
+        }
+        buffer.reserve(block_size);
+    }
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    // Destructor, an image that was not finished is removed.
+    ~ImageWriter() {
+        if (descriptor >= 0) {
+            ::close(descriptor);
+            ::unlink(path.c_str());
+        }
+    }
+
+    void write(const void* data, const size_t length) {
+        written += length;
+        if (buffer.size() + length > block_size) {
+            writeAll(buffer.data(), buffer.size());
+            buffer.clear();
+            if (length >= block_size) {
+                writeAll(static_cast<const char*>(data), length);
+                return;
+            }
+        }
+        buffer.append(static_cast<const char*>(data), length);
+    }
+
+    std::uint64_t position() const { return written; }
+
+    // Overwrites bytes already handed to the writer (the header, once every section is placed).
+    void rewrite(const std::uint64_t offset, const void* data, const size_t length) {
+        writeAll(buffer.data(), buffer.size());
+        buffer.clear();
+        if (::pwrite(descriptor, data, length, static_cast<off_t>(offset)) != static_cast<ssize_t>(length)) {
+            throw FileSystemException("Failed to write the image.");
+        }
+    }
+
+    // Writes zeros up to the next multiple of 8.
+    void pad() {
+        static const char zeros[8] = {};
+        write(zeros, align8(written) - written);
+    }
+
+    // Writes what is still buffered, and closes the image, which stays.
+    void finish() {
+        writeAll(buffer.data(), buffer.size());
+        buffer.clear();
+        const int result = ::close(descriptor);
+        descriptor = -1;
+        if (result != 0) {
+            ::unlink(path.c_str());
+            throw FileSystemException("Failed to write the image.");
+        }
+    }
+};
+
+/**
+ * ImageMapping maps a whole image read-only, records are read in place.
+ * **/
+class ImageMapping {
+    int descriptor;
+    const char* data;
+    size_t length;
+
+public:
+    explicit ImageMapping(const std::string& path)
+        : descriptor(::open(path.c_str(), O_RDONLY | O_CLOEXEC)), data(nullptr), length(0) {
+        if (descriptor < 0) {
+            throw FileNotFoundException("Failed to open the image.");
+        }
+        struct stat status {};
+        if (::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) ||
+            static_cast<size_t>(status.st_size) < sizeof(Snapshot::Header)) {
+            ::close(descriptor);
+            throw FileSystemException("Not a snapshot image.");
+        }
+        length = static_cast<size_t>(status.st_size);
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address == MAP_FAILED) {
+            ::close(descriptor);
+            throw FileSystemException("Failed to map the image.");
+        }
+        ::madvise(address, length, MADV_SEQUENTIAL | MADV_WILLNEED);
+        data = static_cast<const char*>(address);
+    }
+    ImageMapping(const ImageMapping&) = delete;
+    ImageMapping& operator=(const ImageMapping&) = delete;
+    ~ImageMapping() {
+        ::munmap(const_cast<char*>(data), length);
+        ::close(descriptor);
+    }
+
+    // Function that checks that 'bytes' bytes starting at 'offset' lie inside the image.
+    bool contains(const std::uint64_t offset, const std::uint64_t bytes) const {
+        return offset <= length && bytes <= length - offset;
+    }
+
+    template <typename T>
+    const T* at(const std::uint64_t offset) const { return reinterpret_cast<const T*>(data + offset); }
+};
+
+// Function that creates the physical file of a hard-link, left by the touch that created it before 'ln'.
+// Its content is never read, the File reads the content it shares, but 'remove' expects the file.
+void touchHostFile(const std::string& path) {
+    const int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to create the file.");
+    }
+    ::close(descriptor);
+}
+
+// Function that throws for an image that does not follow the format.
+void require(const bool condition) {
+    if (!condition) {
+        throw FileSystemException("Corrupted image.");
+    }
+}
+
+}
+
+// Function that writes the tree into a temporary image next to 'path', and renames it over 'path'.
+// Directories are numbered in preorder, so every parent is written before its subdirectories,
+// and the files of every directory follow the ones of the previous directory.
+// Contents are numbered when their first file is met, a hard-link refers to the same content.
+// A content is written under the physical name of its first file, only a different name is stored.
+void Snapshot::save(Directory& root, const std::string& path) {
+    const FileStorage::Guard guard;
+    const NameTable& table = NameTable::instance();
+    std::vector<DirectoryRecord> directories;
+    std::vector<const Directory*> nodes;
+    std::vector<FileRecord> files;
+    std::vector<ContentRecord> contents;
+    std::vector<FileValue*> values;
+    std::unordered_map<const FileValue*, std::uint32_t> contentIndex;
+    std::vector<std::string_view> names;
+    std::unordered_map<NameId, std::uint32_t> nameIndex;
+    std::deque<std::string> physicalNames;      // Names that are not interned, a deque never moves them.
+
+    const auto addName = [&](const NameId id) {
+        const auto found = nameIndex.emplace(id, static_cast<std::uint32_t>(names.size()));
+        if (found.second) {
+            names.emplace_back(table.name(id));
+        }
+        return found.first->second;
+    };
+
+    std::vector<std::pair<const Directory*, std::uint32_t>> pending(1, std::make_pair(&root, no_name));
+    std::vector<const Directory*> children;
+    while (!pending.empty()) {
+        const Directory* current = pending.back().first;
+        const std::uint32_t parent = pending.back().second;
+        pending.pop_back();
+        const auto index = static_cast<std::uint32_t>(nodes.size());
+        nodes.push_back(current);
+        directories.push_back({addName(current->name), parent, static_cast<std::uint32_t>(current->files.size() - current->removedFiles), 0});
+        children.clear();
+        for (const Directory* child = current->firstChild; child; child = child->nextSibling) {
+            children.push_back(child);
+        }
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            pending.emplace_back(*child, index);
+        }
+    }
+
+    std::string hostPath;
+    for (const Directory* directory : nodes) {
+        for (const File& file : directory->files) {
+            if (file.name == NameTable::none) continue;            // Slot of a removed file.
+            const auto found = contentIndex.emplace(file.value.operator->(), static_cast<std::uint32_t>(values.size()));
+            if (found.second) {
+                FileValue* value = file.value.operator->();
+                std::uint32_t physicalName = no_name;
+                if (value->getFilename() != file.hostPath(hostPath)) {
+                    physicalName = static_cast<std::uint32_t>(names.size());
+                    physicalNames.push_back(value->getFilename());
+                    names.emplace_back(physicalNames.back());
+                }
+                contents.push_back({0, 0, physicalName, value->isDetached() ? detached : 0});
+                values.push_back(value);
+            }
+            files.push_back({addName(file.name), found.first->second, file.count, file.hardLink ? hard_link : 0, 0});
+        }
+    }
+
+    if (files.size() > UINT32_MAX || names.size() >= no_name) {
+        throw FileSystemException("The tree is too large for an image.");
+    }
+
+    const std::string temporary = path + ".tmp";
+    ImageWriter writer(temporary);
+    Header header{};
+    writer.write(&header, sizeof(header));
+    header.dataOffset = writer.position();
+    for (size_t i = 0; i < values.size(); i++) {
+        contents[i].offset = writer.position() - header.dataOffset;
+        std::uint64_t length = 0;
+        values[i]->storage->forEachBlock([&writer, &length](const char* data, const size_t amount) {
+            writer.write(data, amount);
+            length += amount;
+        });
+        contents[i].length = length;
+    }
+    header.dataBytes = writer.position() - header.dataOffset;
+    writer.pad();
+    header.directoryOffset = writer.position();
+    writer.write(directories.data(), directories.size() * sizeof(DirectoryRecord));
+    header.fileOffset = writer.position();
+    writer.write(files.data(), files.size() * sizeof(FileRecord));
+    header.contentOffset = writer.position();
+    writer.write(contents.data(), contents.size() * sizeof(ContentRecord));
+    header.nameOffset = writer.position();
+    std::uint64_t end = 0;
+    for (const std::string_view name : names) {
+        end += name.length();
+        writer.write(&end, sizeof(end));
+    }
+    for (const std::string_view name : names) {
+        writer.write(name.data(), name.length());
+    }
+    header.nameBytes = end;
+
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.directories = static_cast<std::uint32_t>(directories.size());
+    header.files = static_cast<std::uint32_t>(files.size());
+    header.contents = static_cast<std::uint32_t>(contents.size());
+    header.names = static_cast<std::uint32_t>(names.size());
+    writer.rewrite(0, &header, sizeof(header));
+    writer.finish();
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        throw FileSystemException("Failed to replace the image.");
+    }
+}
+
+// Function that checks the image, removes the current tree, and builds the saved one.
+// Every record is checked first (bounds, indexes, parents before children, unique names in a directory),
+// so nothing read while building can fail. Names are interned once per distinct name,
+// directories come from the NodePool, and contents are written straight from the mapping.
+void Snapshot::load(Directory& root, const std::string& path, const std::function<void()>& replacing) {
+    const ImageMapping image(path);
+    const Header& header = *image.at<Header>(0);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        throw FileSystemException("Not a snapshot image.");
+    }
+    if (header.version != version) {
+        throw FileSystemException("Unsupported image version.");
+    }
+    for (const std::uint64_t offset : {header.directoryOffset, header.fileOffset, header.contentOffset,
+                                       header.nameOffset, header.dataOffset}) {
+        require(offset % 8 == 0);
+    }
+    require(header.directories > 0 && header.names < no_name);
+    require(image.contains(header.directoryOffset, std::uint64_t(header.directories) * sizeof(DirectoryRecord)));
+    require(image.contains(header.fileOffset, std::uint64_t(header.files) * sizeof(FileRecord)));
+    require(image.contains(header.contentOffset, std::uint64_t(header.contents) * sizeof(ContentRecord)));
+    require(image.contains(header.nameOffset, std::uint64_t(header.names) * sizeof(std::uint64_t)));
+    const std::uint64_t nameStart = header.nameOffset + std::uint64_t(header.names) * sizeof(std::uint64_t);
+    require(image.contains(nameStart, header.nameBytes));
+    require(image.contains(header.dataOffset, header.dataBytes));
+
+    const auto* directories = image.at<DirectoryRecord>(header.directoryOffset);
+    const auto* files = image.at<FileRecord>(header.fileOffset);
+    const auto* contents = image.at<ContentRecord>(header.contentOffset);
+    const auto* nameEnds = image.at<std::uint64_t>(header.nameOffset);
+    const char* nameBytes = image.at<char>(nameStart);
+    const char* data = image.at<char>(header.dataOffset);
+
+    std::uint64_t previous = 0;
+    for (std::uint32_t i = 0; i < header.names; i++) {
+        require(nameEnds[i] > previous && nameEnds[i] <= header.nameBytes);
+        previous = nameEnds[i];
+    }
+    const auto nameAt = [nameEnds, nameBytes](const std::uint32_t index) {
+        const std::uint64_t start = index == 0 ? 0 : nameEnds[index - 1];
+        return std::string_view(nameBytes + start, nameEnds[index] - start);
+    };
+    for (std::uint32_t i = 0; i < header.contents; i++) {
+        require(contents[i].offset <= header.dataBytes && contents[i].length <= header.dataBytes - contents[i].offset);
+        require(contents[i].physicalName == no_name || contents[i].physicalName < header.names);
+    }
+    require(directories[0].name < header.names);
+    if (nameAt(directories[0].name) != root.getDirectoryName()) {
+        throw FileSystemException("The image holds another root directory.");
+    }
+    std::unordered_set<std::uint64_t> subDirectories;       // (parent, name) of every subdirectory.
+    std::vector<std::uint32_t> seenIn(header.names, no_name);   // Last directory holding a file of each name.
+    std::uint64_t fileCount = 0;
+    for (std::uint32_t i = 0; i < header.directories; i++) {
+        const DirectoryRecord& directory = directories[i];
+        require(directory.name < header.names);
+        if (i > 0) {
+            require(directory.parent < i);
+            require(subDirectories.insert(std::uint64_t(directory.parent) << 32 | directory.name).second);
+        }
+        require(directory.files <= header.files - fileCount);
+        for (std::uint64_t f = fileCount; f < fileCount + directory.files; f++) {
+            require(files[f].name < header.names && files[f].content < header.contents);
+            require(seenIn[files[f].name] != i);
+            seenIn[files[f].name] = i;
+        }
+        fileCount += directory.files;
+    }
+    require(fileCount == header.files);
+
+    if (replacing) {
+        replacing();
+    }
+    const FileStorage::Guard guard;
+    root.clearFiles(root);
+    root.files.clear();
+    root.removedFiles = 0;
+    root.fileIndex.clear();
+    root.releaseChildren();
+
+    InlineStorage::expectDirty(header.contents);
+    NameTable& table = NameTable::instance();
+    std::vector<NameId> ids(header.names, NameTable::none);
+    const auto idOf = [&](const std::uint32_t index) {
+        if (ids[index] == NameTable::none) {
+            ids[index] = table.intern(nameAt(index));
+        }
+        return ids[index];
+    };
+    std::vector<Directory*> nodes(header.directories, &root);
+    std::vector<FileValue*> values(header.contents, nullptr);
+    std::string directoryPath;
+    std::string hostPath;
+    std::uint64_t f = 0;
+    for (std::uint32_t i = 0; i < header.directories; i++) {
+        if (i > 0) {
+            nodes[i] = Directory::pool().create(idOf(directories[i].name), nodes[directories[i].parent]);
+            nodes[directories[i].parent]->linkChild(nodes[i]);
+        }
+        Directory& directory = *nodes[i];
+        directory.files.reserve(directories[i].files);
+        directory.fileIndex.reserve(directories[i].files);
+        directory.getFullPath(directoryPath, '!');
+        for (std::uint32_t k = 0; k < directories[i].files; k++, f++) {
+            const FileRecord& record = files[f];
+            File file;
+            file.owner = &directory;
+            file.name = idOf(record.name);
+            file.count = record.count;
+            file.hardLink = (record.flags & hard_link) != 0;
+            hostPath.assign(directoryPath).append(1, '!').append(table.name(file.name));   // See File::hostPath.
+            FileValue*& value = values[record.content];
+            if (!value) {
+                const ContentRecord& content = contents[record.content];
+                value = new FileValue(content.physicalName == no_name ? hostPath : std::string(nameAt(content.physicalName)));
+                file.value = value;
+                FileStorage& storage = value->reserve(content.length);
+                storage.create();
+                if (!value->isInline()) {
+                    storage.truncate();         // A physical file left at the name does not show through.
+                }
+                storage.write(0, data + content.offset, content.length);
+                if (content.flags & detached) {
+                    value->detach();
+                }
+            } else {
+                file.value = value;
+            }
+            if (value->storage->hasHostFile() && value->getFilename() != hostPath) {
+                touchHostFile(hostPath);
+            }
+            directory.fileIndex.emplace(file.name, directory.files.size());
+            directory.files.push_back(std::move(file));
+        }
+    }
+}
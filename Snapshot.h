@@ -0,0 +1,82 @@
+#ifndef FIRSTPROJECT_SNAPSHOT_H
+#define FIRSTPROJECT_SNAPSHOT_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "Directory.h"
+
+/**
+ * Snapshot saves the whole virtual tree into one image file, and replaces the tree with a saved one.
+ * The image holds the directories, the files (name, character count, hard-link mark), the contents,
+ * and which files share a content (hard-links), so a loaded tree behaves like the saved one.
+ * The format is made to be mapped and read in place, without parsing:
+ *  - a fixed header (magic, version, amounts and offsets of every section),
+ *  - the contents, back to back (streamed first, so a content is read once, and its length is what was read),
+ *  - fixed size records of the directories (preorder, subdirectories in creation order, root first),
+ *    of the files (grouped by directory, in order), and of the contents,
+ *  - the names, as a table of end offsets followed by the bytes.
+ * Numbers are native (little-endian on every supported host), every section is 8 byte aligned.
+ * A new version of the format changes 'version', an older program refuses the image instead of misreading it.
+ * Save writes a temporary file and renames it, so an image is never seen half written.
+ * Load checks the whole image before it touches the tree: a bad image leaves the tree as it was.
+ * **/
+class Snapshot {
+public:
+    static constexpr char magic[8] = {'V', 'F', 'S', 'I', 'M', 'A', 'G', 'E'};
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::uint32_t no_name = UINT32_MAX;    // Content stored under the physical name of its first file.
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t directories;      //< Amount of directory records, the root is the first one.
+        std::uint32_t files;            //< Amount of file records.
+        std::uint32_t contents;         //< Amount of content records.
+        std::uint32_t names;            //< Amount of names.
+        std::uint32_t reserved;
+        std::uint64_t dataOffset;       //< Start of each section, from the start of the image.
+        std::uint64_t dataBytes;
+        std::uint64_t directoryOffset;
+        std::uint64_t fileOffset;
+        std::uint64_t contentOffset;
+        std::uint64_t nameOffset;       //< End offset of every name (inside the name bytes), then the name bytes.
+        std::uint64_t nameBytes;
+    };
+
+    struct DirectoryRecord {
+        std::uint32_t name;
+        std::uint32_t parent;           //< Index of the parent record, always before this one (ignored for the root).
+        std::uint32_t files;            //< Amount of files, their records follow the ones of the previous directory.
+        std::uint32_t reserved;
+    };
+
+    struct FileRecord {
+        std::uint32_t name;
+        std::uint32_t content;          //< Index of the content record, shared by hard-links.
+        std::uint64_t count;            //< Character count.
+        std::uint32_t flags;            //< hard_link.
+        std::uint32_t reserved;
+    };
+
+    struct ContentRecord {
+        std::uint64_t offset;           //< Start inside the content section.
+        std::uint64_t length;
+        std::uint32_t physicalName;     //< Name of the physical file, no_name for the path of its first file.
+        std::uint32_t flags;            //< detached.
+    };
+
+    static constexpr std::uint32_t hard_link = 1;
+    static constexpr std::uint32_t detached = 1;
+
+    // Writes the tree below root into an image, replacing an existing one. Throws FileSystemException.
+    static void save(Directory& root, const std::string& path);
+
+    // Replaces the tree below root (files and directories) with the one saved in an image.
+    // 'replacing' is called once the image was checked, right before the old tree is removed,
+    // to drop every pointer into it (path cache, working directories).
+    // The physical files of the replaced tree are removed like on 'exit'. Throws FileSystemException.
+    static void load(Directory& root, const std::string& path, const std::function<void()>& replacing = {});
+};
+
+#endif //FIRSTPROJECT_SNAPSHOT_H
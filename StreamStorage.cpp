@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <exception>
+#include "StreamStorage.h"
+#include "PageCache.h"
+#include "FileSystemException.h"
+
+constexpr size_t StreamStorage::block_size;
+
+// Destructor, pending pages are written back before the stream is closed.
+// Writing back reopens an evicted file, which may fail: a destructor must not throw, the error is reported to stderr.
+StreamStorage::~StreamStorage() {
+    try {
+        PageCache::instance().flush(*this);
+    } catch (std::exception& e) {
+        std::fprintf(stderr, "ERROR: %s\n", e.what());
+    }
+    PageCache::instance().invalidate(*this);
+    close();
+    delete stream;
+}
+
+// Function that returns the stream of this file, opened in both input and output mode (write back, touch, truncate).
+// An open stream is reused, otherwise the file is opened and registered in FileHandleCache,
+// which may close the least recently used file. A missing physical file is created, truncate reopens it empty.
+std::fstream& StreamStorage::open(const bool truncate) {
+    if (truncate || (stream->is_open() && !writable)) {
+        close();
+    }
+    if (reuse()) {
+        stream->clear();
+        return *stream;
+    }
+
+    stream->clear();
+    stream->open(filename, std::ios::in | std::ios::out | (truncate ? std::ios::trunc : std::ios::openmode()));
+    if (!stream->is_open()) {           // The physical file does not exist yet, create it.
+        stream->clear();
+        stream->open(filename, std::ios::out);
+        stream->close();
+        stream->open(filename, std::ios::in | std::ios::out);
+    }
+    if (!stream->is_open()) {
+        throw FileSystemException("Failed to open the file.");
+    }
+    writable = true;
+    admit();
+    return *stream;
+}
+
+// Function that returns the stream of this file for reading (page loads, cat, wc, size).
+// An open stream is reused, otherwise the file is opened in input mode only, so reading never creates it:
+// a missing physical file (removed under a hard-link, or outside the terminal) reads as empty, like it always did.
+std::fstream* StreamStorage::openForReading() {
+    if (reuse()) {
+        stream->clear();
+        return stream;
+    }
+
+    stream->clear();
+    stream->open(filename, std::ios::in);
+    if (!stream->is_open()) {
+        stream->clear();
+        return nullptr;
+    }
+    writable = false;
+    admit();
+    return stream;
+}
+
+// Function that reads one character through the PageCache.
+char StreamStorage::read(const size_t index) {
+    return PageCache::instance().read(*this, index);
+}
+
+// Function that writes one character into the PageCache.
+void StreamStorage::write(const size_t index, const char c) {
+    PageCache::instance().write(*this, index, c);
+}
+
+// Function that reads a range through the PageCache.
+size_t StreamStorage::read(const size_t position, char* buffer, const size_t length) {
+    return PageCache::instance().read(*this, position, buffer, length);
+}
+
+// Function that writes a range into the PageCache.
+void StreamStorage::write(const size_t position, const char* data, const size_t length) {
+    PageCache::instance().write(*this, position, data, length);
+}
+
+// Function that writes back the cached pages, then streams the file in large blocks.
+void StreamStorage::forEachBlock(const BlockConsumer& consumer) {
+    PageCache::instance().flush(*this);
+    std::fstream* file = openForReading();
+    if (!file) return;
+    const Pin pin(*this);
+    file->seekg(0);
+    char buffer[block_size];
+    while (file->read(buffer, block_size) || file->gcount() > 0) {
+        consumer(buffer, static_cast<size_t>(file->gcount()));
+    }
+    file->clear();
+}
+
+// Function that returns the size of the file, including pages that were not written back yet.
+size_t StreamStorage::size() {
+    PageCache::instance().flush(*this);
+    std::fstream* file = openForReading();
+    if (!file) return 0;
+    file->seekg(0, std::ios::end);
+    const std::streamoff end = file->tellg();
+    return end < 0 ? 0 : static_cast<size_t>(end);
+}
+
+// Function that creates the physical file (if needed) and flushes it.
+void StreamStorage::create() {
+    open().flush();
+}
+
+// Function that drops the cached pages and reopens the file empty.
+void StreamStorage::truncate() {
+    PageCache::instance().invalidate(*this);
+    open(true);
+}
+
+// Function that writes back the dirty pages of this file, and flushes the stream.
+// Pages evicted earlier may still sit in the stream buffer, so an open stream is always flushed.
+void StreamStorage::flush() {
+    PageCache::instance().flush(*this);
+    if (stream->is_open()) {
+        stream->flush();
+    }
+}
+
+// Function that closes the stream (flushing pending writes) and removes it from FileHandleCache.
+void StreamStorage::close() {
+    forget();
+    if (stream->is_open()) {
+        stream->close();
+    }
+}
+
+// Function that drops the cached pages without writing them, and closes the stream.
+void StreamStorage::discard() {
+    PageCache::instance().invalidate(*this);
+    close();
+}
@@ -0,0 +1,39 @@
+#ifndef FIRSTPROJECT_STREAMSTORAGE_H
+#define FIRSTPROJECT_STREAMSTORAGE_H
+
+#include <fstream>
+#include "FileStorage.h"
+
+/**
+ * StreamStorage is the default FileStorage backend.
+ * Contains a heap allocated fstream which stays open between operations (bounded by FileHandleCache),
+ * character and ranged access is served through the PageCache.
+ * **/
+class StreamStorage final : public FileStorage {
+    std::fstream* stream;   //< File stream used for file operations (allocated on heap as required).
+    bool writable = false;  //< True if the open stream was opened for writing too.
+
+public:
+    static constexpr size_t block_size = 64 * 1024;     // Size of the blocks streamed by forEachBlock.
+
+    explicit StreamStorage(std::string name): FileStorage(std::move(name)), stream(new std::fstream()) {}
+    ~StreamStorage() override;
+
+    std::fstream& open(bool truncate = false);          // Returns the stream opened for reading and writing.
+    std::fstream* openForReading();                     // Returns the stream opened for reading, nullptr if missing.
+
+    char read(size_t index) override;
+    void write(size_t index, char c) override;
+    size_t read(size_t position, char* buffer, size_t length) override;
+    void write(size_t position, const char* data, size_t length) override;
+    void forEachBlock(const BlockConsumer& consumer) override;
+    size_t size() override;
+
+    void create() override;
+    void truncate() override;
+    void flush() override;
+    void close() override;
+    void discard() override;
+};
+
+#endif //FIRSTPROJECT_STREAMSTORAGE_H
@@ -1,52 +1,95 @@
-#include <sstream>
+#include <chrono>
 #include <iostream>
 #include "Terminal.h"
 #include "CommandGenerator.h"
+#include "ScriptScheduler.h"
+#include "Snapshot.h"
+#include "Journal.h"
 
 // Simulates a terminal, reads commands from user and executes them.
-// Command maps are ['command': lambda function], for more information, go to CommandGenerator.h
+// The end of the input acts like 'exit'.
 void Terminal::startTerminal() {
-    auto DirectoryCommands = buildDirectoryCommandsMap(root, workingDirectory);
-    auto FileCommands = buildFileCommandsMap(root);
+    std::ios::sync_with_stdio(false);   // std::cin gets its own buffer, so pending input can be detected.
 
     std::string inputString;
     while(true) {
-        std::getline(std::cin, inputString);
-
-        if(inputString == "exit") {
+        if (std::cin.rdbuf()->in_avail() <= 0) {
+            output.flush();             // About to wait for the user, show everything printed so far.
+        }
+        if(!std::getline(std::cin, inputString) || inputString == "exit") {
             clearFS();  // User exit command clears the physical files created if needed.
+            output.flush();
             break;
         }
-        std::stringstream stream(inputString);
-        std::string command;
-        stream >> command;
+        execute(inputString);
+    }
+}
 
-        std::vector<std::string> parameters;
-        std::string parameter;
-        while (stream >> parameter) parameters.push_back(parameter);
+// Each line is split into views of it, the command is found in a compile-time table
+// and its function is called directly, for more information, go to CommandGenerator.h
+bool Terminal::execute(const std::string_view line) {
+    try{
+        return dispatchCommand(context, line, command, parameters);
+    }catch(std::exception& e){                          // Throw a unique exception for each case encounter.
+        printCommandError(output, e.what());            // Keep the error after the output that came before it.
+        return false;
+    }
+}
 
-        auto iterator = DirectoryCommands.find(command);
-        try{
-            if(iterator != DirectoryCommands.end()){        // Check if the command is for Directories, or files.
-                if (parameter.empty() || inputString[inputString.length()-1] == '/')
-                    iterator->second(parameters);
-                else
-                    throw CommandException("Invalid path: last character has to be a slash.");
-            }
-            else {
-                iterator = FileCommands.find(command);
-                if (iterator != FileCommands.end()) {
-                    iterator->second(parameters);
-                } else {
-                    std::cout << "Unknown command: " << command << "\n";
-                }
+// Runs a whole script, the lines are views into the reader, so no line is copied.
+// In parallel, commands are collected by a ScriptScheduler, a command that has to run alone
+// waits for the collected ones first. Stopping at the first error needs every command in order,
+// so it always runs one command at a time.
+// Background copies would escape the ordering of the scheduler, so a parallel script runs every copy in place.
+ScriptSummary Terminal::runScript(ScriptReader& reader, const bool stopOnError, const bool parallel) {
+    ScriptSummary summary;
+    const auto start = std::chrono::steady_clock::now();
+    ScriptScheduler scheduler(context);
+    const bool scheduled = parallel && !stopOnError;
+    if (scheduled) context.jobs = nullptr;
+    std::string_view line;
+    while (reader.nextLine(line) && line != "exit") {
+        ++summary.commands;
+        if (scheduled) {
+            if (scheduler.add(line)) {
+                if (scheduler.size() == ScriptScheduler::window_size) summary.errors += scheduler.run();
+                continue;
             }
-        }catch(std::exception& e){                          // Throw a unique exception for each case encounter.
-            std::cerr << "ERROR: " << e.what() << "\n";
+            summary.errors += scheduler.run();
+        }
+        if (!execute(line)) {
+            ++summary.errors;
+            if (stopOnError) break;
         }
     }
+    summary.errors += scheduler.run();
+    clearFS();
+    output.flush();
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return summary;
 }
 
+// Removes every file of the virtual tree, then writes back what is still cached.
+// Removing first drops the cached content of the removed files, so it is never written just to be deleted.
+// Background copies are waited for first, their files are removed like the others.
+// The journal is emptied last, the tree is gone on purpose, there is nothing to recover.
 void Terminal::clearFS() {
+    jobs.waitAll(output);
     root.clearFiles(root);
-}
\ No newline at end of file
+    FileStorage::syncAll();
+    Journal::instance().reset();
+}
+
+// Loads a snapshot image into the root, nothing refers to the old tree yet.
+// The load is journaled like the 'load' command.
+void Terminal::load(const std::string& snapshot) {
+    Journal& journal = Journal::instance();
+    const std::uint64_t record = journal.isActive() ? journal.append("load " + snapshot) : 0;
+    Snapshot::load(root, snapshot);
+    if (record) journal.waitDurable(record);
+}
+
+// Rebuilds the tree from a journal before the first command.
+size_t Terminal::recover(const std::string& journal) {
+    return replayJournal(root, paths, journal);
+}
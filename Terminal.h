@@ -6,22 +6,62 @@
 
 #include <utility>
 #include "Directory.h"
+#include "FileStorage.h"
+#include "PathCache.h"
+#include "OutputBuffer.h"
+#include "CommandGenerator.h"
+#include "JobTable.h"
+#include "ScriptReader.h"
+
+// Summary of a script run, printed by main.
+struct ScriptSummary {
+    size_t commands = 0;    // Executed command lines.
+    size_t errors = 0;      // Commands that failed or were unknown.
+    double seconds = 0;     // Wall time of the whole run.
+};
 
 /**
  * Represents a Terminal, Supports all the commands in the exercise.
  * Holds the root directory, and workingDirectory for the command 'pwd'.
+ * Everything the commands print goes through one OutputBuffer, flushed when the terminal is about
+ * to wait for input, before an error is printed, and at exit.
  * */
 class Terminal {
+    FileStorage::BackendUse backendUse;  // < Holds the storage backend of the process while the terminal lives.
     Directory root;                 // < Root Directory.
     Directory* workingDirectory;    // < Used for chdir.
+    PathCache paths;                // < Resolves repeated paths without walking the tree.
+    OutputBuffer output;            // < Buffered output of every command.
+    JobTable jobs;                  // < Copies running in the background.
+    CommandContext context;         // < What the commands use from the terminal.
+    std::string_view command;       // < Command of the current line.
+    CommandArguments parameters;    // < Arguments of the current line, reused for every line.
+
+    // Executes one command line, returns false if it failed or was unknown.
+    bool execute(std::string_view line);
 
 public:
-    // Explicit constructor.
-    explicit Terminal(std::string mRoot): root(std::move(mRoot), nullptr), workingDirectory(&root) {}
+    // Explicit constructor, also selects the storage backend of the process (see FileStorage::BackendUse),
+    // throws FileSystemException if another terminal or daemon of the process uses a different one.
+    explicit Terminal(std::string mRoot, const StorageBackend backend = StorageBackend::Stream)
+        : backendUse(backend), root(std::move(mRoot), nullptr), workingDirectory(&root),
+          context{root, paths, workingDirectory, output, nullptr, &jobs} {}
 
     // Starts the mini terminal.
     void startTerminal();
 
+    // Runs every command of a script (or piped stdin) back to back, until 'exit' or the end of the input,
+    // optionally stopping at the first failed command, or running commands on disjoint subtrees in parallel.
+    // Output is only flushed when it piles up, before errors, and at the end.
+    ScriptSummary runScript(ScriptReader& reader, bool stopOnError = false, bool parallel = false);
+
+    // Rebuilds the tree of a crashed terminal from its journal, and journals from then on (see Journal).
+    // Returns the amount of replayed commands.
+    size_t recover(const std::string& journal);
+
+    // Replaces the tree with the one saved in a snapshot image, before the first command (see Snapshot).
+    void load(const std::string& snapshot);
+
     // deletes all the physical files created on the user's disk.
     void clearFS();
 };
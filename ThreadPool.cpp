@@ -0,0 +1,131 @@
+#include "ThreadPool.h"
+
+size_t ThreadPool::configuredThreads = 0;
+
+// Index of the worker running on the current thread, -1 outside the pool.
+static thread_local long currentWorker = -1;
+
+// Constructor, starts the workers (at least one).
+ThreadPool::ThreadPool(size_t threads)
+    : queued(0), pending(0), nextQueue(0), steals(0), stopping(false) {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+// Destructor, lets the workers finish the queued tasks, then joins them.
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Function that returns the pool shared by the whole process.
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(configuredThreads ? configuredThreads : std::thread::hardware_concurrency());
+    return pool;
+}
+
+// Function that sets the amount of workers of the process-wide pool, 0 means one per core.
+void ThreadPool::setThreads(const size_t threads) {
+    configuredThreads = threads;
+}
+
+// Function that queues a task, on the current worker's own queue, or round robin from outside the pool.
+// The task is counted before it is pushed, so a worker never takes a task that is not counted yet.
+void ThreadPool::submit(Task task) {
+    size_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        target = currentWorker >= 0 ? static_cast<size_t>(currentWorker) : nextQueue++ % queues.size();
+        ++pending;
+        ++queued;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+// Function that takes the newest task of the worker's own queue, or else the oldest task of another queue.
+bool ThreadPool::take(const size_t worker, Task& task) {
+    {
+        Queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        Queue& victim = *queues[(worker + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            std::lock_guard<std::mutex> counters(mutex);
+            ++steals;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Main loop of a worker: sleeps until a task is queued, runs it, and reports when the pool becomes idle.
+void ThreadPool::run(const size_t worker) {
+    currentWorker = static_cast<long>(worker);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (queued == 0) return;    // Stopping, and nothing is left to run.
+        }
+        Task task;
+        if (!take(worker, task)) {              // Another worker took it first, or it is still being pushed.
+            std::this_thread::yield();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --queued;
+        }
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure) failure = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            idle.notify_all();
+        }
+    }
+}
+
+// Function that blocks until every submitted task finished, then rethrows the first failure (if any).
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+    if (failure) {
+        std::exception_ptr thrown = failure;
+        failure = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+// Function that returns the amount of tasks that were stolen from another worker's queue.
+size_t ThreadPool::getSteals() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return steals;
+}
@@ -0,0 +1,65 @@
+#ifndef FIRSTPROJECT_THREADPOOL_H
+#define FIRSTPROJECT_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * ThreadPool runs tasks on a fixed set of worker threads with work stealing.
+ * Every worker has its own queue: tasks submitted from outside are spread over the queues round robin,
+ * tasks submitted by a worker go to its own queue. A worker takes its newest task first,
+ * and when its queue is empty it steals the oldest task of another worker, so uneven tasks
+ * (a few huge files among many small ones) still keep every core busy.
+ * wait() blocks until every submitted task finished, and rethrows the first exception a task threw.
+ * **/
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Queue {
+        std::mutex mutex;               //< Guards the tasks of this worker.
+        std::deque<Task> tasks;         //< Own tasks taken from the back, stolen from the front.
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;     //< One queue per worker.
+    std::vector<std::thread> workers;               //< Worker threads.
+    std::mutex mutex;                               //< Guards the counters below.
+    std::condition_variable wake;                   //< Signaled when a task is queued, or on shutdown.
+    std::condition_variable idle;                   //< Signaled when the last pending task finished.
+    size_t queued;                                  //< Tasks waiting in any queue.
+    size_t pending;                                 //< Tasks submitted and not finished yet.
+    size_t nextQueue;                               //< Queue receiving the next outside task.
+    size_t steals;                                  //< Tasks taken from another worker's queue.
+    bool stopping;                                  //< True once the destructor started.
+    std::exception_ptr failure;                     //< First exception thrown by a task.
+
+    static size_t configuredThreads;                //< Amount of workers of the process-wide pool, 0 means one per core.
+
+    bool take(size_t worker, Task& task);           // Pops an own task, or steals one.
+    void run(size_t worker);                        // Main loop of a worker thread.
+
+public:
+    explicit ThreadPool(size_t threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    static ThreadPool& instance();                  // Returns the process-wide pool, created on first use.
+    static void setThreads(size_t threads);         // Sets the size of the process-wide pool, before its first use.
+
+    void submit(Task task);                         // Queues a task.
+    void wait();                                    // Blocks until every task finished.
+
+    size_t size() const { return workers.size(); }
+    size_t getSteals();
+};
+
+#endif //FIRSTPROJECT_THREADPOOL_H
@@ -0,0 +1,155 @@
+#include <fcntl.h>
+#include <memory>
+#include <unistd.h>
+#include "WordCount.h"
+#include "FileSystemException.h"
+
+constexpr size_t WordCount::block_size;
+WordCount::Kernel WordCount::forced = nullptr;
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define WORDCOUNT_X86 1
+#include <immintrin.h>
+#endif
+
+// Scalar kernel, used on every CPU for the bytes that do not fill a whole vector.
+static void countScalar(const char* data, const size_t length, WordCount::Counts& counts) {
+    bool inWord = counts.inWord;
+    for (size_t i = 0; i < length; i++) {
+        const char c = data[i];
+        const bool space = WordCount::isSpace(c);
+        counts.newlines += c == '\n';
+        counts.words += !space && !inWord;
+        inWord = !space;
+    }
+    counts.inWord = inWord;
+    counts.bytes += length;
+    if (length > 0) counts.last = data[length - 1];
+}
+
+#ifdef WORDCOUNT_X86
+// Function that counts words inside one vector, given a bit mask of its non-space bytes.
+// A word starts at every non-space byte whose previous byte (the last bit of the previous vector for bit 0) is a space.
+static inline unsigned wordStarts(const unsigned long long nonSpace, const unsigned width, bool& inWord) {
+    const unsigned long long previous = (nonSpace << 1) | (inWord ? 1ULL : 0ULL);
+    inWord = (nonSpace >> (width - 1)) & 1ULL;
+    return static_cast<unsigned>(__builtin_popcountll(nonSpace & ~previous));
+}
+
+// SSE2 kernel, classifies 16 bytes per step with compares, and counts bits of the resulting masks.
+__attribute__((target("sse2")))
+static void countSse2(const char* data, const size_t length, WordCount::Counts& counts) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i belowTab = _mm_set1_epi8('\t' - 1);
+    const __m128i aboveReturn = _mm_set1_epi8('\r' + 1);
+    bool inWord = counts.inWord;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i control = _mm_and_si128(_mm_cmpgt_epi8(bytes, belowTab), _mm_cmplt_epi8(bytes, aboveReturn));
+        const __m128i space = _mm_or_si128(control, _mm_cmpeq_epi8(bytes, blank));
+        const unsigned newlines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        const unsigned nonSpace = ~static_cast<unsigned>(_mm_movemask_epi8(space)) & 0xFFFFu;
+        counts.newlines += static_cast<size_t>(__builtin_popcount(newlines));
+        counts.words += wordStarts(nonSpace, 16, inWord);
+    }
+    counts.inWord = inWord;
+    counts.bytes += i;
+    if (i > 0) counts.last = data[i - 1];
+    countScalar(data + i, length - i, counts);
+}
+
+// AVX2 kernel, the same classification as SSE2 on 32 bytes per step.
+__attribute__((target("avx2,popcnt")))
+static void countAvx2(const char* data, const size_t length, WordCount::Counts& counts) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i belowTab = _mm256_set1_epi8('\t' - 1);
+    const __m256i aboveReturn = _mm256_set1_epi8('\r' + 1);
+    bool inWord = counts.inWord;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, belowTab), _mm256_cmpgt_epi8(aboveReturn, bytes));
+        const __m256i space = _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, blank));
+        const unsigned newlines = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+        const unsigned nonSpace = ~static_cast<unsigned>(_mm256_movemask_epi8(space));
+        counts.newlines += static_cast<size_t>(__builtin_popcount(newlines));
+        counts.words += wordStarts(nonSpace, 32, inWord);
+    }
+    counts.inWord = inWord;
+    counts.bytes += i;
+    if (i > 0) counts.last = data[i - 1];
+    countScalar(data + i, length - i, counts);
+}
+#endif
+
+// Function that picks the widest kernel the CPU supports, once, unless setKernel picked one.
+WordCount::Kernel WordCount::kernel() {
+    static const Kernel selected = []() -> Kernel {
+#ifdef WORDCOUNT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return countAvx2;
+        if (__builtin_cpu_supports("sse2")) return countSse2;
+#endif
+        return countScalar;
+    }();
+    return forced ? forced : selected;
+}
+
+// Function that returns the kernel of a name (scalar, sse2, avx2), nullptr if this CPU or build lacks it.
+WordCount::Kernel WordCount::kernel(const std::string_view name) {
+    if (name == "scalar") return countScalar;
+#ifdef WORDCOUNT_X86
+    __builtin_cpu_init();
+    if (name == "sse2" && __builtin_cpu_supports("sse2")) return countSse2;
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) return countAvx2;
+#endif
+    return nullptr;
+}
+
+// Function that makes every count use the kernel of a name, so the kernels can be compared (see bench/wc_bench.cpp).
+// Only called while nothing is counted. Returns false, keeping the current kernel, if this CPU lacks it.
+bool WordCount::setKernel(const std::string_view name) {
+    const Kernel selected = kernel(name);
+    if (!selected) return false;
+    forced = selected;
+    return true;
+}
+
+// Function that returns the name of the selected kernel.
+const char* WordCount::kernelName() {
+#ifdef WORDCOUNT_X86
+    if (kernel() == countAvx2) return "avx2";
+    if (kernel() == countSse2) return "sse2";
+#endif
+    return "scalar";
+}
+
+// Function that counts one block with the selected kernel.
+void WordCount::add(const char* data, const size_t length) {
+    kernel()(data, length, counts);
+}
+
+// Function that counts a physical file block by block with pread, up to 'length' bytes.
+// Uses no cache shared with other Files, therefore many files can be counted in parallel.
+WordCount WordCount::countFile(const std::string& filename, const size_t length) {
+    WordCount counter;
+    if (length == 0) return counter;
+    const int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw FileSystemException("Failed to open the file.");
+    }
+    std::unique_ptr<char[]> buffer(new char[block_size]);
+    size_t position = 0;
+    while (position < length) {
+        const size_t wanted = length - position < block_size ? length - position : block_size;
+        const ssize_t count = ::pread(descriptor, buffer.get(), wanted, static_cast<off_t>(position));
+        if (count <= 0) break;
+        counter.add(buffer.get(), static_cast<size_t>(count));
+        position += static_cast<size_t>(count);
+    }
+    ::close(descriptor);
+    return counter;
+}
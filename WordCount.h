@@ -0,0 +1,55 @@
+#ifndef FIRSTPROJECT_WORDCOUNT_H
+#define FIRSTPROJECT_WORDCOUNT_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * WordCount counts newlines, words and characters of content streamed to it block by block (used by wc).
+ * Whitespace is ' ', '\t', '\n', '\v', '\f' and '\r', a word is a run of anything else,
+ * a word may continue from one block into the next one.
+ * The counting kernel is picked once at runtime: AVX2 (32 bytes per step), SSE2 (16 bytes per step),
+ * or a scalar loop on other CPUs and for the tail of every block. All kernels give identical results.
+ * **/
+class WordCount {
+public:
+    // State carried from one block to the next.
+    struct Counts {
+        size_t newlines = 0;        //< Amount of '\n' bytes.
+        size_t words = 0;           //< Amount of words started so far.
+        size_t bytes = 0;           //< Amount of bytes seen.
+        bool inWord = false;        //< True if the last byte seen belongs to a word.
+        char last = '\n';           //< Last byte seen, '\n' before the first one.
+    };
+    using Kernel = void (*)(const char* data, size_t length, Counts& counts);
+
+private:
+    Counts counts;
+
+    static Kernel forced;                           //< Kernel selected by setKernel, nullptr for the detected one.
+
+public:
+    WordCount() = default;
+    explicit WordCount(const Counts& counts): counts(counts) {}
+
+    void add(const char* data, size_t length);      // Counts one more block of content.
+    // Counts the first 'length' bytes of a physical file, through its own descriptor (safe on any thread).
+    static WordCount countFile(const std::string& filename, size_t length);
+
+    size_t getLines() const { return counts.newlines + (counts.last != '\n' ? 1 : 0); }    // A last line without '\n' counts too.
+    size_t getWords() const { return counts.words; }
+    size_t getCharacters() const { return counts.bytes - counts.newlines; }                 // Newlines are not characters.
+    const Counts& getCounts() const { return counts; }
+
+    // Returns true for the whitespace characters that separate words.
+    static bool isSpace(const char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    static Kernel kernel();                         // Returns the kernel selected for this CPU.
+    static Kernel kernel(std::string_view name);    // Returns a kernel by name, nullptr if this CPU lacks it.
+    static bool setKernel(std::string_view name);   // Makes every count use a kernel (benchmarks), false if missing.
+    static const char* kernelName();                // Returns the name of the selected kernel (scalar, sse2, avx2).
+    static constexpr size_t block_size = 256 * 1024;    // Size of the blocks read by countFile.
+};
+
+#endif //FIRSTPROJECT_WORDCOUNT_H
@@ -0,0 +1,114 @@
+// Commands-per-second benchmark of the command tokenizer and dispatch table.
+// Runs 1M mixed command lines (pwd, read, write, ls, touch, unknown commands, arity errors) three ways:
+//   - parsing only, the way the terminal used to (stringstream, vector<string>, std::map of std::function),
+//   - parsing only with tokenizeCommand and the constexpr table (findCommand),
+//   - whole commands through dispatchCommand (memory backend, so no disk I/O), output written to /dev/null.
+// Prints commands per second of each.
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "CommandGenerator.h"
+#include "Directory.h"
+#include "FileStorage.h"
+#include "OutputBuffer.h"
+#include "PathCache.h"
+
+static constexpr size_t command_count = 1000000;
+
+static const char* const mix[] = {
+    "pwd", "read V/d/f 3", "write V/d/f 5 x", "ls V/d/", "touch V/d/g",
+    "frobnicate V/d/f", "read V/d/f", "read V/d/f 0 8", "write V/d/f 2 hello", "wc V/d/f",
+};
+static constexpr size_t mix_size = sizeof(mix) / sizeof(mix[0]);
+
+// Function that prints the rate of a run of command_count commands.
+static void report(const char* what, const std::chrono::steady_clock::time_point start, const size_t checksum) {
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-44s %6.2fM commands/s  (%.3f s, checksum %zu)\n",
+                what, static_cast<double>(command_count) / seconds / 1e6, seconds, checksum);
+}
+
+// Parsing as the terminal did before the constexpr table: a stringstream and a vector of strings per line,
+// and a lookup in a std::map of std::function.
+static void parseLegacy() {
+    using Handler = std::function<void(const std::vector<std::string>&)>;
+    size_t checksum = 0;
+    std::map<std::string, Handler> handlers;
+    for (const char* name : {"read", "write", "touch", "copy", "remove", "move", "cat", "wc", "ln",
+                             "mkdir", "chdir", "rmdir", "ls", "lproot", "pwd"}) {
+        handlers[name] = [&checksum](const std::vector<std::string>& arguments) { checksum += arguments.size(); };
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < command_count; i++) {
+        std::stringstream stream{std::string(mix[i % mix_size])};
+        std::vector<std::string> words;
+        std::string word;
+        while (stream >> word) {
+            words.push_back(word);
+        }
+        const auto found = handlers.find(words[0]);
+        if (found != handlers.end()) {
+            found->second(std::vector<std::string>(words.begin() + 1, words.end()));
+        }
+    }
+    report("parse: stringstream + std::map<std::function>", start, checksum);
+}
+
+// Parsing with the string_view tokenizer and the perfect-hash table.
+static void parseTable() {
+    size_t checksum = 0;
+    std::string_view command;
+    CommandArguments arguments;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < command_count; i++) {
+        tokenizeCommand(mix[i % mix_size], command, arguments);
+        if (const CommandSpec* spec = findCommand(command)) {
+            checksum += arguments.size() + (spec->minArguments <= arguments.size());
+        }
+    }
+    report("parse: tokenizeCommand + findCommand", start, checksum);
+}
+
+// Whole commands, as the terminal runs them: errors are printed like Terminal::execute prints them.
+static void dispatchAll() {
+    const int null = ::open("/dev/null", O_WRONLY);
+    FileStorage::setBackend(StorageBackend::Memory);
+    Directory root("V");
+    PathCache paths;
+    Directory* workingDirectory = &root;
+    OutputBuffer output(null, null);
+    CommandContext context{root, paths, workingDirectory, output};
+    std::string_view command;
+    CommandArguments parameters;
+    for (const char* setup : {"mkdir V/d/", "touch V/d/f", "write V/d/f 0 0123456789"}) {
+        dispatchCommand(context, setup, command, parameters);
+    }
+    size_t failed = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < command_count; i++) {
+        try {
+            if (!dispatchCommand(context, mix[i % mix_size], command, parameters)) ++failed;
+        } catch (std::exception& e) {
+            printCommandError(output, e.what());
+            ++failed;
+        }
+    }
+    output.flush();
+    report("dispatchCommand (output to /dev/null)", start, failed);
+    root.clearFiles(root);
+    ::close(null);
+}
+
+int main() {
+    parseLegacy();
+    parseTable();
+    dispatchAll();
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Throughput benchmark of the wc kernels (scalar, SSE2, AVX2) on a fixed 64 MiB buffer of text.
+// Every kernel the CPU offers counts the buffer through WordCount::add, in blocks of WordCount::block_size,
+// and again in odd-sized blocks (so words and vector tails cross block borders).
+// Prints GB/s of the best of a few rounds, and exits with status 1 if any kernel disagrees with the scalar one.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "WordCount.h"
+
+static constexpr size_t buffer_size = 64 << 20;
+static constexpr int rounds = 5;
+
+// Function that fills a buffer with words of 1-12 letters, separated by every kind of whitespace,
+// some bytes above 127, and lines of varying length. The same seed always gives the same text.
+static std::vector<char> makeText() {
+    std::vector<char> text(buffer_size);
+    unsigned long long state = 88172645463325252ULL;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    static const char separators[] = {' ', ' ', ' ', ' ', '\n', '\t', '\r', '\v', '\f'};
+    size_t i = 0;
+    while (i < buffer_size) {
+        const size_t word = 1 + next() % 12;
+        for (size_t j = 0; j < word && i < buffer_size; j++) {
+            const unsigned long long r = next();
+            text[i++] = r % 50 == 0 ? static_cast<char>(0x80 + r % 0x80) : static_cast<char>('a' + r % 26);
+        }
+        const size_t gap = 1 + (next() % 8 == 0 ? next() % 3 : 0);
+        for (size_t j = 0; j < gap && i < buffer_size; j++) {
+            text[i++] = separators[next() % sizeof(separators)];
+        }
+    }
+    return text;
+}
+
+// Function that counts the whole buffer with the current kernel, in blocks of 'block' bytes.
+static WordCount count(const std::vector<char>& text, const size_t block) {
+    WordCount counter;
+    for (size_t offset = 0; offset < text.size(); offset += block) {
+        counter.add(text.data() + offset, std::min(block, text.size() - offset));
+    }
+    return counter;
+}
+
+// Function that tells if two counts would print the same wc line, and carry the same state.
+static bool same(const WordCount& a, const WordCount& b) {
+    return a.getLines() == b.getLines() && a.getWords() == b.getWords() &&
+           a.getCharacters() == b.getCharacters() && a.getCounts().inWord == b.getCounts().inWord;
+}
+
+int main() {
+    const std::vector<char> text = makeText();
+    std::printf("Buffer: %zu MiB, blocks of %zu KiB, best of %d rounds\n",
+                buffer_size >> 20, WordCount::block_size >> 10, rounds);
+    WordCount::setKernel("scalar");
+    const WordCount expected = count(text, WordCount::block_size);
+    std::printf("Counts: Lines: %zu, Words: %zu, Characters: %zu\n",
+                expected.getLines(), expected.getWords(), expected.getCharacters());
+
+    bool agree = true;
+    for (const char* name : {"scalar", "sse2", "avx2"}) {
+        if (!WordCount::setKernel(name)) {
+            std::printf("%-7s not supported by this CPU\n", name);
+            continue;
+        }
+        double best = 1e30;
+        WordCount result;
+        for (int round = 0; round < rounds; round++) {
+            const auto start = std::chrono::steady_clock::now();
+            result = count(text, WordCount::block_size);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        const bool matches = same(result, expected) && same(count(text, 4099), expected) &&
+                             same(count(text, 31), expected);
+        agree = agree && matches;
+        std::printf("%-7s %6.2f GB/s  %s\n", name, static_cast<double>(buffer_size) / best / 1e9,
+                    matches ? "same counts" : "DIFFERENT COUNTS");
+    }
+    if (!agree) {
+        std::fprintf(stderr, "FAILED: the kernels do not give the same counts\n");
+        return 1;
+    }
+    return 0;
+}
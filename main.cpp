@@ -1,7 +1,139 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
 #include "Terminal.h"
+#include "AsyncIO.h"
+#include "Daemon.h"
+#include "FileHandleCache.h"
+#include "ImageFile.h"
+#include "InlineStorage.h"
+#include "Journal.h"
+#include "PageCache.h"
+#include "ThreadPool.h"
+
+// Function that tells how many commands were replayed from the journal of a crashed run.
+static void reportRecovery(const size_t replayed) {
+    if (replayed > 0) {
+        std::cerr << "Recovered " << replayed << " commands from the journal.\n";
+    }
+}
+
 // Main function, Creates and starts the mini Terminal.
-int main() {
-    Terminal terminal("V");
-    terminal.startTerminal();
-    return 0;
-}
\ No newline at end of file
+// Optional flags: '--max-open N' bounds the amount of physical files kept open at once,
+// '--cache-pages N' bounds the amount of file pages kept in memory,
+// '--backend stream|mmap|memory|image' selects how the content of the files is accessed,
+// '--image FILE' names the image file of the image backend (default V.img),
+// '--inline-size N' keeps contents of at most N bytes inside their FileValue (default and maximum 256, 0 disables it),
+// '--load FILE' starts with the tree saved in a snapshot image (see 'save'),
+// '--journal FILE' journals every command changing the tree, and rebuilds the tree of a crashed run from it,
+// '--commit-interval MS' makes the journal durable every MS milliseconds (default 10, 0 before answering each command),
+// '--io-engine uring|threads' selects how background copies and the unlinks of 'exit' run (default uring),
+// '--background-copy N' runs copies of at least N bytes in the background (default 1 MiB),
+// '--threads N' sets the amount of worker threads (default: one per core),
+// '--script FILE' runs the commands of a file instead of reading the user (a piped stdin is run the same way),
+// '--stop-on-error' stops a script at the first failed command,
+// '--parallel' runs the commands of a script that use disjoint subtrees on the worker threads,
+// '--summary' prints the amount of commands, errors and the wall time of a piped run (always printed for '--script'),
+// '--daemon SOCKET' serves one tree to many sessions over a Unix domain socket, until SIGINT or SIGTERM,
+// '--connect SOCKET' runs a session of a daemon, sending stdin to it and printing its answers.
+int main(int argc, char* argv[]) {
+    StorageBackend backend = StorageBackend::Stream;
+    const char* script = nullptr;
+    const char* daemonSocket = nullptr;
+    const char* connectSocket = nullptr;
+    const char* snapshot = nullptr;
+    const char* journal = nullptr;
+    bool stopOnError = false;
+    bool summary = false;
+    bool parallel = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--stop-on-error") == 0) {
+            stopOnError = true;
+        } else if (std::strcmp(argv[i], "--summary") == 0) {
+            summary = true;
+        } else if (std::strcmp(argv[i], "--parallel") == 0) {
+            parallel = true;
+        } else if (i + 1 == argc) {
+            break;                      // Every other flag needs a value.
+        } else if (std::strcmp(argv[i], "--max-open") == 0) {
+            FileHandleCache::instance().setCapacity(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--cache-pages") == 0) {
+            PageCache::instance().setCapacity(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            ThreadPool::setThreads(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--backend") == 0) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "mmap") == 0) backend = StorageBackend::Mapped;
+            else if (std::strcmp(name, "memory") == 0) backend = StorageBackend::Memory;
+            else if (std::strcmp(name, "image") == 0) backend = StorageBackend::Image;
+            else backend = StorageBackend::Stream;
+        } else if (std::strcmp(argv[i], "--io-engine") == 0) {
+            AsyncIO::setEngine(std::strcmp(argv[++i], "threads") == 0 ? IOEngine::Threads : IOEngine::Uring);
+        } else if (std::strcmp(argv[i], "--background-copy") == 0) {
+            AsyncIO::setThreshold(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--inline-size") == 0) {
+            InlineStorage::setLimit(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--image") == 0) {
+            ImageFile::instance().setPath(argv[++i]);
+        } else if (std::strcmp(argv[i], "--journal") == 0) {
+            journal = argv[++i];
+        } else if (std::strcmp(argv[i], "--commit-interval") == 0) {
+            Journal::setInterval(static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--load") == 0) {
+            snapshot = argv[++i];
+        } else if (std::strcmp(argv[i], "--script") == 0) {
+            script = argv[++i];
+        } else if (std::strcmp(argv[i], "--daemon") == 0) {
+            daemonSocket = argv[++i];
+        } else if (std::strcmp(argv[i], "--connect") == 0) {
+            connectSocket = argv[++i];
+        }
+    }
+
+    if (daemonSocket || connectSocket) {
+        try {
+            if (connectSocket) {
+                return Daemon::connect(connectSocket);
+            }
+            Daemon daemon("V", daemonSocket, backend);
+            if (journal) reportRecovery(daemon.recover(journal));
+            if (snapshot) daemon.load(snapshot);
+            daemon.run();
+        } catch (std::exception& e) {
+            std::cerr << "ERROR: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    Terminal terminal("V", backend);
+    if (journal || snapshot) {
+        try {
+            if (journal) reportRecovery(terminal.recover(journal));
+            if (snapshot) terminal.load(snapshot);
+        } catch (std::exception& e) {
+            std::cerr << "ERROR: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (!script && isatty(STDIN_FILENO)) {
+        terminal.startTerminal();
+        return 0;
+    }
+
+    ScriptSummary result;
+    try {
+        ScriptReader reader = script ? ScriptReader(std::string(script)) : ScriptReader(STDIN_FILENO);
+        result = terminal.runScript(reader, stopOnError, parallel);
+    } catch (std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    if (script || summary) {
+        std::cerr << "Commands: " << result.commands << ", errors: " << result.errors
+                  << ", time: " << std::fixed << std::setprecision(3) << result.seconds << " s\n";
+    }
+    return stopOnError && result.errors > 0 ? 1 : 0;
+}
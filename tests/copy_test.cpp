@@ -0,0 +1,76 @@
+// Test of 'copy' on every storage backend, with inline storage on and off.
+// A file copied onto itself, or onto a hard link of itself, keeps its content; a copy between
+// two files gives the target the content and the counts of the source.
+// Exits with status 1 at the first failed check.
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include "CommandGenerator.h"
+#include "Directory.h"
+#include "FileStorage.h"
+#include "InlineStorage.h"
+#include "OutputBuffer.h"
+#include "PathCache.h"
+
+// Function that stops the test with a message if a check failed.
+static void check(const bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        std::exit(1);
+    }
+}
+
+// Function that runs command lines on a fresh tree, and returns what they printed (errors included).
+static std::string run(const std::initializer_list<const char*> lines) {
+    Directory root("V");
+    PathCache paths;
+    Directory* workingDirectory = &root;
+    OutputBuffer output(OutputBuffer::capture);
+    CommandContext context{root, paths, workingDirectory, output};
+    std::string_view command;
+    CommandArguments parameters;
+    for (const char* line : lines) {
+        try {
+            dispatchCommand(context, line, command, parameters);
+        } catch (std::exception& e) {
+            output << "ERROR: " << e.what() << '\n';
+        }
+    }
+    std::string printed = output.captured();
+    root.clearFiles(root);
+    FileStorage::syncAll();
+    return printed;
+}
+
+int main() {
+    const std::string large(5000, 'x');
+    const std::string writeLarge = "write V/f 0 " + large;
+    const char* backends[] = {"stream", "mmap", "memory", "image"};
+    const StorageBackend selected[] = {StorageBackend::Stream, StorageBackend::Mapped,
+                                       StorageBackend::Memory, StorageBackend::Image};
+    for (size_t b = 0; b < 4; b++) {
+        for (const size_t limit : {size_t(256), size_t(0)}) {
+            FileStorage::setBackend(selected[b]);
+            InlineStorage::setLimit(limit);
+            const std::string name = std::string(backends[b]) + (limit ? " inline" : "");
+
+            check(run({"touch V/f", "write V/f 0 helloworld", "copy V/f V/f", "read V/f 0 5", "wc V/f", "cat V/f"}) ==
+                  "hello\nLines: 1, Words: 1, Characters: 10\nhelloworld",
+                  name + ": a file copied onto itself keeps its content");
+            check(run({"touch V/f", writeLarge.c_str(), "copy V/f V/f", "wc V/f"}) ==
+                  "Lines: 1, Words: 1, Characters: 5000\n",
+                  name + ": a large file copied onto itself keeps its content");
+            check(run({"touch V/f", "write V/f 0 helloworld", "ln V/f V/g", "copy V/f V/g", "copy V/g V/f",
+                       "cat V/g", "wc V/f"}) ==
+                  "helloworldLines: 1, Words: 1, Characters: 10\n",
+                  name + ": a file copied onto a hard link of itself keeps its content");
+            check(run({"touch V/f", "write V/f 0 hello", "touch V/h", "write V/h 0 previous_content",
+                       "copy V/f V/h", "cat V/h", "wc V/h", "read V/h 5 1"}) ==
+                  "helloLines: 1, Words: 1, Characters: 5\nERROR: Range is out of bounds.\n",
+                  name + ": a copy replaces the whole content of the target");
+        }
+    }
+    std::printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Test of the journal replay after a crash, in a temporary working directory.
+// A child process runs journaled commands (one copies the host file 'V!x' into the tree), changes a physical file
+// behind the journal's back, and dies without 'exit'. The tree is then rebuilt from the journal: the host file
+// 'V!x' survives the replay and is copied again, and the file left by the crashed run is recreated from the journal.
+// Exits with status 1 at the first failed check.
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "CommandGenerator.h"
+#include "Directory.h"
+#include "Journal.h"
+#include "OutputBuffer.h"
+#include "PathCache.h"
+
+// Function that stops the test with a message if a check failed.
+static void check(const bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        std::exit(1);
+    }
+}
+
+// Function that returns the content of a host file, and whether it exists.
+static bool readHost(const char* name, std::string& content) {
+    std::ifstream file(name, std::ios::binary);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+// Function that runs command lines on a tree, and returns what they printed (errors included).
+static std::string run(CommandContext& context, const std::initializer_list<const char*> lines) {
+    std::string_view command;
+    CommandArguments parameters;
+    for (const char* line : lines) {
+        try {
+            dispatchCommand(context, line, command, parameters);
+        } catch (std::exception& e) {
+            context.output << "ERROR: " << e.what() << '\n';
+        }
+    }
+    return context.output.captured();
+}
+
+int main() {
+    char directory[] = "/tmp/journal_test_XXXXXX";
+    check(::mkdtemp(directory) != nullptr && ::chdir(directory) == 0, "a temporary working directory");
+    std::ofstream("V!x", std::ios::binary) << "host content";
+    Journal::setInterval(0);
+
+    const pid_t child = ::fork();
+    if (child == 0) {
+        Directory root("V");
+        PathCache paths;
+        Directory* workingDirectory = &root;
+        OutputBuffer output(OutputBuffer::capture);
+        CommandContext context{root, paths, workingDirectory, output};
+        replayJournal(root, paths, "journal");
+        run(context, {"mkdir V/a/", "touch V/a/f", "write V/a/f 0 abc", "copy V!x V/g", "sync"});
+        std::ofstream("V!a!f", std::ios::binary) << "abc lost change";    // Never journaled.
+        ::_exit(0);                                                     // Crash: no 'exit', no cleanup.
+    }
+    int status = 0;
+    check(child > 0 && ::waitpid(child, &status, 0) == child && WIFEXITED(status), "the crashed run");
+
+    Directory root("V");
+    PathCache paths;
+    Directory* workingDirectory = &root;
+    OutputBuffer output(OutputBuffer::capture);
+    CommandContext context{root, paths, workingDirectory, output};
+    check(replayJournal(root, paths, "journal") == 4, "every journaled command is replayed");
+    std::string content;
+    check(readHost("V!x", content) && content == "host content", "a host file named like the tree survives the replay");
+    check(run(context, {"cat V/g", "cat V/a/f", "wc V/a/f"}) == "host contentabcLines: 1, Words: 1, Characters: 3\n",
+          "the replayed tree holds the copied host file, and only the journaled content");
+
+    run(context, {"remove V/g", "remove V/a/f"});
+    Journal::instance().reset();
+    check(readHost("V!x", content), "the host file is still there after the tree is removed");
+    ::unlink("V!x");
+    ::unlink("journal");
+    check(::chdir("/") == 0 && ::rmdir(directory) == 0, "no physical file is left behind");
+    std::printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,203 @@
+// Stress test of NodePool and of the Directory sibling lists built on it, with trees of 1M nodes.
+// Checks that nodes keep their address while the tree grows and shrinks, that freed slots are reused,
+// that sibling lists keep creation order through removals, and that huge (and very deep) trees are
+// released without recursion, and that removing files from a huge directory keeps the order of the others
+// without rewriting the name index on every removal. Exits with status 1 at the first failed check.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Directory.h"
+#include "FileStorage.h"
+#include "NodePool.h"
+#include "OutputBuffer.h"
+
+static constexpr size_t node_count = 1000000;
+static constexpr size_t fan_out = 1000;             // Top directories, and subdirectories of each one.
+
+// Function that stops the test with a message if a check failed.
+static void check(const bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        std::exit(1);
+    }
+}
+
+// Function that returns the seconds elapsed since 'start'.
+static double since(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Function that returns the names listed by 'ls' of a directory, in the printed order.
+static std::vector<std::string> listNames(const Directory& directory) {
+    OutputBuffer output(OutputBuffer::capture);
+    directory.ls(output, "");
+    std::istringstream stream(output.captured());
+    std::vector<std::string> names;
+    std::string name;
+    stream >> name;                                 // The "/:" header.
+    while (stream >> name) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+struct Probe {
+    size_t id;
+    size_t check;
+    explicit Probe(const size_t id): id(id), check(~id) {}
+};
+
+// 1M objects straight in a NodePool: distinct addresses, untouched contents, freed slots reused.
+static void poolObjects() {
+    const auto start = std::chrono::steady_clock::now();
+    NodePool<Probe> pool;
+    std::vector<Probe*> objects;
+    objects.reserve(node_count);
+    for (size_t i = 0; i < node_count; i++) {
+        objects.push_back(pool.create(i));
+    }
+    check(pool.size() == node_count, "pool counts every created object");
+    std::vector<Probe*> sorted(objects);
+    std::sort(sorted.begin(), sorted.end());
+    check(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end(), "every object has its own slot");
+
+    const size_t capacity = pool.capacity();
+    for (size_t i = 0; i < node_count; i += 2) {
+        pool.destroy(objects[i]);
+    }
+    for (size_t i = 1; i < node_count; i += 2) {
+        check(objects[i]->id == i && objects[i]->check == ~i, "live objects keep their content");
+    }
+    for (size_t i = 0; i < node_count; i += 2) {
+        objects[i] = pool.create(i);
+    }
+    check(pool.capacity() == capacity, "freed slots are reused before the pool grows");
+    check(pool.size() == node_count, "pool counts the recreated objects");
+    for (Probe* object : objects) {
+        pool.destroy(object);
+    }
+    check(pool.size() == 0, "pool is empty after destroying everything");
+    std::printf("NodePool: 1M create, 500K destroy/recreate, 1M destroy: %.3f s\n", since(start));
+}
+
+// A root with 1000 subdirectories of 1000 subdirectories each (1M + 1000 nodes).
+static void wideTree() {
+    auto start = std::chrono::steady_clock::now();
+    Directory root("V");
+    std::vector<Directory*> top;
+    std::vector<Directory*> sample;                 // First subdirectory of every top directory.
+    for (size_t i = 0; i < fan_out; i++) {
+        root.addSubDirectory("d" + std::to_string(i));
+        top.push_back(root.findSubDirectory("d" + std::to_string(i)));
+        for (size_t j = 0; j < fan_out; j++) {
+            top[i]->addSubDirectory("g" + std::to_string(j));
+        }
+        sample.push_back(top[i]->findSubDirectory("g0"));
+    }
+    std::printf("Directory: 1M mkdir: %.3f s\n", since(start));
+
+    std::string path;
+    for (size_t i = 0; i < fan_out; i++) {
+        const std::string name = "d" + std::to_string(i);
+        check(root.findSubDirectory(name) == top[i], "a directory keeps its address while siblings are added");
+        check(top[i]->findSubDirectory("g0") == sample[i], "a subdirectory keeps its address while the tree grows");
+        check(sample[i]->isInside(top[i]) && sample[i]->isInside(&root), "parent pointers stay valid");
+        sample[i]->getFullPath(path, '/');
+        check(path == "V/" + name + "/g0", "full paths are built through the parent pointers");
+    }
+    const std::vector<std::string> grandchildren = listNames(*top[fan_out / 2]);
+    check(grandchildren.size() == fan_out, "ls lists every subdirectory");
+    for (size_t j = 0; j < fan_out; j++) {
+        check(grandchildren[j] == "g" + std::to_string(j), "siblings are listed in creation order");
+    }
+
+    // Remove every odd top directory (500 subtrees, 500K nodes), the working directory inside one of them.
+    start = std::chrono::steady_clock::now();
+    Directory* working = top[1]->findSubDirectory("g7");
+    Directory* kept = top[2]->findSubDirectory("g7");
+    check(root.removeSubDirectory("d1", working) == &root, "removing the subtree of the working directory moves it up");
+    for (size_t i = 3; i < fan_out; i += 2) {
+        check(root.removeSubDirectory("d" + std::to_string(i), kept) == kept,
+              "removing another subtree keeps the working directory");
+    }
+    std::printf("Directory: rmdir of 500 subtrees (500K nodes): %.3f s\n", since(start));
+    check(root.findSubDirectory("d1") == nullptr, "a removed directory is not found");
+    check(top[2]->findSubDirectory("g7") == kept, "siblings of removed subtrees keep their address");
+
+    // Removed names are created again at the end of the sibling list.
+    for (size_t i = 1; i < fan_out; i += 2) {
+        root.addSubDirectory("d" + std::to_string(i));
+    }
+    const std::vector<std::string> names = listNames(root);
+    check(names.size() == fan_out, "ls lists every top directory");
+    for (size_t i = 0; i < fan_out; i++) {
+        const size_t expected = i < fan_out / 2 ? 2 * i : 2 * (i - fan_out / 2) + 1;
+        check(names[i] == "d" + std::to_string(expected), "removals keep the order of the other siblings");
+    }
+}
+
+// A chain of 1M nested directories, released by the destructor of its root without recursion.
+static void deepTree() {
+    const auto start = std::chrono::steady_clock::now();
+    {
+        Directory root("V");
+        Directory* current = &root;
+        for (size_t i = 0; i < node_count; i++) {
+            current->addSubDirectory("c");
+            current = current->findSubDirectory("c");
+        }
+        check(current->isInside(&root), "the deepest directory reaches the root");
+        std::string path;
+        current->getFullPath(path, '/');
+        check(path.length() == 1 + 2 * node_count, "the full path of the deepest directory has every component");
+    }
+    std::printf("Directory: 1M deep chain built and released: %.3f s\n", since(start));
+}
+
+// A directory of 200K files (memory backend, nothing touches the disk): every other one removed, then every
+// third of the rest, by name; each removal only updates its own index entry, the rest keep their order.
+static void manyFiles() {
+    constexpr size_t file_count = 200000;
+    FileStorage::setBackend(StorageBackend::Memory);
+    Directory root("V");
+    for (size_t i = 0; i < file_count; i++) {
+        root.addFile("f" + std::to_string(i));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<bool> removed(file_count, false);
+    for (size_t step : {size_t(2), size_t(3)}) {
+        size_t live = 0;
+        for (size_t i = 0; i < file_count; i++) {
+            if (removed[i] || live++ % step != 0) continue;
+            const int index = root.isFileExists("f" + std::to_string(i));
+            check(index != -1, "a file that was not removed is found");
+            root.removeFileAt(index);
+            removed[i] = true;
+        }
+    }
+    std::printf("Directory: remove of 133K files out of 200K: %.3f s\n", since(start));
+    const std::vector<std::string> names = listNames(root);
+    size_t listed = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        const int index = root.isFileExists("f" + std::to_string(i));
+        check((index == -1) == removed[i], "exactly the removed files are gone from the index");
+        if (removed[i]) continue;
+        check(root.getFileAt(index).getFileName() == "f" + std::to_string(i), "the index finds the file it names");
+        check(listed < names.size() && names[listed++] == "f" + std::to_string(i),
+              "removals keep the order of the other files");
+    }
+    check(listed == names.size(), "ls lists every remaining file once");
+}
+
+int main() {
+    poolObjects();
+    wideTree();
+    deepTree();
+    manyFiles();
+    std::printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Test of reading a missing physical file, on every storage backend, in a temporary working directory.
+// Reads (size, read, cat, wc) of a file whose physical file is gone see an empty content and never create it,
+// only touch and write do. Also checks that the backend of the process cannot change under a living terminal
+// or living storages. Exits with status 1 at the first failed check.
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "CommandGenerator.h"
+#include "Directory.h"
+#include "FileStorage.h"
+#include "OutputBuffer.h"
+#include "PathCache.h"
+#include "Terminal.h"
+
+// Function that stops the test with a message if a check failed.
+static void check(const bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        std::exit(1);
+    }
+}
+
+// Function that tells if a physical file exists in the working directory.
+static bool exists(const char* name) {
+    return ::access(name, F_OK) == 0;
+}
+
+// Function that runs command lines on a tree, and returns what they printed (errors included).
+static std::string run(CommandContext& context, const std::initializer_list<const char*> lines) {
+    std::string_view command;
+    CommandArguments parameters;
+    for (const char* line : lines) {
+        try {
+            dispatchCommand(context, line, command, parameters);
+        } catch (std::exception& e) {
+            context.output << "ERROR: " << e.what() << '\n';
+        }
+    }
+    return context.output.captured();
+}
+
+int main() {
+    char directory[] = "/tmp/storage_test_XXXXXX";
+    check(::mkdtemp(directory) != nullptr && ::chdir(directory) == 0, "a temporary working directory");
+    const char* backends[] = {"stream", "mmap", "memory", "image"};
+    const StorageBackend selected[] = {StorageBackend::Stream, StorageBackend::Mapped,
+                                       StorageBackend::Memory, StorageBackend::Image};
+    for (size_t b = 0; b < 4; b++) {
+        FileStorage::setBackend(selected[b]);
+        const std::string name = backends[b];
+        {
+            const std::unique_ptr<FileStorage> storage(FileStorage::create("missing", false));
+            char buffer[8];
+            check(storage->size() == 0 && storage->read(0) == 0 && storage->read(0, buffer, sizeof(buffer)) == 0,
+                  name + ": a missing file reads as empty");
+            size_t blocks = 0;
+            storage->forEachBlock([&blocks](const char*, size_t) { ++blocks; });
+            check(blocks == 0, name + ": a missing file has no blocks");
+            storage->flush();
+            check(!exists("missing"), name + ": reading a missing file does not create it");
+            storage->write(0, "x", 1);
+            storage->flush();
+            check(storage->size() == 1 && exists("missing"), name + ": writing a missing file creates it");
+        }
+        ::unlink("missing");
+
+        Directory root("V");
+        PathCache paths;
+        Directory* workingDirectory = &root;
+        OutputBuffer output(OutputBuffer::capture);
+        CommandContext context{root, paths, workingDirectory, output};
+        run(context, {"mkdir V/a/", "touch V/a/f.txt", "sync"});
+        ::unlink("V!a!f.txt");                      // Removed behind the terminal's back.
+        run(context, {"cat V/a/f.txt", "wc V/a/f.txt", "read V/a/f.txt 0"});
+        check(!exists("V!a!f.txt"), name + ": cat, wc and read of a removed physical file do not create it");
+        run(context, {"write V/a/f.txt 0 hi", "sync"});
+        check(selected[b] == StorageBackend::Image || exists("V!a!f.txt"), name + ": write creates the physical file");
+        root.clearFiles(root);
+        FileStorage::syncAll();
+        check(!exists("V!a!f.txt"), name + ": no physical file is left behind");
+    }
+
+    // The backend belongs to the process: a second terminal cannot change it under the first one.
+    {
+        FileStorage::setBackend(StorageBackend::Stream);
+        const Terminal first("V", StorageBackend::Stream);
+        bool rejected = false;
+        try {
+            const Terminal second("W", StorageBackend::Memory);
+        } catch (std::exception&) {
+            rejected = true;
+        }
+        check(rejected && FileStorage::getBackend() == StorageBackend::Stream,
+              "a terminal asking for another backend is rejected, the first one keeps its backend");
+        const Terminal same("W", StorageBackend::Stream);
+    }
+    {
+        const std::unique_ptr<FileStorage> storage(FileStorage::create("alive", false));
+        bool rejected = false;
+        try {
+            FileStorage::setBackend(StorageBackend::Mapped);
+        } catch (std::exception&) {
+            rejected = true;
+        }
+        check(rejected, "the backend cannot change while a storage created with it is alive");
+    }
+    FileStorage::setBackend(StorageBackend::Mapped);
+    check(FileStorage::getBackend() == StorageBackend::Mapped, "the backend can be selected again once nothing uses it");
+
+    check(::chdir("/") == 0, "leaving the temporary directory");
+    std::printf("OK\n");
+    return ::rmdir(directory) == 0 ? 0 : (std::fprintf(stderr, "FAILED: files left in %s\n", directory), 1);
+}